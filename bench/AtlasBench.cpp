@@ -0,0 +1,135 @@
+// texture loading and atlas packing, without a display: sprite sized images are generated by a decoder of
+// our own, loaded through the AssetCache with and without a thread pool, then packed. Build with
+// `make bench` and run build/bench/atlas_bench, or build from the repository root with
+//     g++ -std=c++17 -O2 -Isrc/headers bench/AtlasBench.cpp src/*.cpp -pthread -o atlas_bench
+// the occupancy of the filled pages is checked against MIN_OCCUPANCY, the run fails below it. The run
+// also fails when an empty image makes it into an unpadded atlas
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Assets.hpp"
+#include "ThreadPool.hpp"
+
+namespace
+{
+    const std::uint32_t PAGE_SIZE = 1024;
+
+    // every page but the last one of a run must be at least this full
+    const double MIN_OCCUPANCY = 0.85;
+
+    // sizes of the generated images, by the number of their path
+    std::uint32_t imageSide(size_t number, std::uint32_t minSide, std::uint32_t maxSide)
+    {
+        std::mt19937 random(static_cast<std::mt19937::result_type>(number));
+        return std::uniform_int_distribution<std::uint32_t>(minSide, maxSide)(random);
+    }
+
+    struct Distribution
+    {
+        const char *name;
+        std::uint32_t minSide;
+        std::uint32_t maxSide;
+    };
+
+    // paths are "<number>", the image is filled so the decode costs about what copying real pixels would
+    ImageDecoder makeDecoder(const Distribution &distribution)
+    {
+        return [distribution](const std::string &path, Image &out)
+        {
+            size_t number = std::stoul(path);
+            out.width = imageSide(number * 2, distribution.minSide, distribution.maxSide);
+            out.height = imageSide(number * 2 + 1, distribution.minSide, distribution.maxSide);
+            out.pixels.assign(size_t{out.width} * out.height * 4, static_cast<std::uint8_t>(number));
+            return true;
+        };
+    }
+
+    // returns false when the filled pages are not full enough
+    bool run(const Distribution &distribution, size_t imageCount, ThreadPool *pool)
+    {
+        AssetCache cache(pool, PAGE_SIZE);
+        cache.setDecoder(makeDecoder(distribution));
+
+        auto start = std::chrono::steady_clock::now();
+        std::vector<TextureHandle> handles;
+        for (size_t number = 0; number < imageCount; ++number)
+        {
+            handles.push_back(cache.load(std::to_string(number)));
+        }
+        // the second round only hits the cache
+        for (size_t number = 0; number < imageCount; ++number)
+        {
+            handles.push_back(cache.load(std::to_string(number)));
+        }
+        cache.wait();
+        auto loaded = std::chrono::steady_clock::now();
+        cache.buildAtlas();
+        auto packed = std::chrono::steady_clock::now();
+
+        const std::vector<AtlasPage> &pages = cache.getPages();
+        double filledOccupancy = 0.0;
+        for (size_t page = 0; page + 1 < pages.size(); ++page)
+        {
+            filledOccupancy += pages[page].packer.getOccupancy();
+        }
+        filledOccupancy = pages.size() > 1 ? filledOccupancy / static_cast<double>(pages.size() - 1) : 1.0;
+
+        std::chrono::duration<double, std::milli> loadTime = loaded - start;
+        std::chrono::duration<double, std::milli> packTime = packed - loaded;
+        bool passed = filledOccupancy >= MIN_OCCUPANCY && cache.size() == imageCount;
+        std::printf("%-8s %8zu %8s %8zu %12.2f %12.2f %12.1f%%%s\n", distribution.name, imageCount,
+                    pool ? "pool" : "inline", pages.size(), loadTime.count(), packTime.count(),
+                    filledOccupancy * 100.0, passed ? "" : "  FAILED");
+        return passed;
+    }
+
+    // empty images are turned down by insert, as decode does, rather than packed as empty rectangles
+    bool emptyImagesAreRejected()
+    {
+        AssetCache cache(nullptr, PAGE_SIZE, 0);
+        TextureHandle flat = cache.insert("flat", Image{16, 0, {}});
+        TextureHandle thin = cache.insert("thin", Image{0, 16, {}});
+        TextureHandle solid = cache.insert("solid", Image{16, 16, std::vector<std::uint8_t>(16 * 16 * 4)});
+        cache.buildAtlas();
+
+        bool passed = !flat && !thin && solid && solid->isPacked() && cache.size() == 1;
+        std::printf("empty images: %s\n", passed ? "ok" : "FAILED");
+        return passed;
+    }
+}
+
+int main()
+{
+    const Distribution distributions[] = {
+        {"tiles", 16, 32},
+        {"sprites", 16, 128},
+        {"mixed", 8, 256},
+    };
+
+    ThreadPool pool(std::max(1u, std::thread::hardware_concurrency()));
+
+    std::printf("%-8s %8s %8s %8s %12s %12s %13s\n", "images", "count", "decode", "pages", "load ms", "pack ms",
+                "occupancy");
+    bool passed = true;
+    for (const Distribution &distribution : distributions)
+    {
+        for (size_t imageCount : {1000, 4000})
+        {
+            passed &= run(distribution, imageCount, nullptr);
+            passed &= run(distribution, imageCount, &pool);
+        }
+    }
+
+    if (!passed)
+    {
+        std::printf("atlas occupancy below %.0f%%\n", MIN_OCCUPANCY * 100.0);
+        return 1;
+    }
+    return emptyImagesAreRejected() ? 0 : 1;
+}
@@ -0,0 +1,469 @@
+// timings of the ECS core operations at 1k/10k/100k/1M entities, on both storage backends.
+// Build with `make bench` and run build/bench/ecs_bench, or build from the repository root with
+//     g++ -std=c++17 -O2 -Isrc/headers bench/EcsBench.cpp src/*.cpp -pthread -o ecs_bench
+// options:
+//     --csv           prints comma separated values instead of the table
+//     --max <count>   skips the entity counts above count, e.g. --max 100000 for a quick run
+// the snapshot rows write a scratch file into the working directory
+// every row is the best of REPEATS runs, in nanoseconds per operation. The rows always come out
+// in the same order so two runs can be diffed
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <random>
+#include <vector>
+
+#include "Game.hpp"
+#include "Transform.hpp"
+
+namespace
+{
+    const int REPEATS = 5;
+
+    const size_t ENTITY_COUNTS[] = {1000, 10000, 100000, 1000000};
+
+    // a system over Position and Velocity, the benchmarks read its mEntities directly
+    class PositionVelocitySystem : public System
+    {
+    public:
+        void update() override {}
+    };
+
+    // keeps the optimizer from dropping the loops whose result is otherwise unused
+    volatile float gSink;
+
+    struct Row
+    {
+        const char *benchmark;
+        const char *backend;
+        size_t entities;
+        double nanosecondsPerOp;
+    };
+
+    bool gCsv = false;
+
+    void printHeader()
+    {
+        if (gCsv)
+        {
+            std::printf("benchmark,backend,entities,ns_per_op,mops_per_s\n");
+        }
+        else
+        {
+            std::printf("%-20s %-10s %10s %12s %12s\n", "benchmark", "backend", "entities", "ns/op", "Mop/s");
+        }
+    }
+
+    void printRow(const Row &row)
+    {
+        double opsPerSecond = row.nanosecondsPerOp > 0.0 ? 1000.0 / row.nanosecondsPerOp : 0.0;
+        if (gCsv)
+        {
+            std::printf("%s,%s,%zu,%.3f,%.3f\n", row.benchmark, row.backend, row.entities, row.nanosecondsPerOp,
+                        opsPerSecond);
+        }
+        else
+        {
+            std::printf("%-20s %-10s %10zu %12.2f %12.2f\n", row.benchmark, row.backend, row.entities,
+                        row.nanosecondsPerOp, opsPerSecond);
+        }
+        std::fflush(stdout);
+    }
+
+    // runs setup then the timed operation REPEATS times, returns the best time per operation
+    template <typename Setup, typename Operation>
+    double bestNanosecondsPerOp(size_t opCount, Setup &&setup, Operation &&operation)
+    {
+        double best = 0.0;
+        for (int repeat = 0; repeat < REPEATS; ++repeat)
+        {
+            setup();
+            auto start = std::chrono::steady_clock::now();
+            operation();
+            std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+
+            double perOp = elapsed.count() / static_cast<double>(opCount);
+            best = repeat == 0 ? perOp : std::min(best, perOp);
+        }
+        return best;
+    }
+
+    /** one world per entity count and backend, every benchmark leaves it the way it found it:
+     * mCount living entities owning Position and Velocity, listed in mEntities */
+    class Suite
+    {
+    public:
+        Suite(size_t entityCount, StorageBackend backend)
+            : mCount(entityCount), mBackendName(backend == StorageBackend::SparseSet ? "sparse" : "archetype"),
+              mGame(static_cast<Entity>(entityCount), backend), mEntities(entityCount)
+        {
+            mGame.RegisterComponent<Position>();
+            mGame.RegisterComponent<Velocity>();
+            mGame.RegisterComponent<Acceleration>();
+
+            mSystem = mGame.RegisterSystem<PositionVelocitySystem>();
+            Signature signature;
+            signature.set(mGame.GetComponentType<Position>());
+            signature.set(mGame.GetComponentType<Velocity>());
+            mGame.SetSystemSignature<PositionVelocitySystem>(signature);
+        }
+
+        void run()
+        {
+            createDestroy();
+            createDestroyBatch();
+            populate();
+            attachDetach();
+            getComponent();
+            membershipChurn();
+            iterate();
+            snapshot();
+            destroyWave();
+            groups();
+        }
+
+    private:
+        void report(const char *benchmark, double nanosecondsPerOp)
+        {
+            printRow({benchmark, mBackendName, mCount, nanosecondsPerOp});
+        }
+
+        void destroyAll()
+        {
+            for (Entity entity : mEntities)
+            {
+                if (mGame.IsAlive(entity))
+                {
+                    mGame.DestroyEntity(entity);
+                }
+            }
+        }
+
+        void createDestroy()
+        {
+            report("create", bestNanosecondsPerOp(mCount, [&]
+                                                  { destroyAll(); },
+                                                  [&]
+                                                  {
+                for (Entity &entity : mEntities)
+                {
+                    entity = mGame.CreateEntity();
+                } }));
+
+            // the entities are there from the last create run, so the first setup is a no-op
+            report("destroy", bestNanosecondsPerOp(mCount, [&]
+                                                   {
+                if (!mGame.IsAlive(mEntities[0]))
+                {
+                    for (Entity &entity : mEntities)
+                    {
+                        entity = mGame.CreateEntity();
+                    }
+                } },
+                                                   [&]
+                                                   {
+                for (Entity entity : mEntities)
+                {
+                    mGame.DestroyEntity(entity);
+                } }));
+        }
+
+        void createDestroyBatch()
+        {
+            report("create_batch", bestNanosecondsPerOp(mCount, [&]
+                                                        { destroyAll(); },
+                                                        [&]
+                                                        { mGame.CreateEntities(mCount, mEntities.data()); }));
+
+            report("destroy_batch", bestNanosecondsPerOp(mCount, [&]
+                                                         {
+                if (!mGame.IsAlive(mEntities[0]))
+                {
+                    mGame.CreateEntities(mCount, mEntities.data());
+                } },
+                                                         [&]
+                                                         { mGame.DestroyEntities(mEntities.data(), mCount); }));
+        }
+
+        // the state the remaining benchmarks start from and leave behind
+        void populate()
+        {
+            destroyAll();
+            mGame.CreateEntities(mCount, mEntities.data());
+
+            std::vector<Position> positions(mCount);
+            std::vector<Velocity> velocities(mCount);
+            for (size_t index = 0; index < mCount; ++index)
+            {
+                positions[index] = {static_cast<float>(index), 0.0f};
+                velocities[index] = {1.0f, 2.0f};
+            }
+            mGame.AttachComponents<Position, Velocity>(mEntities.data(), mCount, positions.data(), velocities.data());
+        }
+
+        void attachDetach()
+        {
+            bool attached = false;
+            auto attachAll = [&]
+            {
+                for (Entity entity : mEntities)
+                {
+                    mGame.AttachComponent(entity, Acceleration{0.0f, -9.8f});
+                }
+                attached = true;
+            };
+            auto detachAll = [&]
+            {
+                for (Entity entity : mEntities)
+                {
+                    mGame.DetachComponent<Acceleration>(entity);
+                }
+                attached = false;
+            };
+
+            // Acceleration is in no system signature, so this is the pool and signature cost alone
+            report("attach", bestNanosecondsPerOp(mCount, [&]
+                                                  {
+                if (attached)
+                {
+                    detachAll();
+                } },
+                                                  attachAll));
+
+            report("detach", bestNanosecondsPerOp(mCount, [&]
+                                                  {
+                if (!attached)
+                {
+                    attachAll();
+                } },
+                                                  detachAll));
+        }
+
+        void getComponent()
+        {
+            // in creation order, then shuffled so the pool is walked the way random lookups would
+            std::vector<Entity> order(mEntities);
+            auto lookupAll = [&]
+            {
+                float sum = 0.0f;
+                for (Entity entity : order)
+                {
+                    sum += mGame.GetComponent<Position>(entity).x;
+                }
+                gSink = sum;
+            };
+
+            report("get_linear", bestNanosecondsPerOp(mCount, [] {}, lookupAll));
+
+            std::shuffle(order.begin(), order.end(), std::mt19937(1234));
+            report("get_random", bestNanosecondsPerOp(mCount, [] {}, lookupAll));
+        }
+
+        void membershipChurn()
+        {
+            // every detach and attach of Velocity moves the entity out of and back into the system
+            report("membership_churn", bestNanosecondsPerOp(2 * mCount, [] {},
+                                                            [&]
+                                                            {
+                for (Entity entity : mEntities)
+                {
+                    mGame.DetachComponent<Velocity>(entity);
+                }
+                for (Entity entity : mEntities)
+                {
+                    mGame.AttachComponent(entity, Velocity{1.0f, 2.0f});
+                } }));
+        }
+
+        void iterate()
+        {
+            report("iterate_view", bestNanosecondsPerOp(mCount, [] {},
+                                                        [&]
+                                                        { mGame.View<Position, Velocity>().each([](Position &position, Velocity &velocity)
+                                                                                                {
+                position.x += velocity.x;
+                position.y += velocity.y; }); }));
+
+            // the pattern the systems of the repository started out with
+            report("iterate_system", bestNanosecondsPerOp(mCount, [] {},
+                                                          [&]
+                                                          {
+                for (Entity entity : mSystem->mEntities)
+                {
+                    Position &position = mGame.GetComponent<Position>(entity);
+                    const Velocity &velocity = mGame.GetComponent<Velocity>(entity);
+                    position.x += velocity.x;
+                    position.y += velocity.y;
+                } }));
+        }
+
+        void snapshot()
+        {
+            // snapshots need the sparse set backend
+            if (mGame.GetStorageBackend() != StorageBackend::SparseSet)
+            {
+                return;
+            }
+
+            const char *path = "ecs_bench_snapshot.bin";
+            report("snapshot_save", bestNanosecondsPerOp(mCount, [] {}, [&]
+                                                         { mGame.SaveSnapshot(path); }));
+
+            // rebuilding the same world through the attach path, for comparison
+            std::vector<Position> positions(mCount, Position{0.0f, 0.0f});
+            std::vector<Velocity> velocities(mCount, Velocity{1.0f, 2.0f});
+            report("rebuild_attach", bestNanosecondsPerOp(mCount, [&]
+                                                          { mGame.DestroyEntities(mEntities.data(), mCount); },
+                                                          [&]
+                                                          {
+                mGame.CreateEntities(mCount, mEntities.data());
+                mGame.AttachComponents<Position, Velocity>(mEntities.data(), mCount, positions.data(),
+                                                           velocities.data()); }));
+
+            report("snapshot_load", bestNanosecondsPerOp(mCount, [] {}, [&]
+                                                         { mGame.LoadSnapshot(path); }));
+            std::remove(path);
+        }
+
+        // destroying every populated entity in one batch, then again with observers on the detached
+        // Velocities and the destroyed entities, the events being delivered as part of the wave.
+        // The observers stay registered, so this runs last
+        void destroyWave()
+        {
+            // a snapshot load brings back handles mEntities no longer lists
+            mGame.QueryEntities<Position>(mEntities);
+            std::vector<Position> positions(mCount, Position{0.0f, 0.0f});
+            std::vector<Velocity> velocities(mCount, Velocity{1.0f, 2.0f});
+            auto repopulate = [&]
+            {
+                if (!mGame.IsAlive(mEntities[0]))
+                {
+                    mGame.CreateEntities(mCount, mEntities.data());
+                    mGame.AttachComponents<Position, Velocity>(mEntities.data(), mCount, positions.data(),
+                                                               velocities.data());
+                }
+            };
+
+            report("destroy_wave", bestNanosecondsPerOp(mCount, repopulate, [&]
+                                                        { mGame.DestroyEntities(mEntities.data(), mCount); }));
+
+            // component events need the sparse set backend
+            if (mGame.GetStorageBackend() != StorageBackend::SparseSet)
+            {
+                return;
+            }
+
+            float detachedSum = 0.0f;
+            size_t destroyedCount = 0;
+            mGame.OnDetach<Velocity>([&](const Entity *, const Velocity *detached, size_t count)
+                                     {
+                for (size_t index = 0; index < count; ++index)
+                {
+                    detachedSum += detached[index].x;
+                } });
+            mGame.OnDestroy([&](const Entity *, size_t count)
+                            { destroyedCount += count; });
+
+            // the attaches of the setup are not observed, nothing is left over to deliver in the timed part
+            report("destroy_wave_events", bestNanosecondsPerOp(mCount, repopulate, [&]
+                                                               {
+                mGame.DestroyEntities(mEntities.data(), mCount);
+                mGame.DeliverEvents(); }));
+            gSink = detachedSum + static_cast<float>(destroyedCount);
+        }
+
+        // a view over pools whose orders no longer match, then the same join through an owning group and
+        // the cost of sorting it. The group stays, so this runs after every other benchmark
+        void groups()
+        {
+            // groups need the sparse set backend
+            if (mGame.GetStorageBackend() != StorageBackend::SparseSet)
+            {
+                return;
+            }
+
+            if (!mGame.IsAlive(mEntities[0]))
+            {
+                populate();
+            }
+
+            // reattaching the Velocities in another order scrambles their pool against the Positions'
+            std::vector<Entity> order(mEntities);
+            std::shuffle(order.begin(), order.end(), std::mt19937(1234));
+            for (Entity entity : order)
+            {
+                mGame.DetachComponent<Velocity>(entity);
+            }
+            for (Entity entity : order)
+            {
+                mGame.AttachComponent(entity, Velocity{1.0f, 2.0f});
+            }
+
+            auto addVelocity = [](Position &position, Velocity &velocity)
+            {
+                position.x += velocity.x;
+                position.y += velocity.y;
+            };
+            report("iterate_view_mixed", bestNanosecondsPerOp(mCount, [] {}, [&]
+                                                              { mGame.View<Position, Velocity>().each(addVelocity); }));
+
+            // creating the group co-sorts the two pools once
+            OwningGroup<Position, Velocity> group = mGame.Group<Position, Velocity>();
+            report("iterate_group", bestNanosecondsPerOp(mCount, [] {}, [&]
+                                                         { group.each(addVelocity); }));
+
+            report("sort_group", bestNanosecondsPerOp(mCount, [&]
+                                                      { group.sort<Position>([](const Position &first, const Position &second)
+                                                                             { return first.x > second.x; }); },
+                                                      [&]
+                                                      { group.sort<Position>([](const Position &first, const Position &second)
+                                                                             { return first.x < second.x; }); }));
+        }
+
+        size_t mCount;
+        const char *mBackendName;
+
+        Game mGame;
+        std::shared_ptr<PositionVelocitySystem> mSystem;
+
+        std::vector<Entity> mEntities;
+    };
+}
+
+int main(int argc, char **argv)
+{
+    size_t maxCount = ENTITY_COUNTS[std::size(ENTITY_COUNTS) - 1];
+    for (int index = 1; index < argc; ++index)
+    {
+        if (std::strcmp(argv[index], "--csv") == 0)
+        {
+            gCsv = true;
+        }
+        else if (std::strcmp(argv[index], "--max") == 0 && index + 1 < argc)
+        {
+            maxCount = std::strtoull(argv[++index], nullptr, 10);
+        }
+        else
+        {
+            std::fprintf(stderr, "usage: %s [--csv] [--max <entity count>]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    printHeader();
+    for (StorageBackend backend : {StorageBackend::SparseSet, StorageBackend::Archetype})
+    {
+        for (size_t entityCount : ENTITY_COUNTS)
+        {
+            if (entityCount <= maxCount)
+            {
+                Suite(entityCount, backend).run();
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,170 @@
+// world transform propagation through HierarchySystem against the hand-written way: every child walking
+// up its parents through GetComponent each frame. Forests of trees of FANOUT children per node, a share
+// of the roots moving every frame (all, 1%, none), and the cost of reparenting a subtree.
+// Build with `make bench` and run build/bench/hierarchy_bench, or build from the repository root with
+//     g++ -std=c++17 -O2 -Isrc/headers bench/HierarchyBench.cpp src/*.cpp -pthread -o hierarchy_bench
+// the run fails when a child's Position does not match the walk up its parents
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "Game.hpp"
+#include "Hierarchy.hpp"
+
+namespace
+{
+    const int FRAMES = 50;
+    const size_t FANOUT = 4;
+    const size_t DEPTH = 6;
+
+    // what a game without a hierarchy attaches to a child to follow its parent
+    struct FollowParent
+    {
+        Entity parent;
+        Position offset;
+    };
+
+    template <typename Func>
+    double microsecondsPerFrame(Func &&func)
+    {
+        func(); // warm up
+        auto start = std::chrono::steady_clock::now();
+        for (int frame = 0; frame < FRAMES; ++frame)
+        {
+            func();
+        }
+        std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+        return elapsed.count() / FRAMES;
+    }
+
+    // a child's world position from its FollowParent chain, the way the naive loop computes it
+    Position followedPosition(Game &game, Entity entity)
+    {
+        const FollowParent &follow = game.GetComponent<FollowParent>(entity);
+        Position parent = game.GetComponentArray<FollowParent>()->hasComponent(follow.parent)
+                              ? followedPosition(game, follow.parent)
+                              : game.GetComponent<Position>(follow.parent);
+        return {parent.x + follow.offset.x, parent.y + follow.offset.y};
+    }
+
+    // returns false when a child's Position is off
+    bool run(size_t treeCount)
+    {
+        size_t treeSize = 0;
+        for (size_t depth = 0, width = 1; depth < DEPTH; ++depth, width *= FANOUT)
+        {
+            treeSize += width;
+        }
+        size_t nodeCount = treeCount * treeSize;
+
+        Game game(static_cast<Entity>(nodeCount));
+        game.RegisterComponent<Position>();
+        game.RegisterComponent<HierarchyNode>();
+        game.RegisterComponent<FollowParent>();
+        auto hierarchy = game.RegisterSystem<HierarchySystem>();
+        hierarchy->init(game);
+
+        // the trees are built breadth first, so the naive pools list parents before children
+        std::vector<Entity> roots;
+        std::vector<Entity> children;
+        std::vector<Entity> frontier;
+        std::vector<Entity> next;
+        for (size_t tree = 0; tree < treeCount; ++tree)
+        {
+            Entity root = game.CreateEntity();
+            game.AttachComponent(root, Position{static_cast<float>(tree), 0.0f});
+            roots.push_back(root);
+            frontier.assign(1, root);
+            for (size_t depth = 1; depth < DEPTH; ++depth)
+            {
+                next.clear();
+                for (Entity parent : frontier)
+                {
+                    for (size_t child = 0; child < FANOUT; ++child)
+                    {
+                        Entity entity = game.CreateEntity();
+                        Position offset{static_cast<float>(child), 1.0f};
+                        game.AttachComponent(entity, Position{0.0f, 0.0f});
+                        game.AttachComponent(entity, FollowParent{parent, offset});
+                        hierarchy->setParent(entity, parent, offset);
+                        children.push_back(entity);
+                        next.push_back(entity);
+                    }
+                }
+                frontier.swap(next);
+            }
+        }
+        game.UpdateSystems();
+
+        auto moveRoots = [&](size_t stride)
+        {
+            for (size_t index = 0; index < roots.size(); index += stride)
+            {
+                game.GetComponent<Position>(roots[index]).x += 1.0f;
+            }
+        };
+
+        // every child recomputed through its chain of parents, whatever moved
+        double naive = microsecondsPerFrame([&]
+                                            {
+            moveRoots(1);
+            for (Entity child : children)
+            {
+                game.GetComponent<Position>(child) = followedPosition(game, child);
+            } });
+
+        double all = microsecondsPerFrame([&]
+                                          {
+            moveRoots(1);
+            game.UpdateSystems(); });
+        double some = microsecondsPerFrame([&]
+                                           {
+            moveRoots(100);
+            game.UpdateSystems(); });
+        double none = microsecondsPerFrame([&]
+                                           { game.UpdateSystems(); });
+
+        // moving a depth 1 subtree under another tree's root, and back
+        std::mt19937 random(7);
+        double reparent = microsecondsPerFrame([&]
+                                               {
+            Entity subtree = children[(random() % treeCount) * (treeSize - 1)];
+            Entity parent = hierarchy->getParent(subtree);
+            hierarchy->setParent(subtree, roots[random() % treeCount], Position{0.0f, 2.0f});
+            hierarchy->setParent(subtree, parent, Position{0.0f, 1.0f}); });
+        game.UpdateSystems();
+
+        bool passed = true;
+        for (Entity child : children)
+        {
+            Position expected = hierarchy->getHierarchy().computeWorld(child);
+            const Position &position = game.GetComponent<Position>(child);
+            passed &= std::fabs(position.x - expected.x) < 1e-3f && std::fabs(position.y - expected.y) < 1e-3f;
+        }
+
+        std::printf("%8zu %8zu %12.1f %12.1f %12.1f %12.1f %12.2f%s\n", nodeCount, treeSize, naive, all, some, none,
+                    reparent / 2.0, passed ? "" : "  FAILED");
+        return passed;
+    }
+}
+
+int main()
+{
+    std::printf("%8s %8s %12s %12s %12s %12s %12s\n", "nodes", "tree", "naive us/f", "all us/f", "1% us/f",
+                "none us/f", "reparent us");
+    bool passed = true;
+    for (size_t treeCount : {10, 100, 500})
+    {
+        passed &= run(treeCount);
+    }
+
+    if (!passed)
+    {
+        std::printf("a child's Position does not match its parents\n");
+        return 1;
+    }
+    return 0;
+}
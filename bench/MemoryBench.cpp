@@ -0,0 +1,296 @@
+// steady-state allocations of a running world, without a display: bodies are integrated, collide, get drawn
+// into sprite batches, and a wave of them is destroyed and respawned in place through a command buffer every
+// frame, with change tracking and lifecycle observers on. Every global operator new of the process is counted
+// next to the world's own counters (Game::GetMemoryStats). Build with `make bench` and run
+// build/bench/memory_bench, or build from the repository root with
+//     g++ -std=c++17 -O2 -Isrc/headers bench/MemoryBench.cpp src/*.cpp -pthread -o memory_bench
+// the run fails when a measured frame of a still world allocates, with or without workers. Moving bodies
+// keep finding new crowded collision cells, their counts are only printed. It also fails when attaches of the
+// same component recorded into two command buffers do not leave exactly one component, the last recorded
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "Collision.hpp"
+#include "Game.hpp"
+#include "Movement.hpp"
+#include "Render.hpp"
+
+namespace
+{
+    std::atomic<std::uint64_t> gHeapAllocations{0};
+}
+
+void *operator new(size_t bytes)
+{
+    gHeapAllocations.fetch_add(1, std::memory_order_relaxed);
+    if (void *pointer = std::malloc(bytes ? bytes : 1))
+    {
+        return pointer;
+    }
+    throw std::bad_alloc();
+}
+
+void *operator new(size_t bytes, std::align_val_t alignment)
+{
+    gHeapAllocations.fetch_add(1, std::memory_order_relaxed);
+    size_t align = static_cast<size_t>(alignment);
+    if (void *pointer = std::aligned_alloc(align, (bytes + align - 1) / align * align))
+    {
+        return pointer;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void *pointer) noexcept { std::free(pointer); }
+
+void operator delete(void *pointer, size_t) noexcept { std::free(pointer); }
+
+void operator delete(void *pointer, std::align_val_t) noexcept { std::free(pointer); }
+
+void operator delete(void *pointer, size_t, std::align_val_t) noexcept { std::free(pointer); }
+
+namespace
+{
+    const int WARM_UP_FRAMES = 120;
+    const int MEASURED_FRAMES = 240;
+
+    // bodies stay in a square of this half side, so the collision grid stops growing
+    const float ARENA = 2048.0f;
+
+    // turns the bodies that left the arena around, recording the change of their Velocity
+    class BounceSystem : public System
+    {
+    public:
+        void init(Game &game)
+        {
+            mGame = &game;
+            Signature signature;
+            signature.set(game.GetComponentType<Position>());
+            signature.set(game.GetComponentType<Velocity>());
+            game.SetSystemSignature<BounceSystem>(signature);
+            game.SetSystemAccess<BounceSystem>(Reads<Position>{}, Writes<Velocity>{});
+        }
+
+        void update() override
+        {
+            mGame->View<Position, Velocity>().each([this](Entity entity, const Position &position, Velocity &velocity)
+                                                   {
+                if ((position.x < -ARENA && velocity.x < 0.0f) || (position.x > ARENA && velocity.x > 0.0f))
+                {
+                    velocity.x = -velocity.x;
+                    mGame->MarkChanged<Velocity>(entity);
+                }
+                if ((position.y < -ARENA && velocity.y < 0.0f) || (position.y > ARENA && velocity.y > 0.0f))
+                {
+                    velocity.y = -velocity.y;
+                    mGame->MarkChanged<Velocity>(entity);
+                } });
+        }
+
+    private:
+        Game *mGame{};
+    };
+
+    // destroys the first waveSize bodies of its set and spawns as many where they were, through the
+    // command buffer
+    class WaveSystem : public System
+    {
+    public:
+        void init(Game &game, size_t waveSize, float maxSpeed)
+        {
+            mGame = &game;
+            mWaveSize = waveSize;
+            mMaxSpeed = maxSpeed;
+            Signature signature;
+            signature.set(game.GetComponentType<Collider>());
+            game.SetSystemSignature<WaveSystem>(signature);
+        }
+
+        void update() override
+        {
+            CommandBuffer &commands = mGame->GetCommandBuffer();
+            for (size_t index = 0; index < mWaveSize && index < mEntities.size(); ++index)
+            {
+                Entity entity = mEntities[index];
+                spawn(commands, mGame->GetComponent<Position>(entity), mGame->GetComponent<Velocity>(entity));
+                commands.destroyEntity(entity);
+            }
+        }
+
+        void spawn(CommandBuffer &commands)
+        {
+            std::uniform_real_distribution<float> coordinate(-ARENA, ARENA);
+            std::uniform_real_distribution<float> speed(-mMaxSpeed, mMaxSpeed);
+            spawn(commands, {coordinate(mRandom), coordinate(mRandom)}, {speed(mRandom), speed(mRandom)});
+        }
+
+        void spawn(CommandBuffer &commands, Position position, Velocity velocity)
+        {
+            PendingEntity entity = commands.createEntity();
+            commands.attachComponent(entity, position);
+            commands.attachComponent(entity, velocity);
+            commands.attachComponent(entity, Acceleration{0.0f, 0.0f});
+            commands.attachComponent(entity, Collider{8.0f, 8.0f});
+            commands.attachComponent(entity, Sprite{static_cast<std::uint32_t>(mRandom() % 8), 0.0f, 0.0f, 16.0f,
+                                                    16.0f, 16.0f, 16.0f, 0, SPRITE_WHITE});
+        }
+
+    private:
+        Game *mGame{};
+        size_t mWaveSize{};
+        float mMaxSpeed{};
+        std::mt19937 mRandom{42};
+    };
+
+    /** the same attach recorded into two threads' buffers, onto an entity owning the component already and
+     * onto one that does not, plus two attaches onto a pending entity: each entity must come out with one
+     * component, the last one recorded (the buffer first asked for plays back first) */
+    bool duplicateAttachesPlayBack(StorageBackend backend)
+    {
+        Game game(16, backend);
+        game.RegisterComponent<Velocity>();
+        Entity owning = game.CreateEntity();
+        Entity bare = game.CreateEntity();
+        game.AttachComponent(owning, Velocity{1.0f, 1.0f});
+
+        CommandBuffer &first = game.GetCommandBuffer();
+        first.attachComponent(owning, Velocity{2.0f, 2.0f});
+        first.attachComponent(bare, Velocity{2.0f, 2.0f});
+        PendingEntity pending = first.createEntity();
+        first.attachComponent(pending, Velocity{2.0f, 2.0f});
+        first.attachComponent(pending, Velocity{3.0f, 3.0f});
+        std::thread([&game, owning, bare]
+                    {
+            CommandBuffer &second = game.GetCommandBuffer();
+            second.attachComponent(owning, Velocity{3.0f, 3.0f});
+            second.attachComponent(bare, Velocity{3.0f, 3.0f}); })
+            .join();
+        game.FlushCommands();
+
+        size_t count = 0;
+        bool lastWon = true;
+        game.View<Velocity>().each([&](const Velocity &velocity)
+                                   {
+            ++count;
+            lastWon &= velocity.x == 3.0f && velocity.y == 3.0f; });
+        bool passed = count == 3 && lastWon;
+        std::printf("duplicate attaches, %s backend: %s\n",
+                    backend == StorageBackend::SparseSet ? "sparse set" : "archetype", passed ? "ok" : "FAILED");
+        return passed;
+    }
+
+    // returns false when a measured frame allocated while it should not have
+    bool run(size_t bodyCount, size_t workerCount, bool moving)
+    {
+        size_t waveSize = bodyCount / 50;
+        Game game(static_cast<Entity>(bodyCount + waveSize));
+        game.RegisterComponent<Position>();
+        game.RegisterComponent<Velocity>();
+        game.RegisterComponent<Acceleration>();
+        game.RegisterComponent<Collider>();
+        game.RegisterComponent<Sprite>();
+        game.TrackChanges<Position>();
+        game.TrackChanges<Collider>();
+        game.SetWorkerCount(workerCount);
+
+        size_t detached = 0;
+        size_t destroyed = 0;
+        game.OnDetach<Collider>([&](const Entity *, const Collider *, size_t count)
+                                { detached += count; });
+        game.OnDestroy([&](const Entity *, size_t count)
+                       { destroyed += count; });
+
+        auto wave = game.RegisterSystem<WaveSystem>();
+        wave->init(game, waveSize, moving ? 64.0f : 0.0f);
+        auto bounce = game.RegisterSystem<BounceSystem>();
+        bounce->init(game);
+        auto movement = game.RegisterSystem<MovementSystem>();
+        movement->init(game);
+        auto collision = game.RegisterSystem<CollisionSystem>();
+        collision->init(game);
+        auto render = game.RegisterSystem<SpriteRenderSystem>();
+        render->init(game);
+
+        CommandBuffer &commands = game.GetCommandBuffer();
+        for (size_t index = 0; index < bodyCount; ++index)
+        {
+            wave->spawn(commands);
+        }
+        game.FlushCommands();
+
+        for (int frame = 0; frame < WARM_UP_FRAMES; ++frame)
+        {
+            game.UpdateSystems();
+        }
+
+        std::uint64_t worldAllocations = 0;
+        std::uint64_t worldHeapAllocations = 0;
+        std::uint64_t heapBefore = gHeapAllocations.load(std::memory_order_relaxed);
+        for (int frame = 0; frame < MEASURED_FRAMES; ++frame)
+        {
+            game.UpdateSystems();
+            MemoryStats stats = game.GetMemoryStats();
+            worldAllocations += stats.lastFrameAllocations;
+            worldHeapAllocations += stats.lastFrameHeapAllocations;
+        }
+        // GetMemoryStats fills two vectors per call
+        std::uint64_t heapAllocations = gHeapAllocations.load(std::memory_order_relaxed) - heapBefore -
+                                        2 * static_cast<std::uint64_t>(MEASURED_FRAMES);
+
+        MemoryStats stats = game.GetMemoryStats();
+        size_t reserved = stats.entityTable.reservedBytes;
+        size_t used = stats.entityTable.usedBytes;
+        for (const ComponentPoolMemory &pool : stats.pools)
+        {
+            reserved += pool.usage.reservedBytes;
+            used += pool.usage.usedBytes;
+        }
+        for (const SystemSetMemory &system : stats.systems)
+        {
+            reserved += system.usage.reservedBytes;
+            used += system.usage.usedBytes;
+        }
+
+        bool passed = moving || heapAllocations == 0;
+        std::printf("%8zu %8s %8zu %10.2f %10.2f %10.2f %12.1f %12.1f%s\n", bodyCount, moving ? "moving" : "still",
+                    workerCount,
+                    static_cast<double>(worldAllocations) / MEASURED_FRAMES,
+                    static_cast<double>(worldHeapAllocations) / MEASURED_FRAMES,
+                    static_cast<double>(heapAllocations) / MEASURED_FRAMES, static_cast<double>(reserved) / 1024.0,
+                    static_cast<double>(used) / 1024.0, passed ? "" : "  FAILED");
+        return passed && detached > 0 && destroyed > 0;
+    }
+}
+
+int main()
+{
+    if (!duplicateAttachesPlayBack(StorageBackend::SparseSet) || !duplicateAttachesPlayBack(StorageBackend::Archetype))
+    {
+        return 1;
+    }
+
+    std::printf("%8s %8s %8s %10s %10s %10s %12s %12s\n", "bodies", "motion", "workers", "world/f", "pool/f",
+                "heap/f", "reserved KiB", "used KiB");
+    bool passed = true;
+    for (size_t bodyCount : {1000, 10000, 20000})
+    {
+        for (bool moving : {false, true})
+        {
+            passed &= run(bodyCount, 0, moving);
+            passed &= run(bodyCount, 4, moving);
+        }
+    }
+
+    if (!passed)
+    {
+        std::printf("a steady-state frame allocated\n");
+        return 1;
+    }
+    return 0;
+}
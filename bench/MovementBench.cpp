@@ -0,0 +1,107 @@
+// integration throughput: the naive per-entity GetComponent loop against MovementSystem
+// and the integrateMotion kernel at every SIMD level. Build from the repository root with
+//     g++ -std=c++17 -O2 -Isrc/headers bench/MovementBench.cpp src/*.cpp -pthread -o movement_bench
+// or with `make bench`, into build/bench/movement_bench
+
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+#include "Game.hpp"
+#include "Movement.hpp"
+
+namespace
+{
+    const int FRAMES = 50;
+
+    // the entities the naive loop visits, the way a system without the kernel would
+    class NaiveMovementSystem : public System
+    {
+    public:
+        void update() override {}
+    };
+
+    template <typename Func>
+    double microsecondsPerFrame(Func &&func)
+    {
+        func(); // warm up
+        auto start = std::chrono::steady_clock::now();
+        for (int frame = 0; frame < FRAMES; ++frame)
+        {
+            func();
+        }
+        std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+        return elapsed.count() / FRAMES;
+    }
+
+    void run(size_t entityCount)
+    {
+        Game game(static_cast<Entity>(entityCount));
+        game.RegisterComponent<Position>();
+        game.RegisterComponent<Velocity>();
+        game.RegisterComponent<Acceleration>();
+
+        auto movement = game.RegisterSystem<MovementSystem>();
+        movement->init(game);
+        auto naive = game.RegisterSystem<NaiveMovementSystem>();
+        Signature signature;
+        signature.set(game.GetComponentType<Position>());
+        signature.set(game.GetComponentType<Velocity>());
+        signature.set(game.GetComponentType<Acceleration>());
+        game.SetSystemSignature<NaiveMovementSystem>(signature);
+
+        std::vector<Entity> entities(entityCount);
+        game.CreateEntities(entityCount, entities.data());
+        std::vector<Position> positions(entityCount, Position{0.0f, 0.0f});
+        std::vector<Velocity> velocities(entityCount, Velocity{1.0f, 2.0f});
+        std::vector<Acceleration> accelerations(entityCount, Acceleration{0.0f, -9.8f});
+        game.AttachComponents<Position, Velocity, Acceleration>(entities.data(), entityCount, positions.data(),
+                                                                velocities.data(), accelerations.data());
+
+        const float dt = DEFAULT_TIME_STEP;
+
+        double naiveTime = microsecondsPerFrame([&]
+                                                {
+            for (Entity entity : naive->mEntities)
+            {
+                Position &position = game.GetComponent<Position>(entity);
+                Velocity &velocity = game.GetComponent<Velocity>(entity);
+                const Acceleration &acceleration = game.GetComponent<Acceleration>(entity);
+                velocity.x += acceleration.x * dt;
+                velocity.y += acceleration.y * dt;
+                position.x += velocity.x * dt;
+                position.y += velocity.y * dt;
+            } });
+
+        double systemTime = microsecondsPerFrame([&]
+                                                 { movement->update(); });
+
+        // the kernel alone over plain arrays, one run per level
+        double kernelTimes[3];
+        for (int level = 0; level < 3; ++level)
+        {
+            kernelTimes[level] = microsecondsPerFrame([&]
+                                                      { integrateMotion(positions.data(), velocities.data(),
+                                                                        accelerations.data(), entityCount, dt,
+                                                                        static_cast<SimdLevel>(level)); });
+        }
+
+        std::printf("%10zu %12.1f %12.1f %12.1f %12.1f %12.1f %9.1fx\n", entityCount, naiveTime, systemTime,
+                    kernelTimes[0], kernelTimes[1], kernelTimes[2], naiveTime / systemTime);
+    }
+}
+
+int main()
+{
+    const char *levels[] = {"scalar", "SSE2", "AVX2"};
+    std::printf("kernel level on this CPU: %s, times in microseconds per frame\n",
+                levels[static_cast<int>(getSimdLevel())]);
+    std::printf("%10s %12s %12s %12s %12s %12s %10s\n", "entities", "naive", "system", "scalar", "sse2", "avx2",
+                "speedup");
+
+    for (size_t entityCount : {10000, 100000, 1000000})
+    {
+        run(entityCount);
+    }
+    return 0;
+}
@@ -0,0 +1,112 @@
+// sprite batch building without a display: the time SpriteRenderSystem takes to sort and fill the
+// vertex buffer, and the draw calls it ends up with, for a range of sprite, texture and layer counts.
+// Build with `make bench` and run build/bench/render_bench, or build from the repository root with
+//     g++ -std=c++17 -O2 -Isrc/headers bench/RenderBench.cpp src/*.cpp -pthread -o render_bench
+// the run fails when the batches are not in (layer, texture) order or a batch does not hold exactly the
+// sprites of its pair
+
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "Game.hpp"
+#include "Render.hpp"
+
+namespace
+{
+    const int FRAMES = 20;
+
+    // one batch per (layer, texture) pair in increasing order, back to back, six vertices per sprite
+    bool batchesMatch(const SpriteRenderSystem &render, const std::vector<Sprite> &sprites)
+    {
+        std::map<std::pair<std::int16_t, std::uint32_t>, size_t> expected;
+        for (const Sprite &sprite : sprites)
+        {
+            ++expected[{sprite.layer, sprite.texture}];
+        }
+
+        const std::vector<SpriteBatch> &batches = render.getBatches();
+        if (batches.size() != expected.size())
+        {
+            return false;
+        }
+        size_t nextVertex = 0;
+        auto pair = expected.begin();
+        for (const SpriteBatch &batch : batches)
+        {
+            if (batch.layer != pair->first.first || batch.texture != pair->first.second ||
+                batch.firstVertex != nextVertex || batch.vertexCount != SPRITE_VERTEX_COUNT * pair->second)
+            {
+                return false;
+            }
+            nextVertex += batch.vertexCount;
+            ++pair;
+        }
+        return nextVertex == render.getVertexCount();
+    }
+
+    // returns false when the batches are off
+    bool run(size_t spriteCount, std::uint32_t textureCount, std::int16_t layerCount)
+    {
+        Game game(static_cast<Entity>(spriteCount));
+        game.RegisterComponent<Position>();
+        game.RegisterComponent<Sprite>();
+        auto render = game.RegisterSystem<SpriteRenderSystem>();
+        render->init(game);
+
+        std::mt19937 random(42);
+        std::uniform_real_distribution<float> coordinate(0.0f, 4096.0f);
+        std::vector<Entity> entities(spriteCount);
+        std::vector<Position> positions(spriteCount);
+        std::vector<Sprite> sprites(spriteCount);
+        for (size_t index = 0; index < spriteCount; ++index)
+        {
+            positions[index] = {coordinate(random), coordinate(random)};
+            auto texture = static_cast<std::uint32_t>(random() % textureCount);
+            auto layer = static_cast<std::int16_t>(random() % static_cast<std::uint32_t>(layerCount));
+            sprites[index] = {texture, 0.0f, 0.0f, 16.0f, 16.0f, 16.0f, 16.0f, layer, SPRITE_WHITE};
+        }
+        game.CreateEntities(spriteCount, entities.data());
+        game.AttachComponents<Position, Sprite>(entities.data(), spriteCount, positions.data(), sprites.data());
+
+        render->update(); // warm up, the buffers reach their size
+        auto start = std::chrono::steady_clock::now();
+        for (int frame = 0; frame < FRAMES; ++frame)
+        {
+            render->update();
+        }
+        std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+
+        bool passed = batchesMatch(*render, sprites);
+        double perFrame = elapsed.count() / FRAMES;
+        std::printf("%10zu %9u %7d %12.1f %10.2f %11zu%s\n", spriteCount, textureCount, layerCount, perFrame,
+                    perFrame * 1000.0 / static_cast<double>(spriteCount), render->getBatches().size(),
+                    passed ? "" : "  FAILED");
+        return passed;
+    }
+}
+
+int main()
+{
+    std::printf("%10s %9s %7s %12s %10s %11s\n", "sprites", "textures", "layers", "us/frame", "ns/sprite",
+                "draw calls");
+    bool passed = true;
+    for (size_t spriteCount : {10000, 100000, 1000000})
+    {
+        passed &= run(spriteCount, 1, 1);
+        passed &= run(spriteCount, 8, 4);
+        passed &= run(spriteCount, 64, 16);
+        // texture indices past 16 bits, e.g. one texture per sprite
+        passed &= run(spriteCount, 100000, 4);
+    }
+
+    if (!passed)
+    {
+        std::printf("the batches do not match the sprites\n");
+        return 1;
+    }
+    return 0;
+}
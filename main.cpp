@@ -1,16 +1,203 @@
+#include <algorithm>
+#include <cstdio>
+#include <vector>
 
+#include "Collision.hpp"
+#include "Game.hpp"
+#include "GameLoop.hpp"
+#include "Movement.hpp"
+#include "Profiler.hpp"
+#include "TileMap.hpp"
 
+// tells Mario apart from the goombas
+struct Player
+{
+};
 
-int main (){
+struct Enemy
+{
+};
+
+namespace
+{
+    const float GRAVITY = -900.0f;
+    const float RUN_SPEED = 150.0f;
+    const float JUMP_SPEED = 380.0f;
+    const float GOOMBA_SPEED = -30.0f;
+    const int GOOMBA_COUNT = 10;
+    const float GOOMBA_SPACING = 200.0f;
+    const float FLAG_X = 200.0f + GOOMBA_COUNT * GOOMBA_SPACING + 200.0f;
+
+    // the level is a row of ground tiles just below y = 0 with the goombas as map objects
+    const float TILE_SIZE = 16.0f;
+    const std::uint16_t GROUND_TILE = 1;
+    const std::uint32_t GOOMBA_OBJECT = 1;
+    const char *LEVEL_PATH = "level.tmap";
+
+    // the run is over once Mario reaches the flag or runs into a goomba, or after this much simulated time
+    const double MAX_SIMULATED_SECONDS = 60.0;
+
+    TileMapData buildLevel()
+    {
+        TileMapData level;
+        level.width = static_cast<std::uint32_t>(FLAG_X / TILE_SIZE) + 32;
+        level.height = 2;
+        level.tileSize = TILE_SIZE;
+        level.originY = -TILE_SIZE;
+        level.tiles.assign(size_t{level.width} * level.height, EMPTY_TILE);
+        std::fill(level.tiles.begin(), level.tiles.begin() + level.width, GROUND_TILE);
+
+        for (int index = 0; index < GOOMBA_COUNT; ++index)
+        {
+            level.objects.push_back({GOOMBA_OBJECT, 200.0f + index * GOOMBA_SPACING, 0.0f});
+        }
+        return level;
+    }
+}
+
+int main()
+{
     // load the map, and resource
+    Game game(4096);
+    game.RegisterComponent<Position>();
+    game.RegisterComponent<Velocity>();
+    game.RegisterComponent<Acceleration>();
+    game.RegisterComponent<Collider>();
+    game.RegisterComponent<Player>();
+    game.RegisterComponent<Enemy>();
+    game.RegisterComponent<Tile>();
+    game.RegisterComponent<MapObject>();
+
+    auto movement = game.RegisterSystem<MovementSystem>();
+    movement->init(game);
+    auto collision = game.RegisterSystem<CollisionSystem>();
+    collision->init(game);
+
+    Entity mario = game.CreateEntity();
+    game.AttachComponent(mario, Position{0.0f, 0.0f});
+    game.AttachComponent(mario, Velocity{RUN_SPEED, 0.0f});
+    game.AttachComponent(mario, Acceleration{0.0f, GRAVITY});
+    game.AttachComponent(mario, Collider{8.0f, 16.0f});
+    game.AttachComponent(mario, Player{});
+
+    // the level is streamed in around Mario, goombas get their behaviour as their chunk spawns
+    TileMapStreamer level;
+    std::vector<Velocity> goombaVelocities;
+    std::vector<Acceleration> goombaAccelerations;
+    std::vector<Collider> goombaColliders;
+    std::vector<Enemy> goombaTags;
+    // every object of this level is a goomba
+    level.setObjectSpawner([&](const Entity *entities, const MapObject *, size_t count)
+                           {
+        goombaVelocities.assign(count, Velocity{GOOMBA_SPEED, 0.0f});
+        goombaAccelerations.assign(count, Acceleration{0.0f, 0.0f});
+        goombaColliders.assign(count, Collider{8.0f, 8.0f});
+        goombaTags.assign(count, Enemy{});
+        game.AttachComponents<Velocity, Acceleration, Collider, Enemy>(entities, count, goombaVelocities.data(),
+                                                                        goombaAccelerations.data(),
+                                                                        goombaColliders.data(), goombaTags.data()); });
+    if (!writeTileMap(LEVEL_PATH, buildLevel()) || !level.open(game, LEVEL_PATH))
+    {
+        std::printf("could not write the level to %s\n", LEVEL_PATH);
+        return 1;
+    }
+    level.loadAround(0.0f, 0.0f);
+
+    Profiler &profiler = Profiler::get();
+    profiler.setCapturing(true);
+
+    GameLoop loop;
+    loop.setFrameRateLimit(120.0);
+
+    bool won = false;
+    bool lost = false;
+    std::vector<Entity> ahead;
 
     // get player input
+    loop.setInputStage([&]
+                       {
+        // no window yet: Mario jumps on his own whenever a goomba is right in front of him
+        // spawning and despawning chunks moves components around, so this comes before any reference is taken
+        const Position &camera = game.GetComponent<Position>(mario);
+        level.update(camera.x, camera.y);
+
+        Position &position = game.GetComponent<Position>(mario);
+        Velocity &velocity = game.GetComponent<Velocity>(mario);
+        collision->queryAabb({position.x + 8.0f, position.y - 16.0f, position.x + 48.0f, position.y + 16.0f}, ahead);
+        bool goombaAhead = false;
+        for (Entity entity : ahead)
+        {
+            goombaAhead |= entity != mario;
+        }
+        if (position.y <= 0.0f && goombaAhead)
+        {
+            velocity.y = JUMP_SPEED;
+        } });
+
+    loop.setUpdateStage([&](double dt)
+                        {
+        // update player position, check for collision
+        movement->setTimeStep(static_cast<float>(dt));
+        game.UpdateSystems();
+
+        // the ground
+        game.View<Position, Velocity>().each([](Position &position, Velocity &velocity)
+                                             {
+            if (position.y < 0.0f)
+            {
+                position.y = 0.0f;
+                velocity.y = 0.0f;
+            } });
+
+        // check for win/lose condition
+        {
+            ECS_PROFILE_SCOPE("rules");
+            auto players = game.View<Player>();
+            auto enemies = game.View<Enemy>();
+            CommandBuffer &commands = game.GetCommandBuffer();
+            for (const CollisionPair &pair : collision->getPairs())
+            {
+                Entity enemy = enemies.contains(pair.first) ? pair.first : pair.second;
+                Entity player = enemy == pair.first ? pair.second : pair.first;
+                if (!players.contains(player) || !enemies.contains(enemy))
+                {
+                    continue;
+                }
+
+                // touching a goomba from above squashes it and bounces Mario back up, any other contact is fatal
+                Velocity &velocity = game.GetComponent<Velocity>(player);
+                if (game.GetComponent<Position>(player).y > game.GetComponent<Position>(enemy).y + 8.0f)
+                {
+                    commands.destroyEntity(enemy);
+                    velocity.y = JUMP_SPEED * 0.5f;
+                }
+                else
+                {
+                    lost = true;
+                }
+            }
+            game.FlushCommands();
+        }
 
-    // update player position
+        won = game.GetComponent<Position>(mario).x >= FLAG_X;
+        if (won || lost || loop.getStepCount() * loop.getTimeStep() >= MAX_SIMULATED_SECONDS)
+        {
+            loop.stop();
+        } });
 
-    // check for collision
+    loop.run();
+    // the loader thread must be out of its profiler scopes before the trace is written
+    level.close();
 
-    // check for win/lose condition
+    FrameStats stats = profiler.getFrameStats();
+    std::printf("%s after %.1f s (%llu frames), frame time p50 %.3f ms, p99 %.3f ms, max %.3f ms\n",
+                won ? "Mario reached the flag" : (lost ? "Mario ran into a goomba" : "Out of time"),
+                loop.getStepCount() * loop.getTimeStep(), static_cast<unsigned long long>(loop.getFrameCount()),
+                stats.p50, stats.p99, stats.max);
 
+    if (profiler.writeChromeTrace("trace.json"))
+    {
+        std::printf("trace written to trace.json, open it in chrome://tracing or ui.perfetto.dev\n");
+    }
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,285 @@
+#include "Archetype.hpp"
+
+#include <stdexcept>
+
+namespace
+{
+    size_t alignUp(size_t offset, size_t alignment)
+    {
+        return (offset + alignment - 1) / alignment * alignment;
+    }
+}
+
+Archetype::Archetype(const Signature &signature, const std::array<ComponentColumnInfo, MAX_COMPONENTS> &columnInfo,
+                     std::pmr::memory_resource *resource)
+    : mSignature(signature), mColumns(resource), mResource(resource), mChunks(resource)
+{
+    mColumnOfBit.fill(-1);
+
+    for (size_t bit = 0; bit < MAX_COMPONENTS; ++bit)
+    {
+        if (!signature.test(bit))
+        {
+            continue;
+        }
+        assert(columnInfo[bit].size > 0 && "Component not registered before use.");
+
+        mColumnOfBit[bit] = static_cast<std::int16_t>(mColumns.size());
+        mColumns.push_back({static_cast<ComponentTypeBitPosition>(bit), 0, columnInfo[bit]});
+        mRowBytes += columnInfo[bit].size;
+    }
+
+    // fit as many rows as possible into a chunk once every column is aligned, down to none
+    size_t capacity = ARCHETYPE_CHUNK_BYTES / (mRowBytes + sizeof(Entity));
+    for (; capacity > 0; --capacity)
+    {
+        size_t offset = capacity * sizeof(Entity);
+        for (const Column &column : mColumns)
+        {
+            offset = alignUp(offset, column.info.alignment) + capacity * column.info.size;
+        }
+        if (offset <= ARCHETYPE_CHUNK_BYTES)
+        {
+            break;
+        }
+    }
+    // every row lookup divides by the capacity, this cannot be left to a debug assert
+    if (capacity == 0)
+    {
+        throw std::length_error("Archetype row does not fit into a chunk");
+    }
+    mChunkCapacity = capacity;
+
+    size_t offset = mChunkCapacity * sizeof(Entity);
+    for (Column &column : mColumns)
+    {
+        column.offset = alignUp(offset, column.info.alignment);
+        offset = column.offset + mChunkCapacity * column.info.size;
+    }
+}
+
+Archetype::~Archetype()
+{
+    for (size_t row = 0; row < mSize; ++row)
+    {
+        destroyRow(row);
+    }
+    for (std::byte *chunk : mChunks)
+    {
+        mResource->deallocate(chunk, ARCHETYPE_CHUNK_BYTES, ARCHETYPE_CHUNK_ALIGNMENT);
+    }
+}
+
+size_t Archetype::pushRow(Entity entity)
+{
+    size_t row = mSize;
+    if (row / mChunkCapacity == mChunks.size())
+    {
+        mChunks.push_back(
+            static_cast<std::byte *>(mResource->allocate(ARCHETYPE_CHUNK_BYTES, ARCHETYPE_CHUNK_ALIGNMENT)));
+        assert(reinterpret_cast<std::uintptr_t>(mChunks.back()) % ARCHETYPE_CHUNK_ALIGNMENT == 0 &&
+               "Chunk is not aligned");
+    }
+
+    chunkEntities(row / mChunkCapacity)[row % mChunkCapacity] = entity;
+    ++mSize;
+
+    return row;
+}
+
+Entity Archetype::eraseRow(size_t row)
+{
+    size_t lastRow = mSize - 1;
+    Entity movedEntity = NULL_ENTITY;
+
+    // relocate the last row into the hole to keep the rows packed
+    if (row != lastRow)
+    {
+        for (const Column &column : mColumns)
+        {
+            column.info.relocate(componentAt(column.bit, row), componentAt(column.bit, lastRow));
+        }
+        movedEntity = entityAt(lastRow);
+        chunkEntities(row / mChunkCapacity)[row % mChunkCapacity] = movedEntity;
+    }
+    --mSize;
+
+    // keep one empty chunk around as slack, like the component pages of ComponentArray
+    if (mChunks.size() * mChunkCapacity >= mSize + 2 * mChunkCapacity)
+    {
+        mResource->deallocate(mChunks.back(), ARCHETYPE_CHUNK_BYTES, ARCHETYPE_CHUNK_ALIGNMENT);
+        mChunks.pop_back();
+    }
+
+    return movedEntity;
+}
+
+void Archetype::destroyRow(size_t row)
+{
+    for (const Column &column : mColumns)
+    {
+        column.info.destroy(componentAt(column.bit, row));
+    }
+}
+
+void ArchetypeStorage::detachComponent(Entity entity, ComponentTypeBitPosition bit)
+{
+    assert(hasComponent(entity, bit) && "Component to remove does not exist on Entity.");
+
+    Archetype *source = mLocations[entityIndex(entity)].archetype;
+    migrate(entity, getRemoveEdge(source, bit));
+}
+
+bool ArchetypeStorage::hasComponent(Entity entity, ComponentTypeBitPosition bit) const
+{
+    Entity index = entityIndex(entity);
+    if (index >= mLocations.size())
+    {
+        return false;
+    }
+
+    const EntityLocation &location = mLocations[index];
+    return location.archetype && location.archetype->hasColumn(bit) &&
+           location.archetype->entityAt(location.row) == entity;
+}
+
+void ArchetypeStorage::handleDestroyedEntity(Entity entity)
+{
+    Entity index = entityIndex(entity);
+    if (index >= mLocations.size())
+    {
+        return;
+    }
+
+    EntityLocation &location = mLocations[index];
+    if (!location.archetype || location.archetype->entityAt(location.row) != entity)
+    {
+        return;
+    }
+
+    location.archetype->destroyRow(location.row);
+    eraseRow(location.archetype, location.row);
+    location = {};
+}
+
+ArchetypeStats ArchetypeStorage::getStats() const
+{
+    ArchetypeStats stats;
+    stats.migrations = mMigrations;
+    stats.bytesMoved = mBytesMoved;
+    stats.archetypeCount = mArchetypeList.size();
+    for (const Archetype *archetype : mArchetypeList)
+    {
+        stats.chunkCount += archetype->chunkCount();
+    }
+    return stats;
+}
+
+ArchetypeStorage::EntityLocation &ArchetypeStorage::locationOf(Entity entity)
+{
+    Entity index = entityIndex(entity);
+    if (index >= mLocations.size())
+    {
+        mLocations.resize(index + 1);
+    }
+    return mLocations[index];
+}
+
+Archetype *ArchetypeStorage::getOrCreateArchetype(const Signature &signature)
+{
+    if (signature.none())
+    {
+        return nullptr;
+    }
+
+    auto &archetype = mArchetypes[signature];
+    if (!archetype)
+    {
+        archetype = std::allocate_shared<Archetype>(ResourceAllocator<Archetype>(mResource), signature, mColumnInfo,
+                                                    mResource);
+        mArchetypeList.push_back(archetype.get());
+    }
+    return archetype.get();
+}
+
+Archetype *ArchetypeStorage::getAddEdge(Archetype *source, ComponentTypeBitPosition bit)
+{
+    if (!source)
+    {
+        Signature signature;
+        signature.set(bit);
+        return getOrCreateArchetype(signature);
+    }
+
+    if (!source->mAddEdges[bit])
+    {
+        Signature signature = source->getSignature();
+        signature.set(bit);
+        source->mAddEdges[bit] = getOrCreateArchetype(signature);
+        source->mAddEdges[bit]->mRemoveEdges[bit] = source;
+    }
+    return source->mAddEdges[bit];
+}
+
+Archetype *ArchetypeStorage::getRemoveEdge(Archetype *source, ComponentTypeBitPosition bit)
+{
+    if (!source->mRemoveEdges[bit])
+    {
+        Signature signature = source->getSignature();
+        signature.reset(bit);
+
+        Archetype *target = getOrCreateArchetype(signature);
+        if (!target)
+        {
+            return nullptr;
+        }
+        source->mRemoveEdges[bit] = target;
+        target->mAddEdges[bit] = source;
+    }
+    return source->mRemoveEdges[bit];
+}
+
+size_t ArchetypeStorage::migrate(Entity entity, Archetype *target)
+{
+    EntityLocation &location = locationOf(entity);
+    Archetype *source = location.archetype;
+    size_t sourceRow = location.row;
+
+    size_t targetRow = target ? target->pushRow(entity) : 0;
+
+    if (source)
+    {
+        for (const Archetype::Column &column : source->mColumns)
+        {
+            void *component = source->componentAt(column.bit, sourceRow);
+            if (target && target->hasColumn(column.bit))
+            {
+                column.info.relocate(target->componentAt(column.bit, targetRow), component);
+                mBytesMoved += column.info.size;
+            }
+            else
+            {
+                column.info.destroy(component);
+            }
+        }
+        eraseRow(source, sourceRow);
+        ++mMigrations;
+    }
+
+    // eraseRow may have touched the location table, so look the entity up again
+    EntityLocation &newLocation = mLocations[entityIndex(entity)];
+    newLocation.archetype = target;
+    newLocation.row = targetRow;
+
+    return targetRow;
+}
+
+void ArchetypeStorage::eraseRow(Archetype *archetype, size_t row)
+{
+    Entity movedEntity = archetype->eraseRow(row);
+    if (movedEntity != NULL_ENTITY)
+    {
+        mLocations[entityIndex(movedEntity)].row = row;
+        mBytesMoved += archetype->rowBytes();
+    }
+}
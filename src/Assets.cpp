@@ -0,0 +1,373 @@
+#include "Assets.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+#include "Profiler.hpp"
+
+#if defined(ECS_WITH_SFML)
+#include <SFML/Graphics/Image.hpp>
+#endif
+
+namespace
+{
+    const size_t BYTES_PER_PIXEL = 4;
+
+#if defined(ECS_WITH_SFML)
+    bool decodeWithSfml(const std::string &path, Image &out)
+    {
+        sf::Image image;
+        if (!image.loadFromFile(path))
+        {
+            return false;
+        }
+        out.width = image.getSize().x;
+        out.height = image.getSize().y;
+        const sf::Uint8 *pixels = image.getPixelsPtr();
+        out.pixels.assign(pixels, pixels + size_t{out.width} * out.height * BYTES_PER_PIXEL);
+        return true;
+    }
+#endif
+}
+
+SkylinePacker::SkylinePacker(std::uint32_t width, std::uint32_t height)
+    : mWidth(width), mHeight(height)
+{
+    assert(width > 0 && height > 0 && "A page must not be empty");
+    mSkyline.push_back({0, 0, width});
+}
+
+bool SkylinePacker::fitAt(size_t index, std::uint32_t width, std::uint32_t height, std::uint32_t &y,
+                          std::uint64_t &waste) const
+{
+    std::uint32_t x = mSkyline[index].x;
+    if (x + width > mWidth)
+    {
+        return false;
+    }
+
+    // the rectangle rests on the highest segment it spans
+    y = 0;
+    std::uint32_t widthLeft = width;
+    for (size_t segment = index; widthLeft > 0; ++segment)
+    {
+        y = std::max(y, mSkyline[segment].y);
+        widthLeft -= std::min(widthLeft, mSkyline[segment].width);
+    }
+    if (y + height > mHeight)
+    {
+        return false;
+    }
+
+    waste = 0;
+    widthLeft = width;
+    for (size_t segment = index; widthLeft > 0; ++segment)
+    {
+        std::uint32_t covered = std::min(widthLeft, mSkyline[segment].width);
+        waste += std::uint64_t{y - mSkyline[segment].y} * covered;
+        widthLeft -= covered;
+    }
+    return true;
+}
+
+bool SkylinePacker::insert(std::uint32_t width, std::uint32_t height, std::uint32_t &x, std::uint32_t &y)
+{
+    size_t bestIndex = mSkyline.size();
+    std::uint32_t bestEdge = 0;
+    std::uint64_t bestWaste = 0;
+    for (size_t index = 0; index < mSkyline.size(); ++index)
+    {
+        std::uint32_t top;
+        std::uint64_t waste;
+        if (!fitAt(index, width, height, top, waste))
+        {
+            continue;
+        }
+        if (bestIndex == mSkyline.size() || top + height < bestEdge ||
+            (top + height == bestEdge && waste < bestWaste))
+        {
+            bestIndex = index;
+            bestEdge = top + height;
+            bestWaste = waste;
+        }
+    }
+    if (bestIndex == mSkyline.size() || width == 0 || height == 0)
+    {
+        return false;
+    }
+
+    x = mSkyline[bestIndex].x;
+    y = bestEdge - height;
+    mSkyline.insert(mSkyline.begin() + bestIndex, {x, bestEdge, width});
+
+    // the segments now under the rectangle are cut back to its right edge, or dropped
+    std::uint32_t right = x + width;
+    size_t next = bestIndex + 1;
+    while (next < mSkyline.size() && mSkyline[next].x < right)
+    {
+        std::uint32_t end = mSkyline[next].x + mSkyline[next].width;
+        if (end <= right)
+        {
+            mSkyline.erase(mSkyline.begin() + next);
+            continue;
+        }
+        mSkyline[next].width = end - right;
+        mSkyline[next].x = right;
+        break;
+    }
+
+    // neighbours at the same height are one segment
+    for (size_t index = 0; index + 1 < mSkyline.size();)
+    {
+        if (mSkyline[index].y == mSkyline[index + 1].y)
+        {
+            mSkyline[index].width += mSkyline[index + 1].width;
+            mSkyline.erase(mSkyline.begin() + index + 1);
+        }
+        else
+        {
+            ++index;
+        }
+    }
+
+    mUsedArea += std::uint64_t{width} * height;
+    return true;
+}
+
+AssetCache::AssetCache(ThreadPool *pool, std::uint32_t pageSize, std::uint32_t padding)
+    : mPool(pool), mPageSize(pageSize), mPadding(padding)
+{
+    assert(pageSize > padding && "Atlas pages must have room for more than their padding");
+#if defined(ECS_WITH_SFML)
+    mDecoder = decodeWithSfml;
+#endif
+}
+
+AssetCache::~AssetCache()
+{
+    wait();
+}
+
+TextureHandle AssetCache::load(const std::string &path)
+{
+    std::weak_ptr<TextureAsset> &entry = mAssets[path];
+    if (std::shared_ptr<TextureAsset> asset = entry.lock())
+    {
+        return asset;
+    }
+
+    auto asset = std::make_shared<TextureAsset>();
+    asset->mPath = path;
+    entry = asset;
+
+    if (mPool)
+    {
+        // the task holds a reference to the asset of its own, a load allocates anyway
+        struct Load
+        {
+            AssetCache *cache;
+            std::shared_ptr<TextureAsset> asset;
+        };
+        mPool->submit(mLoads, [](void *context, size_t, size_t)
+                      {
+            std::unique_ptr<Load> load(static_cast<Load *>(context));
+            load->cache->decode(load->asset); },
+                      new Load{this, asset});
+    }
+    else
+    {
+        decode(asset);
+    }
+    return asset;
+}
+
+TextureHandle AssetCache::insert(const std::string &name, Image image)
+{
+    assert(image.pixels.size() == size_t{image.width} * image.height * BYTES_PER_PIXEL &&
+           "An image holds width * height RGBA pixels");
+
+    // an empty image would be packed as an empty rectangle, which no page has room for. decode fails those too
+    if (image.width == 0 || image.height == 0)
+    {
+        return nullptr;
+    }
+
+    std::weak_ptr<TextureAsset> &entry = mAssets[name];
+    if (!entry.expired())
+    {
+        return nullptr;
+    }
+
+    auto asset = std::make_shared<TextureAsset>();
+    asset->mPath = name;
+    asset->mWidth = image.width;
+    asset->mHeight = image.height;
+    asset->mImage = std::move(image);
+    asset->mState.store(AssetState::Ready, std::memory_order_relaxed);
+    entry = asset;
+    return asset;
+}
+
+void AssetCache::wait()
+{
+    if (mPool)
+    {
+        mPool->wait(mLoads);
+    }
+}
+
+void AssetCache::decode(const std::shared_ptr<TextureAsset> &asset)
+{
+    ECS_PROFILE_SCOPE("decode texture");
+
+    Image image;
+    bool decoded = mDecoder && mDecoder(asset->mPath, image) && image.width > 0 && image.height > 0 &&
+                   image.pixels.size() == size_t{image.width} * image.height * BYTES_PER_PIXEL;
+    if (decoded)
+    {
+        asset->mWidth = image.width;
+        asset->mHeight = image.height;
+        asset->mImage = std::move(image);
+    }
+    asset->mState.store(decoded ? AssetState::Ready : AssetState::Failed, std::memory_order_release);
+}
+
+size_t AssetCache::buildAtlas()
+{
+    mToPack.clear();
+    for (auto iterator = mAssets.begin(); iterator != mAssets.end();)
+    {
+        std::shared_ptr<TextureAsset> asset = iterator->second.lock();
+        if (!asset)
+        {
+            iterator = mAssets.erase(iterator);
+            continue;
+        }
+        if (asset->getState() == AssetState::Ready && !asset->mPacked)
+        {
+            mToPack.push_back(std::move(asset));
+        }
+        ++iterator;
+    }
+
+    // tallest first suits the skyline best, the path only makes the layout the same from run to run
+    std::sort(mToPack.begin(), mToPack.end(),
+              [](const std::shared_ptr<TextureAsset> &first, const std::shared_ptr<TextureAsset> &second)
+              {
+                  if (first->mHeight != second->mHeight)
+                  {
+                      return first->mHeight > second->mHeight;
+                  }
+                  if (first->mWidth != second->mWidth)
+                  {
+                      return first->mWidth > second->mWidth;
+                  }
+                  return first->mPath < second->mPath;
+              });
+
+    for (const std::shared_ptr<TextureAsset> &asset : mToPack)
+    {
+        pack(*asset);
+    }
+
+    size_t packed = mToPack.size();
+    mToPack.clear();
+    return packed;
+}
+
+void AssetCache::pack(TextureAsset &asset)
+{
+    std::uint32_t width = asset.mWidth;
+    std::uint32_t height = asset.mHeight;
+    bool shared = width + mPadding <= mPageSize && height + mPadding <= mPageSize;
+
+    auto page = static_cast<std::uint32_t>(mPages.size());
+    std::uint32_t x = 0;
+    std::uint32_t y = 0;
+    if (shared)
+    {
+        for (std::uint32_t openPage : mOpenPages)
+        {
+            if (mPages[openPage].packer.insert(width + mPadding, height + mPadding, x, y))
+            {
+                page = openPage;
+                break;
+            }
+        }
+    }
+
+    if (page == mPages.size())
+    {
+        std::uint32_t pageWidth = shared ? mPageSize : width;
+        std::uint32_t pageHeight = shared ? mPageSize : height;
+        mPages.push_back({SkylinePacker(pageWidth, pageHeight),
+                          Image{pageWidth, pageHeight,
+                                std::vector<std::uint8_t>(size_t{pageWidth} * pageHeight * BYTES_PER_PIXEL)}});
+        bool inserted = mPages.back().packer.insert(shared ? width + mPadding : width,
+                                                    shared ? height + mPadding : height, x, y);
+        assert(inserted && "A fresh page always has room for one image");
+        (void)inserted;
+
+        // the oldest open page is the fullest, it stops being tried
+        if (shared)
+        {
+            if (mOpenPages.size() == ATLAS_OPEN_PAGES)
+            {
+                mOpenPages.erase(mOpenPages.begin());
+            }
+            mOpenPages.push_back(page);
+        }
+    }
+
+    AtlasPage &atlasPage = mPages[page];
+    size_t rowBytes = size_t{width} * BYTES_PER_PIXEL;
+    for (std::uint32_t row = 0; row < height; ++row)
+    {
+        std::memcpy(atlasPage.image.pixels.data() + ((size_t{y} + row) * atlasPage.image.width + x) * BYTES_PER_PIXEL,
+                    asset.mImage.pixels.data() + row * rowBytes, rowBytes);
+    }
+    ++atlasPage.version;
+
+    asset.mRegion = {page, x, y, width, height};
+    asset.mPacked = true;
+    asset.mImage = Image{};
+}
+
+size_t AssetCache::size() const
+{
+    size_t count = 0;
+    for (const auto &pair : mAssets)
+    {
+        count += !pair.second.expired();
+    }
+    return count;
+}
+
+#if defined(ECS_WITH_SFML)
+void AssetCache::uploadAtlas(std::vector<sf::Texture> &textures)
+{
+    if (textures.size() < mPages.size())
+    {
+        textures.resize(mPages.size());
+    }
+    mUploadedVersions.resize(mPages.size(), 0);
+
+    for (size_t page = 0; page < mPages.size(); ++page)
+    {
+        const AtlasPage &atlasPage = mPages[page];
+        if (mUploadedVersions[page] == atlasPage.version)
+        {
+            continue;
+        }
+
+        sf::Texture &texture = textures[page];
+        if (texture.getSize() != sf::Vector2u(atlasPage.image.width, atlasPage.image.height))
+        {
+            texture.create(atlasPage.image.width, atlasPage.image.height);
+        }
+        texture.update(atlasPage.image.pixels.data());
+        mUploadedVersions[page] = atlasPage.version;
+    }
+}
+#endif
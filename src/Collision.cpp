@@ -0,0 +1,319 @@
+#include "Collision.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+SpatialHashGrid::SpatialHashGrid(float cellSize, std::pmr::memory_resource *resource)
+    : mCellSize(cellSize), mInverseCellSize(1.0f / cellSize), mBodies(resource), mBodyData(resource),
+      mCells(resource), mOccupiedCells(resource), mCellIndices(resource), mFreeCells(resource),
+      mCellScratch(resource)
+{
+    assert(cellSize > 0.0f && "Cell size must be positive");
+}
+
+void SpatialHashGrid::update(Entity entity, const Aabb &box)
+{
+    CellRange range = cellRangeOf(box);
+
+    size_t position = mBodies.find(entity);
+    if (position == EntitySet::INVALID_INDEX)
+    {
+        position = mBodies.insert(entity);
+        mBodyData.push_back({box, range});
+        addToCells(static_cast<std::uint32_t>(position), range);
+        return;
+    }
+
+    Body &body = mBodyData[position];
+    body.box = box;
+    if (body.range == range)
+    {
+        return;
+    }
+
+    removeFromCells(static_cast<std::uint32_t>(position), body.range);
+    addToCells(static_cast<std::uint32_t>(position), range);
+    body.range = range;
+}
+
+void SpatialHashGrid::remove(Entity entity)
+{
+    auto position = static_cast<std::uint32_t>(mBodies.index(entity));
+    auto last = static_cast<std::uint32_t>(mBodies.size() - 1);
+
+    removeFromCells(position, mBodyData[position].range);
+
+    // same swap-and-pop as the set, the cells of the moved body have to follow
+    if (position != last)
+    {
+        renameInCells(last, position, mBodyData[last].range);
+        mBodyData[position] = mBodyData[last];
+    }
+    mBodyData.pop_back();
+    mBodies.erase(entity);
+}
+
+void SpatialHashGrid::collectPairs(std::vector<CollisionPair> &out)
+{
+    // out is written past its end and trimmed afterwards, so a hit costs no branch
+    size_t pairCount = 0;
+
+    for (std::uint32_t cellIndex : mOccupiedCells)
+    {
+        const Cell &cell = mCells[cellIndex];
+        const ResourceVector<std::uint32_t> &bodies = cell.bodies;
+        if (bodies.size() < 2)
+        {
+            continue;
+        }
+
+        // gather the cell's bodies once so the n^2 loop below runs on a small contiguous array
+        mCellScratch.clear();
+        for (std::uint32_t body : bodies)
+        {
+            const Body &data = mBodyData[body];
+            mCellScratch.push_back({data.box, data.range.minX, data.range.minY, mBodies[body]});
+        }
+
+        size_t maxPairs = bodies.size() * (bodies.size() - 1) / 2;
+        if (out.size() < pairCount + maxPairs)
+        {
+            out.resize(std::max(out.size() * 2, pairCount + maxPairs));
+        }
+
+        for (size_t first = 0; first + 1 < mCellScratch.size(); ++first)
+        {
+            const CellEntry a = mCellScratch[first];
+            for (size_t second = first + 1; second < mCellScratch.size(); ++second)
+            {
+                const CellEntry &b = mCellScratch[second];
+
+                // the pair belongs to the first cell both bodies cover
+                bool owned = (std::max(a.minCellX, b.minCellX) == cell.x) & (std::max(a.minCellY, b.minCellY) == cell.y);
+                bool overlapping = (a.box.minX <= b.box.maxX) & (b.box.minX <= a.box.maxX) &
+                                   (a.box.minY <= b.box.maxY) & (b.box.minY <= a.box.maxY);
+
+                out[pairCount] = {a.entity, b.entity};
+                pairCount += owned & overlapping;
+            }
+        }
+    }
+
+    out.resize(pairCount);
+}
+
+void SpatialHashGrid::queryAabb(const Aabb &box, std::vector<Entity> &out) const
+{
+    visitAabb(box, [&](std::uint32_t body)
+              { out.push_back(mBodies[body]); });
+}
+
+void SpatialHashGrid::queryRadius(float x, float y, float radius, std::vector<Entity> &out) const
+{
+    float radiusSquared = radius * radius;
+
+    visitAabb({x - radius, y - radius, x + radius, y + radius}, [&](std::uint32_t body)
+              {
+        // distance from the center to the closest point of the box
+        const Aabb &box = mBodyData[body].box;
+        float dx = x - std::clamp(x, box.minX, box.maxX);
+        float dy = y - std::clamp(y, box.minY, box.maxY);
+        if (dx * dx + dy * dy <= radiusSquared)
+        {
+            out.push_back(mBodies[body]);
+        } });
+}
+
+SpatialHashGrid::CellRange SpatialHashGrid::cellRangeOf(const Aabb &box) const
+{
+    return {static_cast<std::int32_t>(std::floor(box.minX * mInverseCellSize)),
+            static_cast<std::int32_t>(std::floor(box.minY * mInverseCellSize)),
+            static_cast<std::int32_t>(std::floor(box.maxX * mInverseCellSize)),
+            static_cast<std::int32_t>(std::floor(box.maxY * mInverseCellSize))};
+}
+
+const SpatialHashGrid::Cell *SpatialHashGrid::findCell(std::int32_t x, std::int32_t y) const
+{
+    auto found = mCellIndices.find(cellKey(x, y));
+    return found != mCellIndices.end() ? &mCells[found->second] : nullptr;
+}
+
+std::uint32_t SpatialHashGrid::getOrCreateCell(std::int32_t x, std::int32_t y)
+{
+    std::uint64_t key = cellKey(x, y);
+    auto found = mCellIndices.find(key);
+    if (found != mCellIndices.end())
+    {
+        return found->second;
+    }
+
+    if (mFreeCells.empty())
+    {
+        auto cellIndex = static_cast<std::uint32_t>(mCells.size());
+        mCellIndices.emplace(key, cellIndex);
+        mCells.push_back({x, y, ResourceVector<std::uint32_t>(mCells.get_allocator()), 0});
+        return cellIndex;
+    }
+
+    CellIndexMap::node_type node = std::move(mFreeCells.back());
+    mFreeCells.pop_back();
+    node.key() = key;
+    std::uint32_t cellIndex = node.mapped();
+    mCellIndices.insert(std::move(node));
+    mCells[cellIndex].x = x;
+    mCells[cellIndex].y = y;
+    return cellIndex;
+}
+
+void SpatialHashGrid::addToCells(std::uint32_t body, const CellRange &range)
+{
+    for (std::int32_t y = range.minY; y <= range.maxY; ++y)
+    {
+        for (std::int32_t x = range.minX; x <= range.maxX; ++x)
+        {
+            std::uint32_t cellIndex = getOrCreateCell(x, y);
+            Cell &cell = mCells[cellIndex];
+            if (cell.bodies.empty())
+            {
+                cell.occupiedIndex = static_cast<std::uint32_t>(mOccupiedCells.size());
+                mOccupiedCells.push_back(cellIndex);
+            }
+            cell.bodies.push_back(body);
+        }
+    }
+}
+
+void SpatialHashGrid::removeFromCells(std::uint32_t body, const CellRange &range)
+{
+    for (std::int32_t y = range.minY; y <= range.maxY; ++y)
+    {
+        for (std::int32_t x = range.minX; x <= range.maxX; ++x)
+        {
+            auto entry = mCellIndices.find(cellKey(x, y));
+            std::uint32_t cellIndex = entry->second;
+            Cell &cell = mCells[cellIndex];
+
+            // cells hold a handful of bodies, a linear search beats keeping back references
+            auto found = std::find(cell.bodies.begin(), cell.bodies.end(), body);
+            *found = cell.bodies.back();
+            cell.bodies.pop_back();
+            if (!cell.bodies.empty())
+            {
+                continue;
+            }
+
+            // swap-and-pop out of the occupied list, then unhashed along with its node for reuse
+            std::uint32_t lastCell = mOccupiedCells.back();
+            mOccupiedCells[cell.occupiedIndex] = lastCell;
+            mCells[lastCell].occupiedIndex = cell.occupiedIndex;
+            mOccupiedCells.pop_back();
+            mFreeCells.push_back(mCellIndices.extract(entry));
+        }
+    }
+}
+
+void SpatialHashGrid::renameInCells(std::uint32_t from, std::uint32_t to, const CellRange &range)
+{
+    for (std::int32_t y = range.minY; y <= range.maxY; ++y)
+    {
+        for (std::int32_t x = range.minX; x <= range.maxX; ++x)
+        {
+            ResourceVector<std::uint32_t> &bodies = mCells[mCellIndices.find(cellKey(x, y))->second].bodies;
+            *std::find(bodies.begin(), bodies.end(), from) = to;
+        }
+    }
+}
+
+template <typename Hit>
+void SpatialHashGrid::visitAabb(const Aabb &box, Hit &&hit) const
+{
+    CellRange range = cellRangeOf(box);
+
+    for (std::int32_t y = range.minY; y <= range.maxY; ++y)
+    {
+        for (std::int32_t x = range.minX; x <= range.maxX; ++x)
+        {
+            const Cell *cell = findCell(x, y);
+            if (!cell)
+            {
+                continue;
+            }
+
+            for (std::uint32_t body : cell->bodies)
+            {
+                const Body &candidate = mBodyData[body];
+                // a body covering several cells of the query is only reported by the first of them
+                if (std::max(candidate.range.minX, range.minX) != x || std::max(candidate.range.minY, range.minY) != y)
+                {
+                    continue;
+                }
+                if (overlaps(candidate.box, box))
+                {
+                    hit(body);
+                }
+            }
+        }
+    }
+}
+
+void CollisionSystem::init(Game &game, float cellSize)
+{
+    mGame = &game;
+    mGrid = SpatialHashGrid(cellSize, game.GetMemoryResource());
+
+    Signature signature;
+    signature.set(game.GetComponentType<Position>());
+    signature.set(game.GetComponentType<Collider>());
+    game.SetSystemSignature<CollisionSystem>(signature);
+}
+
+void CollisionSystem::update()
+{
+    assert(mGame && "CollisionSystem used before init");
+
+    // drop the bodies that lost a component or were destroyed, backwards since removal swaps with the last
+    for (size_t index = mGrid.size(); index-- > 0;)
+    {
+        Entity entity = mGrid.entityAt(index);
+        if (!mEntities.contains(entity))
+        {
+            mGrid.remove(entity);
+        }
+    }
+
+    auto updateBody = [this](Entity entity, Position &position, Collider &collider)
+    {
+        mGrid.update(entity, {position.x - collider.halfWidth, position.y - collider.halfHeight,
+                              position.x + collider.halfWidth, position.y + collider.halfHeight});
+    };
+
+    // with both components tracked only the bodies that moved or were resized since the last update are
+    // visited, newly attached ones included. Filters of a view must all hold, hence one pass per component
+    ComponentArray<Position> *positions = mGame->GetComponentArray<Position>();
+    ComponentArray<Collider> *colliders = mGame->GetComponentArray<Collider>();
+    if (positions && positions->isChangeTracked() && colliders && colliders->isChangeTracked())
+    {
+        std::uint32_t since = std::exchange(mLastChangeTick, mGame->AdvanceChangeTick());
+        mGame->View<Position, Collider>(Changed<Position>{since}).each(updateBody);
+        mGame->View<Position, Collider>(Changed<Collider>{since}).each(updateBody);
+    }
+    else
+    {
+        mGame->View<Position, Collider>().each(updateBody);
+    }
+
+    mGrid.collectPairs(mPairs);
+}
+
+void CollisionSystem::queryAabb(const Aabb &box, std::vector<Entity> &out) const
+{
+    out.clear();
+    mGrid.queryAabb(box, out);
+}
+
+void CollisionSystem::queryRadius(float x, float y, float radius, std::vector<Entity> &out) const
+{
+    out.clear();
+    mGrid.queryRadius(x, y, radius, out);
+}
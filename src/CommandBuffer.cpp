@@ -0,0 +1,48 @@
+#include "CommandBuffer.hpp"
+
+CommandBuffer::~CommandBuffer()
+{
+    clear();
+    for (PayloadBlock &block : mPayloadBlocks)
+    {
+        mResource->deallocate(block.bytes, block.capacity, alignof(std::max_align_t));
+    }
+}
+
+void CommandBuffer::clear()
+{
+    for (Command &command : mCommands)
+    {
+        if (command.destroyPayload)
+        {
+            command.destroyPayload(command.payload);
+        }
+    }
+    mCommands.clear();
+    mPendingCount = 0;
+
+    mCurrentBlock = 0;
+    mCurrentOffset = 0;
+}
+
+void *CommandBuffer::allocatePayload(size_t size, size_t alignment)
+{
+    while (mCurrentBlock < mPayloadBlocks.size())
+    {
+        PayloadBlock &block = mPayloadBlocks[mCurrentBlock];
+        size_t offset = (mCurrentOffset + alignment - 1) / alignment * alignment;
+        if (offset + size <= block.capacity)
+        {
+            mCurrentOffset = offset + size;
+            return block.bytes + offset;
+        }
+        ++mCurrentBlock;
+        mCurrentOffset = 0;
+    }
+
+    size_t capacity = size > COMMAND_PAYLOAD_BLOCK_BYTES ? size : COMMAND_PAYLOAD_BLOCK_BYTES;
+    auto *bytes = static_cast<std::byte *>(mResource->allocate(capacity, alignof(std::max_align_t)));
+    mPayloadBlocks.push_back({bytes, capacity});
+    mCurrentOffset = size;
+    return bytes;
+}
@@ -1,44 +1,106 @@
 #include "Entity.hpp"
 
-EntityManager::EntityManager()
+EntityManager::EntityManager(Entity maxEntities, std::pmr::memory_resource *resource)
+    : mEntities(resource), mSignatures(resource), mMaxEntities(maxEntities)
 {
-    for (Entity entity = 0; entity < MAX_ENTITIES; ++entity)
-    {
-        mAvailableEntities.push(entity);
-    }
+    assert(maxEntities <= MAX_ENTITY_CAPACITY && "Entity capacity exceeds what an Entity handle can index");
 }
 
 Entity EntityManager::createEntity()
 {
-    assert(mNumLivingEntity < MAX_ENTITIES && "Max Entity count exceeded");
+    assert(mNumLivingEntity < mMaxEntities && "Max Entity count exceeded");
 
-    Entity entity = mAvailableEntities.front();
-    mAvailableEntities.pop();
     ++mNumLivingEntity;
 
+    if (mFreeListHead != NULL_ENTITY)
+    {
+        // pop the head of the free list, its slot already carries the bumped generation
+        Entity index = mFreeListHead;
+        Entity node = mEntities[index];
+        mFreeListHead = entityIndex(node);
+
+        Entity entity = makeEntity(index, entityGeneration(node));
+        mEntities[index] = entity;
+        return entity;
+    }
+
+    Entity entity = makeEntity(static_cast<Entity>(mEntities.size()), 0);
+    mEntities.push_back(entity);
+    mSignatures.emplace_back();
+
     return entity;
 }
 
+void EntityManager::createEntities(size_t count, Entity *out)
+{
+    assert(mNumLivingEntity + count <= mMaxEntities && "Max Entity count exceeded");
+
+    mEntities.reserve(mEntities.size() + count);
+    mSignatures.reserve(mSignatures.size() + count);
+
+    for (size_t index = 0; index < count; ++index)
+    {
+        out[index] = createEntity();
+    }
+}
+
 void EntityManager::destroyEntity(Entity entity)
 {
-    assert(entity < MAX_ENTITIES && "Entity out of range.");
+    assert(isAlive(entity) && "Entity is not alive.");
+
+    Entity index = entityIndex(entity);
+    mSignatures[index].reset();
+
+    // turn the slot into the new free list head, bumping the generation for its next owner
+    mEntities[index] = makeEntity(mFreeListHead, entityGeneration(entity) + 1);
+    mFreeListHead = index;
+
+    --mNumLivingEntity;
+}
+
+void EntityManager::restore(const Entity *slots, const Signature *signatures, size_t slotCount,
+                            Entity freeListHead, std::uint32_t livingCount)
+{
+    assert(slotCount <= mMaxEntities && livingCount <= slotCount && "Restored tables exceed the entity capacity");
 
-    mSignatures[entity].reset();
-    mAvailableEntities.push(entity);
+    mEntities.assign(slots, slots + slotCount);
+    mSignatures.assign(signatures, signatures + slotCount);
+    mFreeListHead = freeListHead;
+    mNumLivingEntity = livingCount;
 }
 
-void EntityManager::SetSignature(Entity entity, Signature signature)
+void EntityManager::SetSignature(Entity entity, const Signature &signature)
 {
-    assert(entity < MAX_ENTITIES && "Entity out of range.");
+    assert(isAlive(entity) && "Entity is not alive.");
 
     // Put this entity's signature into the array
-    mSignatures[entity] = signature;
+    mSignatures[entityIndex(entity)] = signature;
 }
 
 Signature EntityManager::GetSignature(Entity entity)
 {
-    assert(entity < MAX_ENTITIES && "Entity out of range.");
+    assert(isAlive(entity) && "Entity is not alive.");
 
     // Get this entity's signature from the array
-    return mSignatures[entity];
+    return mSignatures[entityIndex(entity)];
+}
+
+void EntityManager::query(const Signature &include, const Signature &exclude, std::vector<Entity> &out) const
+{
+    // matching slots are written in place of the handles and turned into handles right after
+    out.resize(mSignatures.size());
+    size_t matched = matchSignatures(mSignatures.data(), mSignatures.size(), include, exclude, out.data());
+
+    size_t living = 0;
+    for (size_t index = 0; index < matched; ++index)
+    {
+        Entity slot = out[index];
+        Entity entity = mEntities[slot];
+        // only an empty include can match a dead slot, whose node does not point at itself
+        if (entityIndex(entity) == slot)
+        {
+            out[living++] = entity;
+        }
+    }
+    out.resize(living);
 }
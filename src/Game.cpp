@@ -1,17 +1,25 @@
-#pragma once
-
 #include "Game.hpp"
 
-Game::Game()
+#include <algorithm>
+#include <fstream>
+
+#include "Snapshot.hpp"
+
+Game::Game(Entity maxEntities, StorageBackend backend)
+    : mCommandBuffers(mMemory.getResource()), mCommandBufferIndices(mMemory.getResource()),
+      mPlaybackCommands(mMemory.getResource()), mPendingEntities(mMemory.getResource()),
+      mPlaybackDestroys(mMemory.getResource()), mTouchedEntities(mMemory.getResource()),
+      mTouchedSignatures(mMemory.getResource()), mBatchSignatures(mMemory.getResource()),
+      mDestroyEvents(mMemory.getResource())
 {
-    init();
+    init(maxEntities, backend);
 }
 
-void Game::init()
+void Game::init(Entity maxEntities, StorageBackend backend)
 {
-    mComponentManager = std::make_unique<ComponentManager>();
-    mEntityManager = std::make_unique<EntityManager>();
-    mSystemManager = std::make_unique<SystemManager>();
+    mComponentManager = std::make_unique<ComponentManager>(backend, mMemory.getResource());
+    mEntityManager = std::make_unique<EntityManager>(maxEntities, mMemory.getResource());
+    mSystemManager = std::make_unique<SystemManager>(mMemory.getResource());
 }
 
 Entity Game::CreateEntity()
@@ -21,61 +29,229 @@ Entity Game::CreateEntity()
 
 void Game::DestroyEntity(Entity entity)
 {
+    Signature signature = mEntityManager->GetSignature(entity);
+
     mEntityManager->destroyEntity(entity);
-    mComponentManager->handleDestroyedEntity(entity);
-    mSystemManager->handleDestroyedEntity(entity);
+    mComponentManager->handleDestroyedEntity(entity, signature);
+    mSystemManager->handleDestroyedEntity(entity, signature);
+    mDestroyEvents.record(entity);
 }
 
-template <typename T>
-void Game::RegisterComponent()
+bool Game::IsAlive(Entity entity) const
 {
-    mComponentManager->RegisterComponent<T>();
+    return mEntityManager->isAlive(entity);
 }
 
-template <typename T>
-void Game::AttachComponent(Entity entity, T component)
+void Game::CreateEntities(size_t count, Entity *out)
 {
-    mComponentManager->AttachComponent<T>(entity, component);
+    mEntityManager->createEntities(count, out);
+}
+
+void Game::DestroyEntities(const Entity *entities, size_t count)
+{
+    mBatchSignatures.clear();
+    for (size_t index = 0; index < count; ++index)
+    {
+        mBatchSignatures.push_back(mEntityManager->GetSignature(entities[index]));
+        mEntityManager->destroyEntity(entities[index]);
+    }
 
-    auto signature = mEntityManager->GetSignature(entity);
-    signature.set(mComponentManager->GetComponentType<T>(), true);
-    mEntityManager->SetSignature(entity, signature);
+    mComponentManager->handleDestroyedEntities(entities, mBatchSignatures.data(), count);
 
-    mSystemManager->handleEntitySignatureChanged(entity, signature);
+    for (size_t index = 0; index < count; ++index)
+    {
+        mSystemManager->handleDestroyedEntity(entities[index], mBatchSignatures[index]);
+        mDestroyEvents.record(entities[index]);
+    }
 }
 
-template <typename T>
-void Game::DetachComponent(Entity entity)
+void Game::DeliverEvents()
 {
-    mComponentManager->DetachComponent<T>(entity);
+    ECS_PROFILE_SCOPE("DeliverEvents");
 
-    auto signature = mEntityManager->GetSignature(entity);
-    signature.set(mComponentManager->GetComponentType<T>(), false);
-    mEntityManager->SetSignature(entity, signature);
+    if (mComponentManager->getBackend() == StorageBackend::SparseSet)
+    {
+        mComponentManager->deliverEvents();
+    }
+    if (mDestroyEvents.hasPending())
+    {
+        mDestroyEvents.deliver();
+    }
+}
 
-    mSystemManager->handleEntitySignatureChanged(entity, signature);
+bool Game::SaveSnapshot(const std::string &path)
+{
+    std::ofstream file(path, std::ios::binary);
+    if (!file || !writeSnapshot(file, *mEntityManager, *mComponentManager))
+    {
+        return false;
+    }
+    file.close();
+    return !file.fail();
+}
+
+bool Game::LoadSnapshot(const std::string &path)
+{
+    MappedFile file(path);
+    return file.isOpen() &&
+           readSnapshot(file.data(), file.size(), *mEntityManager, *mComponentManager, *mSystemManager);
+}
+
+void Game::SetWorkerCount(size_t workerCount)
+{
+    mThreadPool = workerCount > 0 ? std::make_unique<ThreadPool>(workerCount) : nullptr;
 }
 
-template <typename T>
-T &Game::GetComponent(Entity entity)
+void Game::UpdateSystems()
 {
-    return mComponentManager->GetComponent<T>(entity);
+    mMemory.beginFrame();
+
+    if (mThreadPool)
+    {
+        mSystemManager->update(*mThreadPool);
+    }
+    else
+    {
+        mSystemManager->update();
+    }
+
+    FlushCommands();
+    DeliverEvents();
+
+    mMemory.endFrame();
 }
 
-template <typename T>
-ComponentTypeBitPosition Game::GetComponentType()
+MemoryStats Game::GetMemoryStats() const
 {
-    return mComponentManager->GetComponentType<T>();
+    MemoryStats stats{};
+    stats.pools.reserve(mComponentManager->getComponentTypeCount());
+    stats.systems.reserve(mSystemManager->getSystemCount());
+    mComponentManager->getPoolMemory(stats.pools);
+    mSystemManager->getSystemMemory(stats.systems);
+    stats.entityTable = mEntityManager->getMemoryUsage();
+    stats.requests = mMemory.getRequests();
+    stats.heap = mMemory.getHeap();
+    stats.lastFrameAllocations = mMemory.getLastFrameAllocations();
+    stats.lastFrameHeapAllocations = mMemory.getLastFrameHeapAllocations();
+    return stats;
 }
 
-template <typename T>
-std::shared_ptr<T> Game::RegisterSystem()
+CommandBuffer &Game::GetCommandBuffer()
 {
-    return mSystemManager->RegisterSystem<T>();
+    std::lock_guard<std::mutex> lock(mCommandBufferMutex);
+
+    // looked up before inserting, emplace would allocate a node on every call
+    auto found = mCommandBufferIndices.find(std::this_thread::get_id());
+    if (found == mCommandBufferIndices.end())
+    {
+        found = mCommandBufferIndices.emplace(std::this_thread::get_id(), mCommandBuffers.size()).first;
+        std::pmr::memory_resource *resource = mMemory.getResource();
+        mCommandBuffers.push_back(std::allocate_shared<CommandBuffer>(ResourceAllocator<CommandBuffer>(resource),
+                                                                      *mComponentManager, resource));
+    }
+    return *mCommandBuffers[found->second];
 }
 
-template <typename T>
-void Game::SetSystemSignature(Signature signature)
+void Game::FlushCommands()
 {
-    mSystemManager->setSignature<T>(signature);
+    ECS_PROFILE_SCOPE("FlushCommands");
+
+    using CommandType = CommandBuffer::CommandType;
+
+    // create the pending entities and resolve every command's target
+    for (auto &bufferPointer : mCommandBuffers)
+    {
+        CommandBuffer &buffer = *bufferPointer;
+
+        mPendingEntities.clear();
+        for (std::uint32_t index = 0; index < buffer.getPendingCount(); ++index)
+        {
+            mPendingEntities.push_back(CreateEntity());
+        }
+
+        for (CommandBuffer::Command &command : buffer.getCommands())
+        {
+            Entity entity = command.pending ? mPendingEntities[command.target] : command.target;
+            if (command.type == CommandType::Destroy)
+            {
+                mPlaybackDestroys.push_back(entity);
+                continue;
+            }
+            mPlaybackCommands.push_back({&buffer, &command, entity, static_cast<std::uint32_t>(mPlaybackCommands.size())});
+        }
+    }
+
+    // group by component type so each pool is visited in one go, entities in slot order inside a group.
+    // Commands on the same component of the same entity keep their recording order. Unlike stable_sort,
+    // sort needs no temporary buffer, so a flush does not allocate
+    std::sort(mPlaybackCommands.begin(), mPlaybackCommands.end(),
+              [](const PlaybackCommand &first, const PlaybackCommand &second)
+              {
+                  if (first.command->bit != second.command->bit)
+                  {
+                      return first.command->bit < second.command->bit;
+                  }
+                  if (entityIndex(first.entity) != entityIndex(second.entity))
+                  {
+                      return entityIndex(first.entity) < entityIndex(second.entity);
+                  }
+                  return first.order < second.order;
+              });
+
+    for (PlaybackCommand &playback : mPlaybackCommands)
+    {
+        Entity entity = playback.entity;
+        CommandBuffer::Command &command = *playback.command;
+        if (!IsAlive(entity))
+        {
+            continue;
+        }
+
+        Signature signature = mEntityManager->GetSignature(entity);
+        if (!mTouchedEntities.contains(entity))
+        {
+            mTouchedEntities.insert(entity);
+            mTouchedSignatures.push_back(signature);
+        }
+
+        if (command.type == CommandType::Attach)
+        {
+            // another buffer, or the entity itself, may already have it: a recorder cannot know that
+            command.attach(*mComponentManager, entity, command.payload, signature.test(command.bit));
+            playback.buffer->markPlayedBack(command);
+            signature.set(command.bit, true);
+        }
+        else if (signature.test(command.bit))
+        {
+            command.detach(*mComponentManager, entity);
+            signature.set(command.bit, false);
+        }
+        mEntityManager->SetSignature(entity, signature);
+    }
+
+    // system membership is updated once per entity, whatever the number of commands it received
+    for (size_t index = 0; index < mTouchedEntities.size(); ++index)
+    {
+        Entity entity = mTouchedEntities[index];
+        mSystemManager->handleEntitySignatureChanged(entity, mTouchedSignatures[index],
+                                                     mEntityManager->GetSignature(entity));
+    }
+
+    // the destroys go as one batch, so each pool is visited once for all of them
+    std::sort(mPlaybackDestroys.begin(), mPlaybackDestroys.end());
+    mPlaybackDestroys.erase(std::unique(mPlaybackDestroys.begin(), mPlaybackDestroys.end()), mPlaybackDestroys.end());
+    mPlaybackDestroys.erase(std::remove_if(mPlaybackDestroys.begin(), mPlaybackDestroys.end(),
+                                           [this](Entity entity)
+                                           { return !IsAlive(entity); }),
+                            mPlaybackDestroys.end());
+    DestroyEntities(mPlaybackDestroys.data(), mPlaybackDestroys.size());
+
+    for (auto &buffer : mCommandBuffers)
+    {
+        buffer->clear();
+    }
+    mPlaybackCommands.clear();
+    mPlaybackDestroys.clear();
+    mTouchedEntities.clear();
+    mTouchedSignatures.clear();
 }
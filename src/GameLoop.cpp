@@ -0,0 +1,84 @@
+#include "GameLoop.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <thread>
+
+GameLoop::GameLoop(double timeStep, double maxFrameTime, std::uint32_t maxStepsPerFrame)
+    : mTimeStep(timeStep), mMaxFrameTime(maxFrameTime), mMaxStepsPerFrame(maxStepsPerFrame)
+{
+    assert(timeStep > 0.0 && maxStepsPerFrame > 0 && "Game loop needs a positive time step");
+}
+
+void GameLoop::run()
+{
+    using Clock = std::chrono::steady_clock;
+
+    mRunning = true;
+    Clock::time_point previous = Clock::now();
+    while (mRunning)
+    {
+        Clock::time_point now = Clock::now();
+        advance(std::chrono::duration<double>(now - previous).count());
+        previous = now;
+
+        if (mMinFrameTime > 0.0)
+        {
+            std::this_thread::sleep_until(now + std::chrono::duration_cast<Clock::duration>(
+                                                    std::chrono::duration<double>(mMinFrameTime)));
+        }
+    }
+}
+
+void GameLoop::advance(double frameTime)
+{
+    Profiler &profiler = Profiler::get();
+    profiler.beginFrame();
+
+    if (frameTime > mMaxFrameTime)
+    {
+        mDroppedTime += frameTime - mMaxFrameTime;
+        frameTime = mMaxFrameTime;
+    }
+    mAccumulator += frameTime;
+
+    if (mInputStage)
+    {
+        ECS_PROFILE_SCOPE("input");
+        mInputStage();
+    }
+
+    {
+        ECS_PROFILE_SCOPE("update");
+        std::uint32_t steps = 0;
+        while (mAccumulator >= mTimeStep && steps < mMaxStepsPerFrame)
+        {
+            if (mUpdateStage)
+            {
+                mUpdateStage(mTimeStep);
+            }
+            mAccumulator -= mTimeStep;
+            ++steps;
+            ++mStepCount;
+        }
+
+        // still behind after the last allowed step: let the simulation fall behind real time
+        if (mAccumulator >= mTimeStep)
+        {
+            double behind = mAccumulator - std::fmod(mAccumulator, mTimeStep);
+            mDroppedTime += behind;
+            mAccumulator -= behind;
+        }
+    }
+
+    if (mRenderStage)
+    {
+        ECS_PROFILE_SCOPE("render");
+        mRenderStage(getAlpha());
+    }
+
+    ++mFrameCount;
+    profiler.endFrame();
+}
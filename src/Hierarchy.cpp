@@ -0,0 +1,343 @@
+#include "Hierarchy.hpp"
+
+TransformHierarchy::TransformHierarchy(std::pmr::memory_resource *resource)
+    : mNodes(resource), mLevels(resource), mSubtreeScratch(resource)
+{
+}
+
+void TransformHierarchy::insert(Entity entity, Position world)
+{
+    assert(!contains(entity) && "Entity is already in the hierarchy");
+    assert(entityIndex(entity) != NULL_ENTITY && "Not an entity");
+
+    Entity index = entityIndex(entity);
+    if (index >= mNodes.size())
+    {
+        mNodes.resize(index + 1);
+    }
+    assert(mNodes[index].entity == NULL_ENTITY && "Slot still held by a destroyed entity, remove it first");
+
+    mNodes[index] = Node{};
+    mNodes[index].entity = entity;
+    pushToLevel(entity, 0, world, world);
+    ++mSize;
+}
+
+void TransformHierarchy::remove(Entity entity)
+{
+    // clearParent unlinks the child, so the list is read from its head every time
+    while (node(entity).firstChild != NULL_ENTITY)
+    {
+        clearParent(node(entity).firstChild);
+    }
+
+    if (node(entity).parent != NULL_ENTITY)
+    {
+        unlink(entity);
+    }
+    removeFromLevel(entity);
+    node(entity).entity = NULL_ENTITY;
+    --mSize;
+}
+
+void TransformHierarchy::setParent(Entity child, Entity parent, Position local)
+{
+    assert(contains(child) && contains(parent) && "Both entities must be in the hierarchy");
+    for (Entity ancestor = parent; ancestor != NULL_ENTITY; ancestor = node(ancestor).parent)
+    {
+        assert(ancestor != child && "The parent is under the child");
+    }
+
+    if (node(child).parent != NULL_ENTITY)
+    {
+        unlink(child);
+    }
+    link(child, parent);
+    moveSubtree(child, node(parent).depth + 1, local);
+}
+
+void TransformHierarchy::clearParent(Entity entity)
+{
+    if (node(entity).parent == NULL_ENTITY)
+    {
+        return;
+    }
+
+    Position world = computeWorld(entity);
+    unlink(entity);
+    moveSubtree(entity, 0, world);
+}
+
+void TransformHierarchy::setLocal(Entity entity, Position local)
+{
+    const Node &entry = node(entity);
+    Level &level = mLevels[entry.depth];
+    level.local[entry.index] = local;
+    if (!level.dirty[entry.index])
+    {
+        level.dirty[entry.index] = 1;
+        ++level.dirtyCount;
+        ++mDirtyCount;
+    }
+}
+
+Position TransformHierarchy::computeWorld(Entity entity) const
+{
+    Position world{0.0f, 0.0f};
+    for (Entity current = entity; current != NULL_ENTITY; current = node(current).parent)
+    {
+        Position local = getLocal(current);
+        world.x += local.x;
+        world.y += local.y;
+    }
+    return world;
+}
+
+void TransformHierarchy::pushToLevel(Entity entity, std::uint32_t depth, Position local, Position world)
+{
+    while (mLevels.size() <= depth)
+    {
+        mLevels.emplace_back(mLevels.get_allocator().resource());
+    }
+
+    Node &entry = node(entity);
+    Level &level = mLevels[depth];
+    entry.depth = depth;
+    entry.index = static_cast<std::uint32_t>(level.entities.size());
+
+    level.entities.push_back(entity);
+    level.parents.push_back(depth > 0 ? node(entry.parent).index : 0);
+    level.local.push_back(local);
+    level.world.push_back(world);
+    level.dirty.push_back(1);
+    level.movedPass.push_back(0);
+    ++level.dirtyCount;
+    ++mDirtyCount;
+}
+
+void TransformHierarchy::removeFromLevel(Entity entity)
+{
+    const Node &entry = node(entity);
+    Level &level = mLevels[entry.depth];
+    std::uint32_t index = entry.index;
+    auto last = static_cast<std::uint32_t>(level.entities.size() - 1);
+
+    if (level.dirty[index])
+    {
+        --level.dirtyCount;
+        --mDirtyCount;
+    }
+
+    if (index != last)
+    {
+        Entity movedEntity = level.entities[last];
+        level.entities[index] = movedEntity;
+        level.parents[index] = level.parents[last];
+        level.local[index] = level.local[last];
+        level.world[index] = level.world[last];
+        level.dirty[index] = level.dirty[last];
+        level.movedPass[index] = level.movedPass[last];
+
+        node(movedEntity).index = index;
+        if (entry.depth + 1 < mLevels.size())
+        {
+            Level &below = mLevels[entry.depth + 1];
+            for (Entity child = node(movedEntity).firstChild; child != NULL_ENTITY; child = node(child).nextSibling)
+            {
+                // a child of a subtree being moved may already sit on another level, it gets its index when pushed
+                if (node(child).depth == entry.depth + 1)
+                {
+                    below.parents[node(child).index] = index;
+                }
+            }
+        }
+    }
+
+    level.entities.pop_back();
+    level.parents.pop_back();
+    level.local.pop_back();
+    level.world.pop_back();
+    level.dirty.pop_back();
+    level.movedPass.pop_back();
+}
+
+void TransformHierarchy::link(Entity child, Entity parent)
+{
+    Node &entry = node(child);
+    Node &parentEntry = node(parent);
+    entry.parent = parent;
+    entry.previousSibling = NULL_ENTITY;
+    entry.nextSibling = parentEntry.firstChild;
+    if (parentEntry.firstChild != NULL_ENTITY)
+    {
+        node(parentEntry.firstChild).previousSibling = child;
+    }
+    parentEntry.firstChild = child;
+}
+
+void TransformHierarchy::unlink(Entity child)
+{
+    Node &entry = node(child);
+    if (entry.previousSibling != NULL_ENTITY)
+    {
+        node(entry.previousSibling).nextSibling = entry.nextSibling;
+    }
+    else
+    {
+        node(entry.parent).firstChild = entry.nextSibling;
+    }
+    if (entry.nextSibling != NULL_ENTITY)
+    {
+        node(entry.nextSibling).previousSibling = entry.previousSibling;
+    }
+    entry.parent = NULL_ENTITY;
+    entry.nextSibling = NULL_ENTITY;
+    entry.previousSibling = NULL_ENTITY;
+}
+
+void TransformHierarchy::moveSubtree(Entity root, std::uint32_t depth, Position local)
+{
+    // breadth first, so every parent reaches its new level before its children
+    mSubtreeScratch.clear();
+    mSubtreeScratch.push_back(root);
+    for (size_t next = 0; next < mSubtreeScratch.size(); ++next)
+    {
+        for (Entity child = node(mSubtreeScratch[next]).firstChild; child != NULL_ENTITY;
+             child = node(child).nextSibling)
+        {
+            mSubtreeScratch.push_back(child);
+        }
+    }
+
+    std::uint32_t rootDepth = node(root).depth;
+    for (Entity entity : mSubtreeScratch)
+    {
+        const Node &entry = node(entity);
+        std::uint32_t newDepth = depth + (entry.depth - rootDepth);
+        Position nodeLocal = entity == root ? local : mLevels[entry.depth].local[entry.index];
+        Position world = mLevels[entry.depth].world[entry.index];
+        removeFromLevel(entity);
+        pushToLevel(entity, newDepth, nodeLocal, world);
+    }
+}
+
+void HierarchySystem::init(Game &game)
+{
+    mGame = &game;
+    mHierarchy = TransformHierarchy(game.GetMemoryResource());
+
+    Signature signature;
+    signature.set(game.GetComponentType<Position>());
+    signature.set(game.GetComponentType<HierarchyNode>());
+    game.SetSystemSignature<HierarchySystem>(signature);
+    game.SetSystemAccess<HierarchySystem>(Reads<HierarchyNode>{}, Writes<Position>{});
+}
+
+void HierarchySystem::update()
+{
+    assert(mGame && "HierarchySystem used before init");
+
+    prune();
+
+    // the roots follow their Position, however it was moved
+    if (mHierarchy.getLevelCount() == 0)
+    {
+        return;
+    }
+    for (Entity root : mHierarchy.getLevelEntities(0))
+    {
+        const Position &position = mGame->GetComponent<Position>(root);
+        Position local = mHierarchy.getLocal(root);
+        if (position.x != local.x || position.y != local.y)
+        {
+            mHierarchy.setLocal(root, position);
+        }
+    }
+
+    // a moved root's Position already is its world position
+    ComponentArray<Position> *positions = mGame->GetComponentArray<Position>();
+    mHierarchy.propagate([this, positions](Entity entity, Position world)
+                         {
+        if (mHierarchy.getParent(entity) == NULL_ENTITY)
+        {
+            return;
+        }
+        mGame->GetComponent<Position>(entity) = world;
+        if (positions)
+        {
+            positions->markChanged(entity);
+        } });
+}
+
+void HierarchySystem::setParent(Entity child, Entity parent, Position offset)
+{
+    prune();
+    addRoot(parent);
+    addRoot(child);
+    mHierarchy.setParent(child, parent, offset);
+}
+
+void HierarchySystem::clearParent(Entity entity)
+{
+    prune();
+    if (mHierarchy.contains(entity))
+    {
+        mHierarchy.clearParent(entity);
+    }
+}
+
+void HierarchySystem::setOffset(Entity entity, Position offset)
+{
+    assert(mHierarchy.getParent(entity) != NULL_ENTITY && "A root has no offset, move its Position");
+    mHierarchy.setLocal(entity, offset);
+}
+
+void HierarchySystem::remove(Entity entity)
+{
+    prune();
+    if (mHierarchy.contains(entity))
+    {
+        mHierarchy.remove(entity);
+        mGame->DetachComponent<HierarchyNode>(entity);
+    }
+}
+
+void HierarchySystem::prune()
+{
+    // only the system attaches HierarchyNode, so every member is a node and a missing member is a gone node
+    if (mHierarchy.size() == mEntities.size())
+    {
+        return;
+    }
+
+    mGone.clear();
+    for (size_t depth = 0; depth < mHierarchy.getLevelCount(); ++depth)
+    {
+        for (Entity entity : mHierarchy.getLevelEntities(depth))
+        {
+            if (!mEntities.contains(entity))
+            {
+                mGone.push_back(entity);
+            }
+        }
+    }
+    // an entity that only lost its Position still carries the marker, dropped when the commands are flushed
+    // as prune may run in the middle of a frame
+    for (Entity entity : mGone)
+    {
+        mHierarchy.remove(entity);
+        if (mGame->IsAlive(entity))
+        {
+            mGame->GetCommandBuffer().detachComponent<HierarchyNode>(entity);
+        }
+    }
+}
+
+void HierarchySystem::addRoot(Entity entity)
+{
+    if (!mHierarchy.contains(entity))
+    {
+        mHierarchy.insert(entity, mGame->GetComponent<Position>(entity));
+        mGame->AttachComponent(entity, HierarchyNode{});
+    }
+}
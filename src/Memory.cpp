@@ -0,0 +1,57 @@
+#include "Memory.hpp"
+
+namespace
+{
+    std::pmr::pool_options worldPoolOptions()
+    {
+        std::pmr::pool_options options;
+        options.largest_required_pool_block = WORLD_POOL_LARGEST_BLOCK;
+        return options;
+    }
+}
+
+AllocationCounters CountingResource::getCounters() const
+{
+    return {mAllocations.load(std::memory_order_relaxed), mDeallocations.load(std::memory_order_relaxed),
+            mBytesAllocated.load(std::memory_order_relaxed), mBytesInUse.load(std::memory_order_relaxed),
+            mPeakBytesInUse.load(std::memory_order_relaxed)};
+}
+
+void *CountingResource::do_allocate(size_t bytes, size_t alignment)
+{
+    void *pointer = mUpstream->allocate(bytes, alignment);
+
+    mAllocations.fetch_add(1, std::memory_order_relaxed);
+    mBytesAllocated.fetch_add(bytes, std::memory_order_relaxed);
+    std::uint64_t inUse = mBytesInUse.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    std::uint64_t peak = mPeakBytesInUse.load(std::memory_order_relaxed);
+    while (inUse > peak && !mPeakBytesInUse.compare_exchange_weak(peak, inUse, std::memory_order_relaxed))
+    {
+    }
+    return pointer;
+}
+
+void CountingResource::do_deallocate(void *pointer, size_t bytes, size_t alignment)
+{
+    mUpstream->deallocate(pointer, bytes, alignment);
+
+    mDeallocations.fetch_add(1, std::memory_order_relaxed);
+    mBytesInUse.fetch_sub(bytes, std::memory_order_relaxed);
+}
+
+WorldMemory::WorldMemory(std::pmr::memory_resource *upstream)
+    : mHeap(upstream), mPool(worldPoolOptions(), &mHeap), mRequests(&mPool)
+{
+}
+
+void WorldMemory::beginFrame()
+{
+    mFrameStartAllocations = mRequests.getCounters().allocations;
+    mFrameStartHeapAllocations = mHeap.getCounters().allocations;
+}
+
+void WorldMemory::endFrame()
+{
+    mLastFrameAllocations = mRequests.getCounters().allocations - mFrameStartAllocations;
+    mLastFrameHeapAllocations = mHeap.getCounters().allocations - mFrameStartHeapAllocations;
+}
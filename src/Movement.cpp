@@ -0,0 +1,174 @@
+#include "Movement.hpp"
+
+#include <algorithm>
+
+#if defined(ECS_SIMD_X86)
+#include <immintrin.h>
+#endif
+
+namespace
+{
+    // the kernels work on [begin, count) of flat float arrays, begin being where the wider level stopped
+    void integrateScalar(float *positions, float *velocities, const float *accelerations, size_t begin,
+                         size_t count, float dt)
+    {
+        for (size_t index = begin; index < count; ++index)
+        {
+            velocities[index] = velocities[index] + accelerations[index] * dt;
+            positions[index] = positions[index] + velocities[index] * dt;
+        }
+    }
+
+#if defined(ECS_SIMD_X86)
+    void integrateSSE2(float *positions, float *velocities, const float *accelerations, size_t count, float dt)
+    {
+        const __m128 step = _mm_set1_ps(dt);
+
+        size_t index = 0;
+        for (; index + 4 <= count; index += 4)
+        {
+            __m128 velocity = _mm_loadu_ps(velocities + index);
+            velocity = _mm_add_ps(velocity, _mm_mul_ps(_mm_loadu_ps(accelerations + index), step));
+            _mm_storeu_ps(velocities + index, velocity);
+
+            __m128 position = _mm_add_ps(_mm_loadu_ps(positions + index), _mm_mul_ps(velocity, step));
+            _mm_storeu_ps(positions + index, position);
+        }
+
+        integrateScalar(positions, velocities, accelerations, index, count, dt);
+    }
+
+    ECS_TARGET_AVX2 void integrateAVX2(float *positions, float *velocities, const float *accelerations, size_t count,
+                                       float dt)
+    {
+        const __m256 step = _mm256_set1_ps(dt);
+
+        size_t index = 0;
+        for (; index + 8 <= count; index += 8)
+        {
+            __m256 velocity = _mm256_loadu_ps(velocities + index);
+            velocity = _mm256_add_ps(velocity, _mm256_mul_ps(_mm256_loadu_ps(accelerations + index), step));
+            _mm256_storeu_ps(velocities + index, velocity);
+
+            __m256 position = _mm256_add_ps(_mm256_loadu_ps(positions + index), _mm256_mul_ps(velocity, step));
+            _mm256_storeu_ps(positions + index, position);
+        }
+
+        integrateScalar(positions, velocities, accelerations, index, count, dt);
+    }
+#endif
+}
+
+void integrateMotion(Position *positions, Velocity *velocities, const Acceleration *accelerations, size_t count,
+                     float dt)
+{
+    integrateMotion(positions, velocities, accelerations, count, dt, getSimdLevel());
+}
+
+void integrateMotion(Position *positions, Velocity *velocities, const Acceleration *accelerations, size_t count,
+                     float dt, SimdLevel level)
+{
+    // x and y are integrated alike, so a body is just two more floats of the stream
+    auto *positionFloats = reinterpret_cast<float *>(positions);
+    auto *velocityFloats = reinterpret_cast<float *>(velocities);
+    auto *accelerationFloats = reinterpret_cast<const float *>(accelerations);
+    size_t floatCount = count * 2;
+
+    switch (clampSimdLevel(level))
+    {
+#if defined(ECS_SIMD_X86)
+    case SimdLevel::AVX2:
+        integrateAVX2(positionFloats, velocityFloats, accelerationFloats, floatCount, dt);
+        break;
+    case SimdLevel::SSE2:
+        integrateSSE2(positionFloats, velocityFloats, accelerationFloats, floatCount, dt);
+        break;
+#endif
+    default:
+        integrateScalar(positionFloats, velocityFloats, accelerationFloats, 0, floatCount, dt);
+        break;
+    }
+}
+
+void MovementSystem::init(Game &game)
+{
+    mGame = &game;
+    mGroup.reset();
+    if (game.GetStorageBackend() == StorageBackend::SparseSet)
+    {
+        // a pool can only be owned by one group: when the game already grouped one of them otherwise, the
+        // system leaves that group alone and walks a view
+        PoolGroup *groups[] = {game.GetComponentArray<Position>()->getGroup(),
+                               game.GetComponentArray<Velocity>()->getGroup(),
+                               game.GetComponentArray<Acceleration>()->getGroup()};
+        Signature owned;
+        owned.set(game.GetComponentType<Position>());
+        owned.set(game.GetComponentType<Velocity>());
+        owned.set(game.GetComponentType<Acceleration>());
+        bool free = !groups[0] && !groups[1] && !groups[2];
+        bool ours = groups[0] && groups[0] == groups[1] && groups[0] == groups[2] && groups[0]->getOwned() == owned;
+        if (free || ours)
+        {
+            mGroup.emplace(game.Group<Position, Velocity, Acceleration>());
+        }
+    }
+
+    Signature signature;
+    signature.set(game.GetComponentType<Position>());
+    signature.set(game.GetComponentType<Velocity>());
+    signature.set(game.GetComponentType<Acceleration>());
+    game.SetSystemSignature<MovementSystem>(signature);
+
+    game.SetSystemAccess<MovementSystem>(Reads<Acceleration>{}, Writes<Position, Velocity>{});
+}
+
+void MovementSystem::update()
+{
+    assert(mGame && "MovementSystem used before init");
+
+    if (mGame->GetStorageBackend() == StorageBackend::Archetype)
+    {
+        mGame->ArchetypeEachChunk<Position, Velocity, Acceleration>(
+            [this](size_t count, Position *positions, Velocity *velocities, Acceleration *accelerations)
+            { integrateMotion(positions, velocities, accelerations, count, mTimeStep); });
+        return;
+    }
+
+    if (!mGroup)
+    {
+        ComponentArray<Position> *positions = mGame->GetComponentArray<Position>();
+        ComponentArray<Velocity> *velocities = mGame->GetComponentArray<Velocity>();
+        mGame->View<Position, Velocity, Acceleration>().parallelEach(
+            mGame->GetThreadPool(),
+            [this, positions, velocities](Entity entity, Position &position, Velocity &velocity,
+                                          Acceleration &acceleration)
+            {
+                integrateMotion(&position, &velocity, &acceleration, 1, mTimeStep);
+                positions->markChanged(entity);
+                velocities->markChanged(entity);
+            });
+        return;
+    }
+
+    // the system's entities are the group, a run is the longest stretch the three pools store contiguously
+    auto integrateRange = [this](size_t begin, size_t end)
+    {
+        mGroup->eachRunInRange(
+            [this](size_t first, size_t count, Position *positions, Velocity *velocities, Acceleration *accelerations)
+            {
+                integrateMotion(positions, velocities, accelerations, count, mTimeStep);
+                mGame->GetComponentArray<Position>()->markChangedRange(first, first + count);
+                mGame->GetComponentArray<Velocity>()->markChangedRange(first, first + count);
+            },
+            begin, end);
+    };
+
+    if (ThreadPool *pool = mGame->GetThreadPool())
+    {
+        pool->parallelFor(0, mGroup->size(), mGroup->groupGrainSize(DEFAULT_GRAIN_SIZE), integrateRange);
+    }
+    else
+    {
+        integrateRange(0, mGroup->size());
+    }
+}
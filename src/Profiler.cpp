@@ -0,0 +1,158 @@
+#include "Profiler.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+
+Profiler &Profiler::get()
+{
+    static Profiler profiler;
+    return profiler;
+}
+
+Profiler::Profiler()
+    : mEpoch(Clock::now()), mFrameBegin(mEpoch)
+{
+    mFrameTimes.reserve(PROFILER_FRAME_HISTORY);
+}
+
+void Profiler::record(const char *name, Clock::time_point begin, Clock::time_point end)
+{
+    ThreadBuffer &buffer = threadBuffer();
+    if (buffer.events.size() == PROFILER_MAX_EVENTS_PER_THREAD)
+    {
+        ++buffer.dropped;
+        return;
+    }
+    std::int64_t start = sinceEpoch(begin);
+    buffer.events.push_back({name, start, sinceEpoch(end) - start});
+}
+
+void Profiler::beginFrame()
+{
+    mFrameBegin = Clock::now();
+}
+
+void Profiler::endFrame()
+{
+    Clock::time_point end = Clock::now();
+
+    double milliseconds = std::chrono::duration<double, std::milli>(end - mFrameBegin).count();
+    if (mFrameTimes.size() < PROFILER_FRAME_HISTORY)
+    {
+        mFrameTimes.push_back(milliseconds);
+    }
+    else
+    {
+        mFrameTimes[mNextFrame] = milliseconds;
+    }
+    mNextFrame = (mNextFrame + 1) % PROFILER_FRAME_HISTORY;
+
+    if (isCapturing())
+    {
+        record("frame", mFrameBegin, end);
+    }
+}
+
+FrameStats Profiler::getFrameStats() const
+{
+    if (mFrameTimes.empty())
+    {
+        return {0, 0.0, 0.0, 0.0};
+    }
+
+    mSortedFrameTimes.assign(mFrameTimes.begin(), mFrameTimes.end());
+    std::sort(mSortedFrameTimes.begin(), mSortedFrameTimes.end());
+
+    // nearest-rank percentiles
+    auto percentile = [this](double fraction)
+    {
+        size_t rank = static_cast<size_t>(std::ceil(fraction * mSortedFrameTimes.size()));
+        return mSortedFrameTimes[rank > 0 ? rank - 1 : 0];
+    };
+
+    return {mSortedFrameTimes.size(), percentile(0.50), percentile(0.99), mSortedFrameTimes.back()};
+}
+
+const char *Profiler::intern(const std::string &name)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mNames.insert(name).first->c_str();
+}
+
+void Profiler::writeChromeTrace(std::ostream &out) const
+{
+    out << "{\"traceEvents\":[";
+
+    bool first = true;
+    for (const auto &buffer : mThreadBuffers)
+    {
+        for (const Event &event : buffer->events)
+        {
+            out << (first ? "\n" : ",\n");
+            first = false;
+
+            out << "{\"name\":\"";
+            for (const char *character = event.name; *character; ++character)
+            {
+                if (*character == '"' || *character == '\\')
+                {
+                    out << '\\';
+                }
+                out << *character;
+            }
+            // complete events, timestamps in microseconds
+            out << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << buffer->threadIndex
+                << ",\"ts\":" << event.begin / 1000 << '.' << event.begin % 1000 / 100
+                << ",\"dur\":" << event.duration / 1000 << '.' << event.duration % 1000 / 100 << '}';
+        }
+    }
+
+    out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+}
+
+bool Profiler::writeChromeTrace(const std::string &path) const
+{
+    std::ofstream file(path);
+    if (!file)
+    {
+        return false;
+    }
+    writeChromeTrace(file);
+    return static_cast<bool>(file);
+}
+
+size_t Profiler::getDroppedEvents() const
+{
+    size_t dropped = 0;
+    for (const auto &buffer : mThreadBuffers)
+    {
+        dropped += buffer->dropped;
+    }
+    return dropped;
+}
+
+void Profiler::clear()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    for (auto &buffer : mThreadBuffers)
+    {
+        buffer->events.clear();
+        buffer->dropped = 0;
+    }
+}
+
+Profiler::ThreadBuffer &Profiler::threadBuffer()
+{
+    // the profiler is a process wide singleton, so one cached buffer per thread is enough
+    thread_local ThreadBuffer *tBuffer = nullptr;
+    if (!tBuffer)
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mThreadBuffers.push_back(std::make_unique<ThreadBuffer>());
+        tBuffer = mThreadBuffers.back().get();
+        tBuffer->threadIndex = static_cast<std::uint32_t>(mThreadBuffers.size() - 1);
+        tBuffer->events.reserve(PROFILER_MAX_EVENTS_PER_THREAD);
+    }
+    return *tBuffer;
+}
@@ -0,0 +1,168 @@
+#include "Render.hpp"
+
+#include <cassert>
+
+#if defined(ECS_WITH_SFML)
+#include <cstddef>
+
+#include <SFML/Graphics/Vertex.hpp>
+
+static_assert(sizeof(SpriteVertex) == sizeof(sf::Vertex) && offsetof(SpriteVertex, r) == offsetof(sf::Vertex, color) &&
+                  offsetof(SpriteVertex, u) == offsetof(sf::Vertex, texCoords),
+              "SpriteVertex must be laid out like sf::Vertex");
+#endif
+
+namespace
+{
+    const unsigned RADIX_BITS = 8;
+    const size_t RADIX_BUCKETS = size_t{1} << RADIX_BITS;
+
+    // bits of a sort key: a 16 bit layer above a 32 bit texture
+    const unsigned SORT_KEY_BITS = 48;
+
+    // layers sort as signed numbers, textures below them
+    std::uint64_t sortKey(const Sprite &sprite)
+    {
+        auto layer = static_cast<std::uint16_t>(static_cast<std::int32_t>(sprite.layer) + 0x8000);
+        return (std::uint64_t{layer} << 32) | sprite.texture;
+    }
+}
+
+void SpriteRenderSystem::init(Game &game)
+{
+    mGame = &game;
+
+    Signature signature;
+    signature.set(game.GetComponentType<Position>());
+    signature.set(game.GetComponentType<Sprite>());
+    game.SetSystemSignature<SpriteRenderSystem>(signature);
+
+    game.SetSystemAccess<SpriteRenderSystem>(Reads<Position, Sprite>{}, Writes<>{});
+}
+
+void SpriteRenderSystem::update()
+{
+    assert(mGame && "SpriteRenderSystem used before init");
+
+    mSprites.clear();
+    mPositions.clear();
+    mGame->View<Position, Sprite>().each([this](const Position &position, const Sprite &sprite)
+                                         {
+        mPositions.push_back(position);
+        mSprites.push_back(sprite); });
+
+    size_t count = mSprites.size();
+    mKeys.resize(count);
+    mOrder.resize(count);
+    for (size_t index = 0; index < count; ++index)
+    {
+        mKeys[index] = sortKey(mSprites[index]);
+        mOrder[index] = static_cast<std::uint32_t>(index);
+    }
+    radixSort();
+
+    if (mVertices.size() < count * SPRITE_VERTEX_COUNT)
+    {
+        mVertices.resize(count * SPRITE_VERTEX_COUNT);
+    }
+    mVertexCount = count * SPRITE_VERTEX_COUNT;
+
+    mBatches.clear();
+    SpriteVertex *vertex = mVertices.data();
+    for (size_t sorted = 0; sorted < count; ++sorted)
+    {
+        const Sprite &sprite = mSprites[mOrder[sorted]];
+        const Position &position = mPositions[mOrder[sorted]];
+
+        if (mBatches.empty() || mBatches.back().layer != sprite.layer || mBatches.back().texture != sprite.texture)
+        {
+            mBatches.push_back({sprite.layer, sprite.texture, static_cast<std::uint32_t>(sorted * SPRITE_VERTEX_COUNT),
+                                0});
+        }
+        mBatches.back().vertexCount += static_cast<std::uint32_t>(SPRITE_VERTEX_COUNT);
+
+        float left = position.x - sprite.width * 0.5f;
+        float right = position.x + sprite.width * 0.5f;
+        float bottom = position.y - sprite.height * 0.5f;
+        float top = position.y + sprite.height * 0.5f;
+        float textureLeft = sprite.textureX;
+        float textureRight = sprite.textureX + sprite.textureWidth;
+        float textureTop = sprite.textureY;
+        float textureBottom = sprite.textureY + sprite.textureHeight;
+        auto r = static_cast<std::uint8_t>(sprite.color >> 24);
+        auto g = static_cast<std::uint8_t>(sprite.color >> 16);
+        auto b = static_cast<std::uint8_t>(sprite.color >> 8);
+        auto a = static_cast<std::uint8_t>(sprite.color);
+
+        // top left, top right, bottom right, then bottom right, bottom left, top left
+        vertex[0] = {left, top, r, g, b, a, textureLeft, textureTop};
+        vertex[1] = {right, top, r, g, b, a, textureRight, textureTop};
+        vertex[2] = {right, bottom, r, g, b, a, textureRight, textureBottom};
+        vertex[3] = vertex[2];
+        vertex[4] = {left, bottom, r, g, b, a, textureLeft, textureBottom};
+        vertex[5] = vertex[0];
+        vertex += SPRITE_VERTEX_COUNT;
+    }
+}
+
+void SpriteRenderSystem::radixSort()
+{
+    size_t count = mKeys.size();
+    mKeyScratch.resize(count);
+    mOrderScratch.resize(count);
+
+    // one histogram per key byte, all filled in a single pass
+    const unsigned passCount = SORT_KEY_BITS / RADIX_BITS;
+    size_t histograms[passCount][RADIX_BUCKETS] = {};
+    for (std::uint64_t key : mKeys)
+    {
+        for (unsigned pass = 0; pass < passCount; ++pass)
+        {
+            ++histograms[pass][(key >> (pass * RADIX_BITS)) & (RADIX_BUCKETS - 1)];
+        }
+    }
+
+    for (unsigned pass = 0; pass < passCount; ++pass)
+    {
+        size_t *histogram = histograms[pass];
+        unsigned shift = pass * RADIX_BITS;
+
+        // every sprite has the same byte here, e.g. a single layer or fewer than 2^24 textures: the pass
+        // would not move anything
+        if (count == 0 || histogram[(mKeys[0] >> shift) & (RADIX_BUCKETS - 1)] == count)
+        {
+            continue;
+        }
+
+        size_t offset = 0;
+        for (size_t bucket = 0; bucket < RADIX_BUCKETS; ++bucket)
+        {
+            size_t bucketCount = histogram[bucket];
+            histogram[bucket] = offset;
+            offset += bucketCount;
+        }
+        for (size_t index = 0; index < count; ++index)
+        {
+            std::uint64_t key = mKeys[index];
+            size_t destination = histogram[(key >> shift) & (RADIX_BUCKETS - 1)]++;
+            mKeyScratch[destination] = key;
+            mOrderScratch[destination] = mOrder[index];
+        }
+        mKeys.swap(mKeyScratch);
+        mOrder.swap(mOrderScratch);
+    }
+}
+
+#if defined(ECS_WITH_SFML)
+void SpriteRenderSystem::draw(sf::RenderTarget &target, const std::vector<sf::Texture> &textures,
+                              sf::RenderStates states) const
+{
+    const auto *vertices = reinterpret_cast<const sf::Vertex *>(mVertices.data());
+    for (const SpriteBatch &batch : mBatches)
+    {
+        assert(batch.texture < textures.size() && "A sprite refers to a texture that was not given");
+        states.texture = &textures[batch.texture];
+        target.draw(vertices + batch.firstVertex, batch.vertexCount, sf::Triangles, states);
+    }
+}
+#endif
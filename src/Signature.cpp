@@ -0,0 +1,187 @@
+#include "Signature.hpp"
+#include "Simd.hpp"
+
+#if defined(ECS_SIMD_X86)
+#include <immintrin.h>
+#endif
+
+// signatures are matched as one flat stream of words, which only works if they are packed back to back
+static_assert(sizeof(Signature) == Signature::WORD_COUNT * sizeof(std::uint64_t), "Signatures are not packed");
+
+namespace
+{
+    // the words of a block are matched in one go, a bit of the result per word
+    const size_t BLOCK_WORDS = 64;
+
+    // repeats the signature's words to fill a vector register of laneWords words
+    void fillPattern(const Signature &signature, std::uint64_t *pattern, size_t laneWords)
+    {
+        for (size_t index = 0; index < laneWords; ++index)
+        {
+            pattern[index] = signature.word(index % Signature::WORD_COUNT);
+        }
+    }
+
+    // a word matches when, of the bits of include | exclude, exactly the include ones are set.
+    // Folds the per-word result down to one bit per signature, on the signature's first word
+    std::uint64_t collapseWords(std::uint64_t okWords)
+    {
+        if constexpr (Signature::WORD_COUNT == 1)
+        {
+            return okWords;
+        }
+        else if constexpr (Signature::WORD_COUNT == 2)
+        {
+            return okWords & (okWords >> 1) & 0x5555555555555555ULL;
+        }
+        else
+        {
+            return okWords & (okWords >> 1) & (okWords >> 2) & (okWords >> 3) & 0x1111111111111111ULL;
+        }
+    }
+
+    size_t matchScalar(const Signature *signatures, size_t begin, size_t count, const Signature &include,
+                       const Signature &mask, std::uint32_t *out)
+    {
+        size_t matched = 0;
+        for (size_t index = begin; index < count; ++index)
+        {
+            if ((signatures[index] & mask) == include)
+            {
+                out[matched++] = static_cast<std::uint32_t>(index);
+            }
+        }
+        return matched;
+    }
+
+    // walks the signatures a block at a time with matchBlock, the remainder is matched one by one
+    template <typename MatchBlock>
+    size_t matchBlocks(const Signature *signatures, size_t count, const Signature &include, const Signature &mask,
+                       std::uint32_t *out, MatchBlock &&matchBlock)
+    {
+        const size_t signaturesPerBlock = BLOCK_WORDS / Signature::WORD_COUNT;
+        const std::uint64_t *words = signatures->words();
+
+        size_t matched = 0;
+        size_t first = 0;
+        for (; first + signaturesPerBlock <= count; first += signaturesPerBlock)
+        {
+            std::uint64_t hits = collapseWords(matchBlock(words + first * Signature::WORD_COUNT));
+            while (hits)
+            {
+                out[matched++] = static_cast<std::uint32_t>(first + lowestSetBit(hits) / Signature::WORD_COUNT);
+                hits &= hits - 1;
+            }
+        }
+
+        return matched + matchScalar(signatures, first, count, include, mask, out + matched);
+    }
+
+#if defined(ECS_SIMD_X86)
+    size_t matchSSE2(const Signature *signatures, size_t count, const Signature &include, const Signature &mask,
+                     std::uint32_t *out)
+    {
+        // two registers worth of pattern, so a 256 bit signature lines up with both halves
+        alignas(16) std::uint64_t includePattern[4];
+        alignas(16) std::uint64_t maskPattern[4];
+        fillPattern(include, includePattern, 4);
+        fillPattern(mask, maskPattern, 4);
+
+        const __m128i includeLanes[2] = {_mm_load_si128(reinterpret_cast<const __m128i *>(includePattern)),
+                                         _mm_load_si128(reinterpret_cast<const __m128i *>(includePattern + 2))};
+        const __m128i maskLanes[2] = {_mm_load_si128(reinterpret_cast<const __m128i *>(maskPattern)),
+                                      _mm_load_si128(reinterpret_cast<const __m128i *>(maskPattern + 2))};
+
+        // SSE2 has no 64 bit compare: compare halves, then a word is equal if both its halves are
+        auto matchLane = [](const std::uint64_t *words, __m128i includeLane, __m128i maskLane)
+        {
+            __m128i lane = _mm_loadu_si128(reinterpret_cast<const __m128i *>(words));
+            __m128i equal = _mm_cmpeq_epi32(_mm_and_si128(lane, maskLane), includeLane);
+            equal = _mm_and_si128(equal, _mm_shuffle_epi32(equal, _MM_SHUFFLE(2, 3, 0, 1)));
+            return static_cast<std::uint64_t>(_mm_movemask_pd(_mm_castsi128_pd(equal)));
+        };
+
+        return matchBlocks(signatures, count, include, mask, out, [&](const std::uint64_t *words)
+                           {
+            std::uint64_t okWords = 0;
+            for (size_t word = 0; word < BLOCK_WORDS; word += 4)
+            {
+                okWords |= matchLane(words + word, includeLanes[0], maskLanes[0]) << word;
+                okWords |= matchLane(words + word + 2, includeLanes[1], maskLanes[1]) << (word + 2);
+            }
+            return okWords; });
+    }
+
+    // the patterns are reloaded per block so no AVX register crosses into code compiled without AVX
+    ECS_TARGET_AVX2 std::uint64_t matchBlockAVX2(const std::uint64_t *words, const std::uint64_t *includePattern,
+                                                 const std::uint64_t *maskPattern)
+    {
+        const __m256i includeLane = _mm256_load_si256(reinterpret_cast<const __m256i *>(includePattern));
+        const __m256i maskLane = _mm256_load_si256(reinterpret_cast<const __m256i *>(maskPattern));
+
+        std::uint64_t okWords = 0;
+        for (size_t word = 0; word < BLOCK_WORDS; word += 4)
+        {
+            __m256i lane = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(words + word));
+            __m256i equal = _mm256_cmpeq_epi64(_mm256_and_si256(lane, maskLane), includeLane);
+            okWords |= static_cast<std::uint64_t>(_mm256_movemask_pd(_mm256_castsi256_pd(equal))) << word;
+        }
+        return okWords;
+    }
+
+    size_t matchAVX2(const Signature *signatures, size_t count, const Signature &include, const Signature &mask,
+                     std::uint32_t *out)
+    {
+        alignas(32) std::uint64_t includePattern[4];
+        alignas(32) std::uint64_t maskPattern[4];
+        fillPattern(include, includePattern, 4);
+        fillPattern(mask, maskPattern, 4);
+
+        return matchBlocks(signatures, count, include, mask, out, [&](const std::uint64_t *words)
+                           { return matchBlockAVX2(words, includePattern, maskPattern); });
+    }
+#endif
+
+    using MatchFunction = size_t (*)(const Signature *, size_t, const Signature &, const Signature &, std::uint32_t *);
+
+    size_t matchScalarAll(const Signature *signatures, size_t count, const Signature &include, const Signature &mask,
+                          std::uint32_t *out)
+    {
+        return matchScalar(signatures, 0, count, include, mask, out);
+    }
+
+    MatchFunction selectMatchFunction(SimdLevel level)
+    {
+        switch (level)
+        {
+#if defined(ECS_SIMD_X86)
+        case SimdLevel::AVX2:
+            return matchAVX2;
+        case SimdLevel::SSE2:
+            return matchSSE2;
+#endif
+        default:
+            return matchScalarAll;
+        }
+    }
+}
+
+size_t matchSignatures(const Signature *signatures, size_t count, const Signature &include,
+                       const Signature &exclude, std::uint32_t *out)
+{
+    return matchSignatures(signatures, count, include, exclude, out, getSimdLevel());
+}
+
+size_t matchSignatures(const Signature *signatures, size_t count, const Signature &include,
+                       const Signature &exclude, std::uint32_t *out, SimdLevel level)
+{
+    // a bit that is both required and forbidden can never match. An empty table may come as a null pointer,
+    // which the block kernels must never see
+    if (count == 0 || !include.disjoint(exclude))
+    {
+        return 0;
+    }
+
+    // of the bits the query looks at, exactly the include ones must be set
+    return selectMatchFunction(clampSimdLevel(level))(signatures, count, include, include | exclude, out);
+}
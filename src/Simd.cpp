@@ -0,0 +1,34 @@
+#include "Simd.hpp"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace
+{
+    SimdLevel detectSimdLevel()
+    {
+#if defined(ECS_SIMD_X86)
+#if defined(_MSC_VER)
+        int info[4];
+        __cpuid(info, 1);
+        // AVX2 also needs the OS to save the upper halves of the registers
+        bool osSavesYmm = (info[2] & (1 << 27)) && (info[2] & (1 << 28)) && (_xgetbv(0) & 0x6) == 0x6;
+        __cpuidex(info, 7, 0);
+        bool avx2 = osSavesYmm && (info[1] & (1 << 5)) != 0;
+#else
+        bool avx2 = __builtin_cpu_supports("avx2");
+#endif
+        // SSE2 is part of x86-64 itself
+        return avx2 ? SimdLevel::AVX2 : SimdLevel::SSE2;
+#else
+        return SimdLevel::Scalar;
+#endif
+    }
+}
+
+SimdLevel getSimdLevel()
+{
+    static const SimdLevel level = detectSimdLevel();
+    return level;
+}
@@ -0,0 +1,367 @@
+#include "Snapshot.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#elif defined(__unix__) || defined(__APPLE__)
+#define ECS_SNAPSHOT_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static_assert(std::is_trivially_copyable_v<Signature>, "Signatures are written to snapshots as raw bytes");
+static_assert(std::is_trivially_copyable_v<SnapshotHeader> && std::is_trivially_copyable_v<SnapshotPool>,
+              "Snapshot descriptors are written as raw bytes");
+static_assert(alignof(Signature) <= SNAPSHOT_ALIGNMENT, "Snapshot sections are not aligned enough for a Signature");
+
+namespace
+{
+    const std::align_val_t BUFFER_ALIGNMENT{SNAPSHOT_ALIGNMENT};
+
+    std::uint64_t alignUp(std::uint64_t offset)
+    {
+        return (offset + SNAPSHOT_ALIGNMENT - 1) / SNAPSHOT_ALIGNMENT * SNAPSHOT_ALIGNMENT;
+    }
+
+    // whether [offset, offset + bytes) is an aligned section inside a file of the given size
+    bool validSection(std::uint64_t offset, std::uint64_t bytes, size_t size)
+    {
+        return offset % SNAPSHOT_ALIGNMENT == 0 && offset <= size && bytes <= size - offset;
+    }
+
+    // the pools a snapshot holds, one per registered component type in bit order
+    std::vector<SnapshotPool> layoutPools(const ComponentManager &componentManager, std::uint64_t &offset)
+    {
+        std::vector<SnapshotPool> pools;
+        for (ComponentTypeBitPosition bit = 0; bit < componentManager.getComponentTypeCount(); ++bit)
+        {
+            const IComponentArray *pool = componentManager.getComponentArray(bit);
+
+            SnapshotPool descriptor{};
+            descriptor.typeHash = pool->getTypeHash();
+            descriptor.componentSize = static_cast<std::uint32_t>(pool->getComponentSize());
+            descriptor.bit = bit;
+            descriptor.count = pool->getPackedEntities().size();
+
+            descriptor.entitiesOffset = offset;
+            offset = alignUp(offset + descriptor.count * sizeof(Entity));
+            descriptor.componentsOffset = offset;
+            offset = alignUp(offset + descriptor.count * descriptor.componentSize);
+
+            pools.push_back(descriptor);
+        }
+        return pools;
+    }
+
+    /** whether the slot table, its free list and the pools' entities describe a world that can be restored:
+     * - livingCount slots hold their own index, every other slot is on the free list exactly once and has
+     *   an empty signature
+     * - no living entity has a bit set past the registered component types
+     * - a pool lists every living entity whose signature has its bit, each one once, and nothing else
+     * The sections must have been checked to lie inside the file */
+    bool validEntities(const SnapshotHeader &header, const std::uint8_t *data, const SnapshotPool *pools)
+    {
+        const auto *slots = reinterpret_cast<const Entity *>(data + header.slotsOffset);
+        const auto *signatures = reinterpret_cast<const Signature *>(data + header.signaturesOffset);
+        std::uint32_t slotCount = header.slotCount;
+
+        std::vector<std::uint64_t> bitCounts(MAX_COMPONENTS, 0);
+        std::uint32_t livingCount = 0;
+        for (std::uint32_t index = 0; index < slotCount; ++index)
+        {
+            if (entityIndex(slots[index]) != index)
+            {
+                if (signatures[index].any())
+                {
+                    return false;
+                }
+                continue;
+            }
+            ++livingCount;
+            forEachSetBit(signatures[index], [&](ComponentTypeBitPosition bit)
+                          { ++bitCounts[bit]; });
+        }
+        if (livingCount != header.livingCount)
+        {
+            return false;
+        }
+        for (size_t bit = header.poolCount; bit < MAX_COMPONENTS; ++bit)
+        {
+            if (bitCounts[bit] != 0)
+            {
+                return false;
+            }
+        }
+
+        // the free list walks through dead slots only, never twice through one, and reaches all of them
+        std::vector<std::uint32_t> marks(slotCount, 0);
+        std::uint32_t freeCount = 0;
+        for (Entity index = header.freeListHead; index != NULL_ENTITY; index = entityIndex(slots[index]))
+        {
+            if (index >= slotCount || entityIndex(slots[index]) == index || marks[index] != 0)
+            {
+                return false;
+            }
+            marks[index] = 1;
+            ++freeCount;
+        }
+        if (freeCount != slotCount - livingCount)
+        {
+            return false;
+        }
+
+        // marks[slot] is 2 + the bit of the last pool that listed the slot, so no clearing between pools
+        for (ComponentTypeBitPosition bit = 0; bit < header.poolCount; ++bit)
+        {
+            const SnapshotPool &descriptor = pools[bit];
+            if (descriptor.count != bitCounts[bit])
+            {
+                return false;
+            }
+            const auto *entities = reinterpret_cast<const Entity *>(data + descriptor.entitiesOffset);
+            for (std::uint64_t position = 0; position < descriptor.count; ++position)
+            {
+                Entity entity = entities[position];
+                Entity index = entityIndex(entity);
+                if (index >= slotCount || slots[index] != entity || !signatures[index].test(bit) ||
+                    marks[index] == 2u + bit)
+                {
+                    return false;
+                }
+                marks[index] = 2u + bit;
+            }
+        }
+        return true;
+    }
+
+    // writes bytes at the given offset of the file, zero padding from where the stream is
+    void writeAt(std::ostream &out, std::uint64_t &position, std::uint64_t offset, const void *bytes, size_t count)
+    {
+        static const char padding[SNAPSHOT_ALIGNMENT] = {};
+        out.write(padding, static_cast<std::streamsize>(offset - position));
+        out.write(static_cast<const char *>(bytes), static_cast<std::streamsize>(count));
+        position = offset + count;
+    }
+}
+
+MappedFile::MappedFile(const std::string &path)
+{
+#if defined(_WIN32)
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return;
+    }
+    LARGE_INTEGER fileSize;
+    HANDLE mapping = nullptr;
+    if (GetFileSizeEx(file, &fileSize) && fileSize.QuadPart > 0)
+    {
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    }
+    if (!mapping)
+    {
+        CloseHandle(file);
+        return;
+    }
+    mData = static_cast<const std::uint8_t *>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    if (!mData)
+    {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return;
+    }
+    mSize = static_cast<size_t>(fileSize.QuadPart);
+    mMapped = true;
+    mFile = file;
+    mMapping = mapping;
+#elif defined(ECS_SNAPSHOT_MMAP)
+    int file = open(path.c_str(), O_RDONLY);
+    if (file < 0)
+    {
+        return;
+    }
+    struct stat status;
+    if (fstat(file, &status) == 0 && status.st_size > 0)
+    {
+        void *mapped = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+        if (mapped != MAP_FAILED)
+        {
+            // a snapshot is read front to back exactly once
+            madvise(mapped, static_cast<size_t>(status.st_size), MADV_SEQUENTIAL);
+            mData = static_cast<const std::uint8_t *>(mapped);
+            mSize = static_cast<size_t>(status.st_size);
+            mMapped = true;
+        }
+    }
+    // the mapping stays valid once the descriptor is closed
+    close(file);
+#else
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file)
+    {
+        return;
+    }
+    std::streamoff fileSize = file.tellg();
+    if (fileSize <= 0)
+    {
+        return;
+    }
+    // aligned like the sections, so they can be read in place as in a mapping
+    auto *buffer = static_cast<std::uint8_t *>(::operator new(static_cast<size_t>(fileSize), BUFFER_ALIGNMENT));
+    file.seekg(0);
+    if (!file.read(reinterpret_cast<char *>(buffer), fileSize))
+    {
+        ::operator delete(buffer, BUFFER_ALIGNMENT);
+        return;
+    }
+    mData = buffer;
+    mSize = static_cast<size_t>(fileSize);
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+    if (!mData)
+    {
+        return;
+    }
+#if defined(_WIN32)
+    UnmapViewOfFile(mData);
+    CloseHandle(mMapping);
+    CloseHandle(mFile);
+#elif defined(ECS_SNAPSHOT_MMAP)
+    munmap(const_cast<std::uint8_t *>(mData), mSize);
+#else
+    ::operator delete(const_cast<std::uint8_t *>(mData), BUFFER_ALIGNMENT);
+#endif
+}
+
+bool writeSnapshot(std::ostream &out, const EntityManager &entityManager, const ComponentManager &componentManager)
+{
+    if (componentManager.getBackend() != StorageBackend::SparseSet)
+    {
+        return false;
+    }
+    for (ComponentTypeBitPosition bit = 0; bit < componentManager.getComponentTypeCount(); ++bit)
+    {
+        const IComponentArray *pool = componentManager.getComponentArray(bit);
+        if (!pool->isTriviallyCopyable() && !pool->getPackedEntities().empty())
+        {
+            return false;
+        }
+    }
+
+    const ResourceVector<Entity> &slots = entityManager.getSlots();
+    const ResourceVector<Signature> &signatures = entityManager.getSignatures();
+
+    // every offset is known up front, so the file is written in a single pass
+    SnapshotHeader header{};
+    std::memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = SNAPSHOT_VERSION;
+    header.signatureBits = MAX_COMPONENTS;
+    header.slotCount = static_cast<std::uint32_t>(slots.size());
+    header.livingCount = entityManager.getNumLivingEntities();
+    header.freeListHead = entityManager.getFreeListHead();
+    header.poolCount = componentManager.getComponentTypeCount();
+
+    std::uint64_t offset = alignUp(sizeof(SnapshotHeader));
+    header.slotsOffset = offset;
+    offset = alignUp(offset + slots.size() * sizeof(Entity));
+    header.signaturesOffset = offset;
+    offset = alignUp(offset + signatures.size() * sizeof(Signature));
+    header.poolsOffset = offset;
+    offset = alignUp(offset + header.poolCount * sizeof(SnapshotPool));
+
+    std::vector<SnapshotPool> pools = layoutPools(componentManager, offset);
+    header.fileSize = offset;
+
+    std::uint64_t position = 0;
+    writeAt(out, position, 0, &header, sizeof(header));
+    writeAt(out, position, header.slotsOffset, slots.data(), slots.size() * sizeof(Entity));
+    writeAt(out, position, header.signaturesOffset, signatures.data(), signatures.size() * sizeof(Signature));
+    writeAt(out, position, header.poolsOffset, pools.data(), pools.size() * sizeof(SnapshotPool));
+
+    for (const SnapshotPool &descriptor : pools)
+    {
+        const IComponentArray *pool = componentManager.getComponentArray(descriptor.bit);
+        writeAt(out, position, descriptor.entitiesOffset, pool->getPackedEntities().data(),
+                descriptor.count * sizeof(Entity));
+
+        // the pages go straight from the pool to the stream
+        writeAt(out, position, descriptor.componentsOffset, nullptr, 0);
+        pool->writePackedComponents(out);
+        position += descriptor.count * descriptor.componentSize;
+    }
+    writeAt(out, position, header.fileSize, nullptr, 0);
+
+    return static_cast<bool>(out);
+}
+
+bool readSnapshot(const std::uint8_t *data, size_t size, EntityManager &entityManager,
+                  ComponentManager &componentManager, SystemManager &systemManager)
+{
+    if (componentManager.getBackend() != StorageBackend::SparseSet ||
+        reinterpret_cast<std::uintptr_t>(data) % SNAPSHOT_ALIGNMENT != 0 || size < sizeof(SnapshotHeader))
+    {
+        return false;
+    }
+
+    SnapshotHeader header;
+    std::memcpy(&header, data, sizeof(header));
+    if (std::memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) != 0 || header.version != SNAPSHOT_VERSION ||
+        header.signatureBits != MAX_COMPONENTS || header.fileSize != size ||
+        header.slotCount > entityManager.getMaxEntities() || header.livingCount > header.slotCount ||
+        header.poolCount != componentManager.getComponentTypeCount() ||
+        !validSection(header.slotsOffset, std::uint64_t{header.slotCount} * sizeof(Entity), size) ||
+        !validSection(header.signaturesOffset, std::uint64_t{header.slotCount} * sizeof(Signature), size) ||
+        !validSection(header.poolsOffset, std::uint64_t{header.poolCount} * sizeof(SnapshotPool), size))
+    {
+        return false;
+    }
+
+    // the pools must line up with the component types the world registered
+    const auto *pools = reinterpret_cast<const SnapshotPool *>(data + header.poolsOffset);
+    for (ComponentTypeBitPosition bit = 0; bit < header.poolCount; ++bit)
+    {
+        const SnapshotPool &descriptor = pools[bit];
+        const IComponentArray *pool = componentManager.getComponentArray(bit);
+        if (descriptor.bit != bit || descriptor.typeHash != pool->getTypeHash() ||
+            descriptor.componentSize != pool->getComponentSize() || descriptor.count > header.livingCount ||
+            (descriptor.count > 0 && !pool->isTriviallyCopyable()) ||
+            !validSection(descriptor.entitiesOffset, descriptor.count * sizeof(Entity), size) ||
+            !validSection(descriptor.componentsOffset, descriptor.count * descriptor.componentSize, size))
+        {
+            return false;
+        }
+    }
+
+    if (!validEntities(header, data, pools))
+    {
+        return false;
+    }
+
+    entityManager.restore(reinterpret_cast<const Entity *>(data + header.slotsOffset),
+                          reinterpret_cast<const Signature *>(data + header.signaturesOffset), header.slotCount,
+                          header.freeListHead, header.livingCount);
+
+    for (ComponentTypeBitPosition bit = 0; bit < header.poolCount; ++bit)
+    {
+        const SnapshotPool &descriptor = pools[bit];
+        componentManager.getComponentArray(bit)->assignPacked(
+            reinterpret_cast<const Entity *>(data + descriptor.entitiesOffset), data + descriptor.componentsOffset,
+            static_cast<size_t>(descriptor.count));
+    }
+
+    systemManager.rebuildMemberships(entityManager);
+    return true;
+}
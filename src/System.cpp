@@ -1,57 +1,211 @@
 #include "System.hpp"
 
-template <typename T>
-std::shared_ptr<T> SystemManager::registerSystem(Signature signature)
-{
-    SystemTypeID name = typeid(T);
-    assert(mSystems.count(name) == 0 && "System to register already exists");
+#include <atomic>
 
-    auto system = std::make_shared<T>();
-    mSystems.insert({name, system});
-    mSignatures.insert({name, signature});
+// a common interface to propagate changes to each ComponentArray when handling entity destruction event
+void SystemManager::handleDestroyedEntity(Entity entity, const Signature &entity_signature)
+{
+    // Erase a destroyed entity from the lists of the systems it could have been part of
+    forEachSetBit(entity_signature, [&](ComponentTypeBitPosition bit)
+                  {
+                      for (size_t index : mSystemsByComponent[bit])
+                      {
+                          EntitySet &entities = mSystemList[index].system->mEntities;
+                          if (entities.contains(entity))
+                          {
+                              entities.erase(entity);
+                          }
+                      }
+                  });
 
-    return system;
+    for (size_t index : mSystemsWithoutComponents)
+    {
+        EntitySet &entities = mSystemList[index].system->mEntities;
+        if (entities.contains(entity))
+        {
+            entities.erase(entity);
+        }
+    }
 }
 
-template <typename T>
-void SystemManager::setSignature(Signature signature)
+// add or remove entity from the set of every system whose interest overlaps the bits that changed
+void SystemManager::handleEntitySignatureChanged(Entity entity, const Signature &old_signature,
+                                                 const Signature &new_signature)
 {
-    SystemTypeID name = typeid(T);
+    // a system may care about several of the changed bits, the stamp makes sure it is only visited once
+    ++mVisitStamp;
 
-    assert(mSystems.count(name) > 0 && "System used before registered.");
+    forEachSetBit(old_signature ^ new_signature, [&](ComponentTypeBitPosition bit)
+                  {
+                      for (size_t index : mSystemsByComponent[bit])
+                      {
+                          SystemRecord &record = mSystemList[index];
+                          if (record.visitStamp == mVisitStamp)
+                          {
+                              continue;
+                          }
+                          record.visitStamp = mVisitStamp;
+                          updateMembership(record, entity, new_signature);
+                      }
+                  });
 
-    mSignatures.insert({name, signature});
+    for (size_t index : mSystemsWithoutComponents)
+    {
+        updateMembership(mSystemList[index], entity, new_signature);
+    }
 }
 
-// a common interface to propagate changes to each ComponentArray when handling entity destruction event
-void SystemManager::handleDestroyedEntity(Entity entity)
+void SystemManager::getSystemMemory(std::vector<SystemSetMemory> &out) const
 {
-    // Erase a destroyed entity from all system lists
-    // mEntities is a set so no check needed since no error will be thrown
-    for (auto const &pair : mSystems)
+    for (const SystemRecord &record : mSystemList)
     {
-        auto const &system = pair.second;
+        const EntitySet &entities = record.system->mEntities;
+        out.push_back({record.name, entities.size(), entities.getMemoryUsage()});
+    }
+}
 
-        system->mEntities.erase(entity);
+void SystemManager::rebuildMemberships(const EntityManager &entityManager)
+{
+    std::vector<Entity> members;
+    for (SystemRecord &record : mSystemList)
+    {
+        entityManager.query(record.signature, Signature{}, members);
+        record.system->mEntities.assign(members.data(), members.size());
     }
 }
 
-// add or remove entity from each system's set based on the entity and system's signature
-void SystemManager::handleEntitySignatureChanged(Entity entity, Signature entity_signature)
+void SystemManager::rebuildDispatchTable()
 {
-    // Notify each system that an entity's signature changed
-    for (auto const &pair : mSystems)
+    for (auto &systems : mSystemsByComponent)
     {
-        auto const &name = pair.first;
-        auto const &system = pair.second;
-        auto const &system_signature = mSignatures[name];
+        systems.clear();
+    }
+    mSystemsWithoutComponents.clear();
 
-        // Entity signature matches system signature - insert into set
-        if ((entity_signature & system_signature) == system_signature)
+    for (size_t index = 0; index < mSystemList.size(); ++index)
+    {
+        const Signature &signature = mSystemList[index].signature;
+        if (signature.none())
         {
-            system->mEntities.insert(entity);
+            mSystemsWithoutComponents.push_back(index);
             continue;
         }
-        system->mEntities.erase(entity);
+        forEachSetBit(signature, [&](ComponentTypeBitPosition bit)
+                      { mSystemsByComponent[bit].push_back(index); });
+    }
+}
+
+void SystemManager::updateMembership(SystemRecord &record, Entity entity, const Signature &entity_signature)
+{
+    EntitySet &entities = record.system->mEntities;
+    bool isMember = entities.contains(entity);
+
+    // Entity signature matches system signature - insert into set
+    if ((entity_signature & record.signature) == record.signature)
+    {
+        if (!isMember)
+        {
+            entities.insert(entity);
+        }
+        return;
+    }
+    if (isMember)
+    {
+        entities.erase(entity);
+    }
+}
+
+void SystemManager::update()
+{
+    for (SystemRecord &record : mSystemList)
+    {
+        ECS_PROFILE_SCOPE(record.name);
+        record.system->update();
+    }
+}
+
+void SystemManager::update(ThreadPool &pool)
+{
+    if (pool.getWorkerCount() == 0 || mSystemList.size() < 2)
+    {
+        update();
+        return;
+    }
+
+    if (mScheduleDirty)
+    {
+        buildSchedule();
+    }
+
+    for (size_t index = 0; index < mSystemList.size(); ++index)
+    {
+        mRemaining[index].store(mDependencyCounts[index], std::memory_order_relaxed);
+    }
+
+    // a task runs the system at its begin index, the frame outlives every task as wait() returns after the last
+    struct Frame
+    {
+        SystemManager *manager;
+        ThreadPool *pool;
+        TaskGroup group;
+        TaskFunction run;
+    } frame{this, &pool, {}, nullptr};
+
+    frame.run = [](void *context, size_t index, size_t)
+    {
+        Frame &frame = *static_cast<Frame *>(context);
+        SystemManager &manager = *frame.manager;
+        {
+            ECS_PROFILE_SCOPE(manager.mSystemList[index].name);
+            manager.mSystemList[index].system->update();
+        }
+
+        // release every system that was only waiting on this one
+        for (size_t dependent : manager.mDependents[index])
+        {
+            if (manager.mRemaining[dependent].fetch_sub(1, std::memory_order_acq_rel) == 1)
+            {
+                frame.pool->submit(frame.group, frame.run, &frame, dependent);
+            }
+        }
+    };
+
+    for (size_t index = 0; index < mSystemList.size(); ++index)
+    {
+        if (mDependencyCounts[index] == 0)
+        {
+            pool.submit(frame.group, frame.run, &frame, index);
+        }
     }
+    pool.wait(frame.group);
+}
+
+bool SystemManager::conflicts(const SystemRecord &first, const SystemRecord &second)
+{
+    if (!first.accessDeclared || !second.accessDeclared)
+    {
+        return true;
+    }
+    return (first.writes & (second.reads | second.writes)).any() || (second.writes & first.reads).any();
+}
+
+void SystemManager::buildSchedule()
+{
+    mDependents.assign(mSystemList.size(), {});
+    mDependencyCounts.assign(mSystemList.size(), 0);
+    mRemaining.reset(new std::atomic<size_t>[mSystemList.size()]);
+
+    for (size_t later = 0; later < mSystemList.size(); ++later)
+    {
+        for (size_t earlier = 0; earlier < later; ++earlier)
+        {
+            if (conflicts(mSystemList[earlier], mSystemList[later]))
+            {
+                mDependents[earlier].push_back(later);
+                ++mDependencyCounts[later];
+            }
+        }
+    }
+
+    mScheduleDirty = false;
 }
@@ -0,0 +1,157 @@
+#include "ThreadPool.hpp"
+
+// the rings index with a mask
+static_assert((TASK_QUEUE_CAPACITY & (TASK_QUEUE_CAPACITY - 1)) == 0, "Task queue capacity is not a power of two");
+
+namespace
+{
+    // which pool the current thread works for, and which of its queues it owns
+    thread_local const ThreadPool *tCurrentPool = nullptr;
+    thread_local size_t tCurrentQueue = 0;
+}
+
+ThreadPool::ThreadPool(size_t workerCount)
+{
+    for (size_t index = 0; index <= workerCount; ++index)
+    {
+        mQueues.push_back(std::make_unique<TaskQueue>());
+    }
+
+    for (size_t index = 0; index < workerCount; ++index)
+    {
+        mThreads.emplace_back(&ThreadPool::workerLoop, this, index);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mSleepMutex);
+        mStopping = true;
+    }
+    mWakeCondition.notify_all();
+
+    for (std::thread &thread : mThreads)
+    {
+        thread.join();
+    }
+
+    // without workers nobody else would drain the queues
+    while (tryRunTask(mQueues.size() - 1))
+    {
+    }
+}
+
+void ThreadPool::submit(TaskGroup &group, TaskFunction run, void *context, size_t begin, size_t end)
+{
+    group.mPending.fetch_add(1, std::memory_order_relaxed);
+
+    // counted before it is visible so a thief never drives the counter below zero
+    mQueuedTasks.fetch_add(1, std::memory_order_release);
+
+    TaskQueue &queue = *mQueues[currentQueueIndex()];
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.pushBack({run, context, begin, end, &group});
+    }
+
+    // taking the lock orders this wake-up after a worker's check of mQueuedTasks
+    {
+        std::lock_guard<std::mutex> lock(mSleepMutex);
+    }
+    mWakeCondition.notify_one();
+}
+
+void ThreadPool::wait(TaskGroup &group)
+{
+    size_t queueIndex = currentQueueIndex();
+    while (!group.isDone())
+    {
+        if (!tryRunTask(queueIndex))
+        {
+            std::this_thread::yield();
+        }
+    }
+}
+
+bool ThreadPool::tryRunTask(size_t queueIndex)
+{
+    Task task{};
+    bool found = false;
+
+    {
+        TaskQueue &own = *mQueues[queueIndex];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (own.count > 0)
+        {
+            task = own.popBack();
+            found = true;
+        }
+    }
+
+    for (size_t offset = 1; !found && offset < mQueues.size(); ++offset)
+    {
+        TaskQueue &victim = *mQueues[(queueIndex + offset) % mQueues.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (victim.count > 0)
+        {
+            task = victim.popFront();
+            found = true;
+        }
+    }
+
+    if (!found)
+    {
+        return false;
+    }
+
+    mQueuedTasks.fetch_sub(1, std::memory_order_relaxed);
+    task.run(task.context, task.begin, task.end);
+    task.group->mPending.fetch_sub(1, std::memory_order_acq_rel);
+
+    return true;
+}
+
+void ThreadPool::workerLoop(size_t queueIndex)
+{
+    tCurrentPool = this;
+    tCurrentQueue = queueIndex;
+
+    while (true)
+    {
+        if (tryRunTask(queueIndex))
+        {
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(mSleepMutex);
+        mWakeCondition.wait(lock, [this]
+                            { return mStopping || mQueuedTasks.load(std::memory_order_acquire) > 0; });
+        if (mStopping && mQueuedTasks.load(std::memory_order_acquire) == 0)
+        {
+            return;
+        }
+    }
+}
+
+void ThreadPool::TaskQueue::pushBack(const Task &task)
+{
+    if (count == tasks.size())
+    {
+        // unrolled from head so the tasks keep their order in the larger ring
+        std::vector<Task> grown(tasks.size() * 2);
+        for (size_t index = 0; index < count; ++index)
+        {
+            grown[index] = tasks[(head + index) & (tasks.size() - 1)];
+        }
+        tasks.swap(grown);
+        head = 0;
+    }
+    tasks[(head + count) & (tasks.size() - 1)] = task;
+    ++count;
+}
+
+size_t ThreadPool::currentQueueIndex() const
+{
+    return tCurrentPool == this ? tCurrentQueue : mQueues.size() - 1;
+}
@@ -0,0 +1,490 @@
+#include "TileMap.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <type_traits>
+
+static_assert(std::is_trivially_copyable_v<TileMapHeader> && std::is_trivially_copyable_v<TileMapChunkEntry> &&
+                  std::is_trivially_copyable_v<TileMapObject>,
+              "Tile map sections are written as raw bytes");
+
+namespace
+{
+    // furthest a streaming target can be from the map, in chunks, so that the coordinates never overflow
+    const float MAX_CHUNK_COORD = 1 << 20;
+
+    std::uint64_t alignUp(std::uint64_t offset)
+    {
+        return (offset + TILE_MAP_ALIGNMENT - 1) / TILE_MAP_ALIGNMENT * TILE_MAP_ALIGNMENT;
+    }
+
+    // whether [offset, offset + bytes) is an aligned section inside a file of the given size
+    bool validSection(std::uint64_t offset, std::uint64_t bytes, size_t size)
+    {
+        return offset % TILE_MAP_ALIGNMENT == 0 && offset <= size && bytes <= size - offset;
+    }
+
+    std::uint64_t chunkTileBytes(std::uint32_t chunkSize)
+    {
+        return std::uint64_t{chunkSize} * chunkSize * sizeof(std::uint16_t);
+    }
+
+    // writes bytes at the given offset of the file, zero padding from where the stream is
+    void writeAt(std::ostream &out, std::uint64_t &position, std::uint64_t offset, const void *bytes, size_t count)
+    {
+        static const char padding[TILE_MAP_ALIGNMENT] = {};
+        out.write(padding, static_cast<std::streamsize>(offset - position));
+        out.write(static_cast<const char *>(bytes), static_cast<std::streamsize>(count));
+        position = offset + count;
+    }
+
+    std::int32_t chunkDistance(std::int32_t x, std::int32_t y, std::int32_t targetX, std::int32_t targetY)
+    {
+        return std::max(std::abs(x - targetX), std::abs(y - targetY));
+    }
+}
+
+bool writeTileMap(const std::string &path, const TileMapData &map, std::uint32_t chunkSize)
+{
+    assert(chunkSize > 0 && map.tileSize > 0.0f && "Chunks and tiles must not be empty");
+    assert(map.tiles.size() == size_t{map.width} * map.height && "The map must hold width * height tiles");
+
+    TileMapHeader header{};
+    std::memcpy(header.magic, TILE_MAP_MAGIC, sizeof(header.magic));
+    header.version = TILE_MAP_VERSION;
+    header.chunkSize = chunkSize;
+    header.widthInChunks = (map.width + chunkSize - 1) / chunkSize;
+    header.heightInChunks = (map.height + chunkSize - 1) / chunkSize;
+    header.originX = map.originX;
+    header.originY = map.originY;
+    header.tileSize = map.tileSize;
+
+    size_t chunkCount = size_t{header.widthInChunks} * header.heightInChunks;
+
+    // objects bucketed by chunk, keeping their order inside a chunk
+    std::vector<std::vector<TileMapObject>> objects(chunkCount);
+    for (const TileMapObject &object : map.objects)
+    {
+        float chunkWorldSize = map.tileSize * static_cast<float>(chunkSize);
+        auto chunkX = static_cast<std::int64_t>(std::floor((object.x - map.originX) / chunkWorldSize));
+        auto chunkY = static_cast<std::int64_t>(std::floor((object.y - map.originY) / chunkWorldSize));
+        chunkX = std::clamp<std::int64_t>(chunkX, 0, std::max<std::int64_t>(header.widthInChunks, 1) - 1);
+        chunkY = std::clamp<std::int64_t>(chunkY, 0, std::max<std::int64_t>(header.heightInChunks, 1) - 1);
+        if (chunkCount > 0)
+        {
+            objects[static_cast<size_t>(chunkY * header.widthInChunks + chunkX)].push_back(object);
+        }
+    }
+
+    // the tile ids of every chunk, cells past the edge of the map are empty
+    size_t tilesPerChunk = size_t{chunkSize} * chunkSize;
+    std::vector<std::uint16_t> tiles(chunkCount * tilesPerChunk, EMPTY_TILE);
+    std::vector<TileMapChunkEntry> entries(chunkCount);
+    for (size_t y = 0; y < map.height; ++y)
+    {
+        for (size_t x = 0; x < map.width; ++x)
+        {
+            size_t chunk = y / chunkSize * header.widthInChunks + x / chunkSize;
+            std::uint16_t id = map.tiles[y * map.width + x];
+            tiles[chunk * tilesPerChunk + y % chunkSize * chunkSize + x % chunkSize] = id;
+            entries[chunk].tileCount += id != EMPTY_TILE;
+        }
+    }
+
+    // every offset is known up front, so the file is written in a single pass
+    std::uint64_t offset = alignUp(sizeof(TileMapHeader));
+    header.chunksOffset = offset;
+    offset = alignUp(offset + chunkCount * sizeof(TileMapChunkEntry));
+    for (size_t chunk = 0; chunk < chunkCount; ++chunk)
+    {
+        entries[chunk].offset = offset;
+        entries[chunk].objectCount = static_cast<std::uint32_t>(objects[chunk].size());
+        offset = alignUp(alignUp(offset + chunkTileBytes(chunkSize)) + objects[chunk].size() * sizeof(TileMapObject));
+    }
+    header.fileSize = offset;
+
+    std::ofstream file(path, std::ios::binary);
+    if (!file)
+    {
+        return false;
+    }
+
+    std::uint64_t position = 0;
+    writeAt(file, position, 0, &header, sizeof(header));
+    writeAt(file, position, header.chunksOffset, entries.data(), entries.size() * sizeof(TileMapChunkEntry));
+    for (size_t chunk = 0; chunk < chunkCount; ++chunk)
+    {
+        writeAt(file, position, entries[chunk].offset, tiles.data() + chunk * tilesPerChunk,
+                tilesPerChunk * sizeof(std::uint16_t));
+        writeAt(file, position, alignUp(position), objects[chunk].data(),
+                objects[chunk].size() * sizeof(TileMapObject));
+    }
+    writeAt(file, position, header.fileSize, nullptr, 0);
+
+    file.close();
+    return !file.fail();
+}
+
+bool TileMapFile::open(const std::string &path)
+{
+    mFile = std::make_unique<MappedFile>(path);
+    mChunks = nullptr;
+
+    const std::uint8_t *data = mFile->data();
+    size_t size = mFile->size();
+    if (!mFile->isOpen() || size < sizeof(TileMapHeader))
+    {
+        mFile.reset();
+        return false;
+    }
+
+    std::memcpy(&mHeader, data, sizeof(mHeader));
+    std::uint64_t chunkCount = std::uint64_t{mHeader.widthInChunks} * mHeader.heightInChunks;
+    if (std::memcmp(mHeader.magic, TILE_MAP_MAGIC, sizeof(mHeader.magic)) != 0 ||
+        mHeader.version != TILE_MAP_VERSION || mHeader.fileSize != size || mHeader.chunkSize == 0 ||
+        !(mHeader.tileSize > 0.0f) || mHeader.widthInChunks > MAX_CHUNK_COORD ||
+        mHeader.heightInChunks > MAX_CHUNK_COORD ||
+        !validSection(mHeader.chunksOffset, chunkCount * sizeof(TileMapChunkEntry), size))
+    {
+        mFile.reset();
+        return false;
+    }
+
+    // every chunk is checked up front so decodeChunk never has to
+    const auto *chunks = reinterpret_cast<const TileMapChunkEntry *>(data + mHeader.chunksOffset);
+    std::uint64_t tileBytes = chunkTileBytes(mHeader.chunkSize);
+    for (std::uint64_t chunk = 0; chunk < chunkCount; ++chunk)
+    {
+        const TileMapChunkEntry &entry = chunks[chunk];
+        if (entry.tileCount > std::uint64_t{mHeader.chunkSize} * mHeader.chunkSize ||
+            !validSection(entry.offset, tileBytes, size) ||
+            !validSection(alignUp(entry.offset + tileBytes), std::uint64_t{entry.objectCount} * sizeof(TileMapObject),
+                          size))
+        {
+            mFile.reset();
+            return false;
+        }
+    }
+
+    mChunks = chunks;
+    return true;
+}
+
+void TileMapFile::decodeChunk(std::int32_t x, std::int32_t y, DecodedChunk &out) const
+{
+    assert(isOpen() && containsChunk(x, y) && "Chunk is not in the map");
+
+    const TileMapChunkEntry &entry = mChunks[static_cast<size_t>(y) * mHeader.widthInChunks + x];
+    std::uint32_t chunkSize = mHeader.chunkSize;
+    const auto *tiles = reinterpret_cast<const std::uint16_t *>(mFile->data() + entry.offset);
+    const auto *objects =
+        reinterpret_cast<const TileMapObject *>(mFile->data() + alignUp(entry.offset + chunkTileBytes(chunkSize)));
+
+    out.x = x;
+    out.y = y;
+    out.tilePositions.clear();
+    out.tiles.clear();
+    out.objectPositions.clear();
+    out.objects.clear();
+
+    out.tilePositions.reserve(entry.tileCount);
+    out.tiles.reserve(entry.tileCount);
+    float firstX = mHeader.originX + static_cast<float>(std::int64_t{x} * chunkSize) * mHeader.tileSize;
+    float firstY = mHeader.originY + static_cast<float>(std::int64_t{y} * chunkSize) * mHeader.tileSize;
+    for (std::uint32_t tileY = 0; tileY < chunkSize; ++tileY)
+    {
+        for (std::uint32_t tileX = 0; tileX < chunkSize; ++tileX)
+        {
+            std::uint16_t id = tiles[tileY * chunkSize + tileX];
+            if (id == EMPTY_TILE)
+            {
+                continue;
+            }
+            out.tilePositions.push_back({firstX + static_cast<float>(tileX) * mHeader.tileSize,
+                                         firstY + static_cast<float>(tileY) * mHeader.tileSize});
+            out.tiles.push_back({id});
+        }
+    }
+
+    out.objectPositions.reserve(entry.objectCount);
+    out.objects.reserve(entry.objectCount);
+    for (std::uint32_t index = 0; index < entry.objectCount; ++index)
+    {
+        out.objectPositions.push_back({objects[index].x, objects[index].y});
+        out.objects.push_back({objects[index].type});
+    }
+}
+
+TileMapStreamer::~TileMapStreamer()
+{
+    close();
+}
+
+bool TileMapStreamer::open(Game &game, const std::string &path)
+{
+    close();
+    if (!mMap.open(path))
+    {
+        return false;
+    }
+
+    mGame = &game;
+    mStopping = false;
+    mLoader = std::thread(&TileMapStreamer::loaderLoop, this);
+    return true;
+}
+
+void TileMapStreamer::close()
+{
+    if (mLoader.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mStopping = true;
+        }
+        mRequestCondition.notify_all();
+        mLoader.join();
+    }
+
+    for (auto &pair : mChunks)
+    {
+        if (pair.second.state == ChunkState::Active)
+        {
+            despawn(pair.second);
+        }
+    }
+    mChunks.clear();
+    mRequests.clear();
+    mDecoded.clear();
+}
+
+void TileMapStreamer::update(float x, float y)
+{
+    ECS_PROFILE_SCOPE("TileMapStreamer");
+
+    retarget(x, y);
+    collectDecoded();
+    spawnDecoded(mMaxSpawnsPerUpdate);
+}
+
+void TileMapStreamer::loadAround(float x, float y)
+{
+    ECS_PROFILE_SCOPE("TileMapStreamer");
+
+    retarget(x, y);
+    for (;;)
+    {
+        collectDecoded();
+        spawnDecoded(mChunks.size());
+        if (getPendingChunkCount() == 0)
+        {
+            return;
+        }
+
+        std::unique_lock<std::mutex> lock(mMutex);
+        mDecodedCondition.wait(lock, [this]
+                               { return !mDecoded.empty(); });
+    }
+}
+
+TileMapStreamer::ChunkCoord TileMapStreamer::chunkAt(float x, float y) const
+{
+    const TileMapHeader &header = mMap.getHeader();
+    float chunkWorldSize = header.tileSize * static_cast<float>(header.chunkSize);
+    float chunkX = std::floor((x - header.originX) / chunkWorldSize);
+    float chunkY = std::floor((y - header.originY) / chunkWorldSize);
+
+    // a NaN lands on the lower bound
+    return {static_cast<std::int32_t>(std::clamp(chunkX, -MAX_CHUNK_COORD, MAX_CHUNK_COORD)),
+            static_cast<std::int32_t>(std::clamp(chunkY, -MAX_CHUNK_COORD, MAX_CHUNK_COORD))};
+}
+
+void TileMapStreamer::retarget(float x, float y)
+{
+    assert(mMap.isOpen() && "No tile map is open");
+
+    mTarget = chunkAt(x, y);
+    std::int32_t keepRadius = mActivationRadius + 1;
+
+    for (auto iterator = mChunks.begin(); iterator != mChunks.end();)
+    {
+        StreamedChunk &chunk = iterator->second;
+        auto chunkX = static_cast<std::int32_t>(iterator->first >> 32);
+        auto chunkY = static_cast<std::int32_t>(iterator->first & 0xffffffffu);
+        if (chunkDistance(chunkX, chunkY, mTarget.x, mTarget.y) <= keepRadius)
+        {
+            ++iterator;
+            continue;
+        }
+
+        // a queued chunk may still be decoded, it is dropped when it comes back
+        if (chunk.state == ChunkState::Active)
+        {
+            despawn(chunk);
+        }
+        iterator = mChunks.erase(iterator);
+    }
+
+    mMissing.clear();
+    for (std::int32_t chunkY = mTarget.y - mActivationRadius; chunkY <= mTarget.y + mActivationRadius; ++chunkY)
+    {
+        for (std::int32_t chunkX = mTarget.x - mActivationRadius; chunkX <= mTarget.x + mActivationRadius; ++chunkX)
+        {
+            if (mMap.containsChunk(chunkX, chunkY) && mChunks.find(chunkKey(chunkX, chunkY)) == mChunks.end())
+            {
+                mChunks[chunkKey(chunkX, chunkY)].state = ChunkState::Queued;
+                mMissing.push_back({chunkX, chunkY});
+            }
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    // requests the target moved away from are not worth decoding anymore
+    ChunkCoord target = mTarget;
+    mRequests.erase(std::remove_if(mRequests.begin(), mRequests.end(),
+                                   [target, keepRadius](const ChunkCoord &coord)
+                                   { return chunkDistance(coord.x, coord.y, target.x, target.y) > keepRadius; }),
+                    mRequests.end());
+    if (mMissing.empty())
+    {
+        return;
+    }
+
+    // nearest first, the older requests included since the target may have moved
+    mRequests.insert(mRequests.end(), mMissing.begin(), mMissing.end());
+    std::stable_sort(mRequests.begin(), mRequests.end(),
+                     [target](const ChunkCoord &first, const ChunkCoord &second)
+                     {
+                         return chunkDistance(first.x, first.y, target.x, target.y) <
+                                chunkDistance(second.x, second.y, target.x, target.y);
+                     });
+    mRequestCondition.notify_one();
+}
+
+void TileMapStreamer::collectDecoded()
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mCollected.swap(mDecoded);
+    }
+
+    for (std::unique_ptr<DecodedChunk> &decoded : mCollected)
+    {
+        auto iterator = mChunks.find(chunkKey(decoded->x, decoded->y));
+        if (iterator != mChunks.end() && iterator->second.state == ChunkState::Queued)
+        {
+            iterator->second.state = ChunkState::Decoded;
+            iterator->second.decoded = std::move(decoded);
+        }
+    }
+    mCollected.clear();
+}
+
+void TileMapStreamer::spawnDecoded(size_t maxChunks)
+{
+    mSpawnOrder.clear();
+    for (auto &pair : mChunks)
+    {
+        if (pair.second.state == ChunkState::Decoded)
+        {
+            mSpawnOrder.push_back(&pair.second);
+        }
+    }
+
+    size_t count = std::min(maxChunks, mSpawnOrder.size());
+    ChunkCoord target = mTarget;
+    std::partial_sort(mSpawnOrder.begin(), mSpawnOrder.begin() + count, mSpawnOrder.end(),
+                      [target](const StreamedChunk *first, const StreamedChunk *second)
+                      {
+                          return chunkDistance(first->decoded->x, first->decoded->y, target.x, target.y) <
+                                 chunkDistance(second->decoded->x, second->decoded->y, target.x, target.y);
+                      });
+    for (size_t index = 0; index < count; ++index)
+    {
+        spawn(*mSpawnOrder[index]);
+    }
+}
+
+void TileMapStreamer::spawn(StreamedChunk &chunk)
+{
+    const DecodedChunk &decoded = *chunk.decoded;
+    size_t tileCount = decoded.tiles.size();
+    size_t objectCount = decoded.objects.size();
+
+    chunk.entities.resize(tileCount + objectCount);
+    Entity *tiles = chunk.entities.data();
+    Entity *objects = tiles + tileCount;
+
+    if (tileCount > 0)
+    {
+        mGame->CreateEntities(tileCount, tiles);
+        mGame->AttachComponents<Position, Tile>(tiles, tileCount, decoded.tilePositions.data(), decoded.tiles.data());
+    }
+    if (objectCount > 0)
+    {
+        mGame->CreateEntities(objectCount, objects);
+        mGame->AttachComponents<Position, MapObject>(objects, objectCount, decoded.objectPositions.data(),
+                                                     decoded.objects.data());
+        if (mObjectSpawner)
+        {
+            mObjectSpawner(objects, decoded.objects.data(), objectCount);
+        }
+    }
+
+    chunk.state = ChunkState::Active;
+    chunk.decoded.reset();
+    ++mActiveChunkCount;
+    mActiveEntityCount += chunk.entities.size();
+}
+
+void TileMapStreamer::despawn(StreamedChunk &chunk)
+{
+    // the game may have destroyed some of them already, e.g. a squashed enemy
+    mAlive.clear();
+    for (Entity entity : chunk.entities)
+    {
+        if (mGame->IsAlive(entity))
+        {
+            mAlive.push_back(entity);
+        }
+    }
+    mGame->DestroyEntities(mAlive.data(), mAlive.size());
+
+    --mActiveChunkCount;
+    mActiveEntityCount -= chunk.entities.size();
+    chunk.entities.clear();
+}
+
+void TileMapStreamer::loaderLoop()
+{
+    for (;;)
+    {
+        ChunkCoord coord;
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mRequestCondition.wait(lock, [this]
+                                   { return mStopping || !mRequests.empty(); });
+            if (mStopping)
+            {
+                return;
+            }
+            coord = mRequests.front();
+            mRequests.pop_front();
+        }
+
+        auto decoded = std::make_unique<DecodedChunk>();
+        {
+            ECS_PROFILE_SCOPE("decode chunk");
+            mMap.decodeChunk(coord.x, coord.y, *decoded);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mDecoded.push_back(std::move(decoded));
+        }
+        mDecodedCondition.notify_all();
+    }
+}
@@ -0,0 +1,431 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <new>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "Entity.hpp"
+#include "Memory.hpp"
+#include "ThreadPool.hpp"
+
+// size in bytes of one chunk of an archetype, every column of the archetype is packed into it
+const size_t ARCHETYPE_CHUNK_BYTES = 16 * 1024;
+
+// chunks are aligned to a cache line so every column starts on its own line
+const size_t ARCHETYPE_CHUNK_ALIGNMENT = 64;
+
+/** the type-erased operations an archetype needs to move a component type around */
+struct ComponentColumnInfo
+{
+    size_t size{};
+    size_t alignment{};
+
+    // move-constructs the component at src into the uninitialised dst, then destroys the one at src
+    void (*relocate)(void *dst, void *src){};
+
+    void (*destroy)(void *component){};
+};
+
+template <typename T>
+ComponentColumnInfo makeComponentColumnInfo()
+{
+    static_assert(alignof(T) <= ARCHETYPE_CHUNK_ALIGNMENT, "Component is over-aligned for an archetype chunk");
+    static_assert(sizeof(T) + sizeof(Entity) <= ARCHETYPE_CHUNK_BYTES, "Component is too big for an archetype chunk");
+
+    ComponentColumnInfo info;
+    info.size = sizeof(T);
+    info.alignment = alignof(T);
+    info.relocate = [](void *dst, void *src)
+    {
+        T *from = static_cast<T *>(src);
+        new (dst) T(std::move(*from));
+        from->~T();
+    };
+    info.destroy = [](void *component)
+    { static_cast<T *>(component)->~T(); };
+    return info;
+}
+
+/** counters describing how much work the archetype backend has done moving entities between archetypes */
+struct ArchetypeStats
+{
+    // number of times an entity changed archetype because a component was attached or detached
+    std::uint64_t migrations{};
+
+    // bytes of component data relocated, both by migrations and by filling the hole they leave behind
+    std::uint64_t bytesMoved{};
+
+    size_t archetypeCount{};
+
+    size_t chunkCount{};
+};
+
+/** all entities that share exactly the same Signature, stored as SoA columns in fixed-size chunks.
+ * Rows are packed: row r lives in chunk r / chunkCapacity, and removing a row moves the last
+ * row into its place so iterating a chunk's columns is always a linear walk over memory */
+class Archetype
+{
+public:
+    /** columnInfo is indexed by bit position, only the bits set in the signature are read.
+     * Chunks and the column table are allocated from the resource. Throws std::length_error when not even
+     * one row of the signature's components fits into a chunk */
+    Archetype(const Signature &signature, const std::array<ComponentColumnInfo, MAX_COMPONENTS> &columnInfo,
+              std::pmr::memory_resource *resource);
+
+    Archetype(const Archetype &) = delete;
+    Archetype &operator=(const Archetype &) = delete;
+
+    // destroys every component still stored and releases the chunks
+    ~Archetype();
+
+    const Signature &getSignature() const { return mSignature; }
+
+    size_t size() const { return mSize; }
+
+    size_t chunkCapacity() const { return mChunkCapacity; }
+
+    size_t chunkCount() const { return mChunks.size(); }
+
+    // bytes of component data stored per entity
+    size_t rowBytes() const { return mRowBytes; }
+
+    bool hasColumn(ComponentTypeBitPosition bit) const { return mColumnOfBit[bit] >= 0; }
+
+    // number of rows in use in the given chunk
+    size_t chunkSize(size_t chunk) const
+    {
+        size_t begin = chunk * mChunkCapacity;
+        if (begin >= mSize)
+        {
+            return 0;
+        }
+        return mSize - begin < mChunkCapacity ? mSize - begin : mChunkCapacity;
+    }
+
+    Entity *chunkEntities(size_t chunk)
+    {
+        return reinterpret_cast<Entity *>(mChunks[chunk]);
+    }
+
+    // start of the given component's column inside a chunk
+    void *chunkColumn(size_t chunk, ComponentTypeBitPosition bit)
+    {
+        assert(hasColumn(bit) && "Archetype does not store this component");
+        return mChunks[chunk] + mColumns[mColumnOfBit[bit]].offset;
+    }
+
+    Entity entityAt(size_t row) const
+    {
+        return reinterpret_cast<const Entity *>(mChunks[row / mChunkCapacity])[row % mChunkCapacity];
+    }
+
+    void *componentAt(ComponentTypeBitPosition bit, size_t row)
+    {
+        const Column &column = mColumns[mColumnOfBit[bit]];
+        return mChunks[row / mChunkCapacity] + column.offset + (row % mChunkCapacity) * column.info.size;
+    }
+
+    // appends a row for the entity whose components are left uninitialised, returns the new row
+    size_t pushRow(Entity entity);
+
+    // removes a row whose components have already been destroyed or relocated out,
+    // the last row is relocated into its place and its entity is returned (NULL_ENTITY if nothing moved)
+    Entity eraseRow(size_t row);
+
+    // destroys every component of the row, it still has to be erased afterwards
+    void destroyRow(size_t row);
+
+private:
+    friend class ArchetypeStorage;
+
+    struct Column
+    {
+        ComponentTypeBitPosition bit{};
+        size_t offset{};
+        ComponentColumnInfo info{};
+    };
+
+    Signature mSignature;
+
+    ResourceVector<Column> mColumns;
+
+    // maps a component's bit position to its index in mColumns, -1 if the archetype does not store it
+    std::array<std::int16_t, MAX_COMPONENTS> mColumnOfBit;
+
+    std::pmr::memory_resource *mResource;
+
+    ResourceVector<std::byte *> mChunks;
+
+    size_t mChunkCapacity{};
+
+    size_t mRowBytes{};
+
+    size_t mSize{};
+
+    // cached neighbours reached by attaching / detaching a component, saves hashing the signature
+    std::array<Archetype *, MAX_COMPONENTS> mAddEdges{};
+    std::array<Archetype *, MAX_COMPONENTS> mRemoveEdges{};
+};
+
+/** optional storage backend that groups entities by Signature into archetypes.
+ * Attaching or detaching a component migrates the entity to the archetype of its new signature,
+ * which costs a copy of the whole row (see ArchetypeStats) but lets multi-component queries
+ * stream contiguous columns instead of doing one sparse lookup per component */
+class ArchetypeStorage
+{
+public:
+    // every archetype, its chunks and the storage's tables are allocated from the resource
+    explicit ArchetypeStorage(std::pmr::memory_resource *resource = std::pmr::get_default_resource())
+        : mResource(resource), mArchetypes(resource), mArchetypeList(resource), mLocations(resource)
+    {
+    }
+
+    template <typename T>
+    void registerComponentType(ComponentTypeBitPosition bit)
+    {
+        assert(bit < MAX_COMPONENTS && "Too many component types registered");
+        mColumnInfo[bit] = makeComponentColumnInfo<T>();
+    }
+
+    template <typename T>
+    void attachComponent(Entity entity, ComponentTypeBitPosition bit, T component)
+    {
+        assert(!hasComponent(entity, bit) && "Component to add already existed on Entity");
+
+        Archetype *source = locationOf(entity).archetype;
+        Archetype *target = getAddEdge(source, bit);
+        size_t row = migrate(entity, target);
+
+        new (target->componentAt(bit, row)) T(std::move(component));
+    }
+
+    // attaches values[i]... to entities[i], each entity migrates once straight to its final archetype
+    template <typename... Ts>
+    void attachComponents(const Entity *entities, size_t count,
+                          const std::array<ComponentTypeBitPosition, sizeof...(Ts)> &bits, const Ts *...values)
+    {
+        Signature added;
+        for (ComponentTypeBitPosition bit : bits)
+        {
+            added.set(bit);
+        }
+
+        // entities of a batch usually come from the same archetype, remember the last hop
+        Archetype *lastSource = nullptr;
+        Archetype *lastTarget = nullptr;
+
+        for (size_t index = 0; index < count; ++index)
+        {
+            Entity entity = entities[index];
+            assert(std::none_of(bits.begin(), bits.end(), [&](ComponentTypeBitPosition bit)
+                                { return hasComponent(entity, bit); }) &&
+                   "Component to add already existed on Entity");
+
+            Archetype *source = locationOf(entity).archetype;
+            if (!lastTarget || source != lastSource)
+            {
+                Signature signature = source ? source->getSignature() : Signature{};
+                lastSource = source;
+                lastTarget = getOrCreateArchetype(signature | added);
+            }
+
+            size_t row = migrate(entity, lastTarget);
+            constructRow(*lastTarget, row, bits, std::index_sequence_for<Ts...>{}, values[index]...);
+        }
+    }
+
+    void detachComponent(Entity entity, ComponentTypeBitPosition bit);
+
+    template <typename T>
+    T &getComponent(Entity entity, ComponentTypeBitPosition bit)
+    {
+        assert(hasComponent(entity, bit) && "Component to get does not exist on entity");
+
+        const EntityLocation &location = mLocations[entityIndex(entity)];
+        return *static_cast<T *>(location.archetype->componentAt(bit, location.row));
+    }
+
+    bool hasComponent(Entity entity, ComponentTypeBitPosition bit) const;
+
+    // destroys every component the entity owns and removes it from its archetype
+    void handleDestroyedEntity(Entity entity);
+
+    // invokes func(entity, Ts&...) (or func(Ts&...)) for every entity owning all the given components
+    // and none of the excluded ones, walking each matching archetype chunk by chunk
+    template <typename... Ts, typename Func>
+    void each(const std::array<ComponentTypeBitPosition, sizeof...(Ts)> &bits, const Signature &exclude, Func &&func)
+    {
+        Signature include;
+        for (ComponentTypeBitPosition bit : bits)
+        {
+            include.set(bit);
+        }
+
+        for (Archetype *archetype : mArchetypeList)
+        {
+            if ((archetype->getSignature() & include) != include || (archetype->getSignature() & exclude).any())
+            {
+                continue;
+            }
+            for (size_t chunk = 0; chunk < archetype->chunkCount(); ++chunk)
+            {
+                eachInChunk<Ts...>(*archetype, chunk, bits, func, std::index_sequence_for<Ts...>{});
+            }
+        }
+    }
+
+    // invokes func(count, Ts*...) once per matching chunk with the chunk's columns,
+    // for kernels that want to stream whole columns rather than visit entities one by one
+    template <typename... Ts, typename Func>
+    void eachChunk(const std::array<ComponentTypeBitPosition, sizeof...(Ts)> &bits, const Signature &exclude,
+                   Func &&func)
+    {
+        Signature include;
+        for (ComponentTypeBitPosition bit : bits)
+        {
+            include.set(bit);
+        }
+
+        for (Archetype *archetype : mArchetypeList)
+        {
+            if ((archetype->getSignature() & include) != include || (archetype->getSignature() & exclude).any())
+            {
+                continue;
+            }
+            for (size_t chunk = 0; chunk < archetype->chunkCount(); ++chunk)
+            {
+                size_t count = archetype->chunkSize(chunk);
+                if (count > 0)
+                {
+                    eachChunkColumns<Ts...>(*archetype, chunk, count, bits, func, std::index_sequence_for<Ts...>{});
+                }
+            }
+        }
+    }
+
+    // same as each, every matching chunk becomes one task of the pool
+    template <typename... Ts, typename Func>
+    void parallelEach(ThreadPool &pool, const std::array<ComponentTypeBitPosition, sizeof...(Ts)> &bits,
+                      const Signature &exclude, Func &&func)
+    {
+        Signature include;
+        for (ComponentTypeBitPosition bit : bits)
+        {
+            include.set(bit);
+        }
+
+        ResourceVector<std::pair<Archetype *, size_t>> chunks(mResource);
+        for (Archetype *archetype : mArchetypeList)
+        {
+            if ((archetype->getSignature() & include) != include || (archetype->getSignature() & exclude).any())
+            {
+                continue;
+            }
+            for (size_t chunk = 0; chunk < archetype->chunkCount(); ++chunk)
+            {
+                chunks.push_back({archetype, chunk});
+            }
+        }
+
+        pool.parallelFor(0, chunks.size(), 1, [&](size_t begin, size_t end)
+                         {
+                             for (size_t index = begin; index < end; ++index)
+                             {
+                                 eachInChunk<Ts...>(*chunks[index].first, chunks[index].second, bits, func,
+                                                    std::index_sequence_for<Ts...>{});
+                             } });
+    }
+
+    ArchetypeStats getStats() const;
+
+private:
+    struct EntityLocation
+    {
+        Archetype *archetype{};
+        size_t row{};
+    };
+
+    template <typename... Ts, typename Func, size_t... Is>
+    static void eachInChunk(Archetype &archetype, size_t chunk,
+                            const std::array<ComponentTypeBitPosition, sizeof...(Ts)> &bits,
+                            Func &func, std::index_sequence<Is...>)
+    {
+        size_t count = archetype.chunkSize(chunk);
+        Entity *entities = archetype.chunkEntities(chunk);
+        std::tuple<Ts *...> columns{static_cast<Ts *>(archetype.chunkColumn(chunk, bits[Is]))...};
+
+        for (size_t slot = 0; slot < count; ++slot)
+        {
+            if constexpr (std::is_invocable_v<Func &, Entity, Ts &...>)
+            {
+                func(entities[slot], std::get<Is>(columns)[slot]...);
+            }
+            else
+            {
+                func(std::get<Is>(columns)[slot]...);
+            }
+        }
+    }
+
+    template <typename... Ts, typename Func, size_t... Is>
+    static void eachChunkColumns(Archetype &archetype, size_t chunk, size_t count,
+                                 const std::array<ComponentTypeBitPosition, sizeof...(Ts)> &bits,
+                                 Func &func, std::index_sequence<Is...>)
+    {
+        func(count, static_cast<Ts *>(archetype.chunkColumn(chunk, bits[Is]))...);
+    }
+
+    template <typename... Ts, size_t... Is>
+    static void constructRow(Archetype &archetype, size_t row,
+                             const std::array<ComponentTypeBitPosition, sizeof...(Ts)> &bits,
+                             std::index_sequence<Is...>, const Ts &...values)
+    {
+        (new (archetype.componentAt(bits[Is], row)) Ts(values), ...);
+    }
+
+    // returns the entity's location, growing the table when the slot has never been seen
+    EntityLocation &locationOf(Entity entity);
+
+    Archetype *getOrCreateArchetype(const Signature &signature);
+
+    // archetype reached by attaching / detaching the component, nullptr stands for "no components"
+    Archetype *getAddEdge(Archetype *source, ComponentTypeBitPosition bit);
+    Archetype *getRemoveEdge(Archetype *source, ComponentTypeBitPosition bit);
+
+    // moves the components shared with target out of the entity's current row into a new row of target,
+    // components target does not store are destroyed. Returns the entity's new row
+    size_t migrate(Entity entity, Archetype *target);
+
+    // erases a row and fixes up the location of the entity moved into it
+    void eraseRow(Archetype *archetype, size_t row);
+
+    std::pmr::memory_resource *mResource;
+
+    // indexed by bit position, filled in as component types are registered
+    std::array<ComponentColumnInfo, MAX_COMPONENTS> mColumnInfo{};
+
+    // owns every archetype, the archetypes are allocated from mResource as well
+    std::unordered_map<Signature, std::shared_ptr<Archetype>, std::hash<Signature>, std::equal_to<Signature>,
+                       ResourceAllocator<std::pair<const Signature, std::shared_ptr<Archetype>>>>
+        mArchetypes;
+
+    // every archetype in creation order, walked by queries
+    ResourceVector<Archetype *> mArchetypeList;
+
+    // indexed by the entity's slot
+    ResourceVector<EntityLocation> mLocations;
+
+    std::uint64_t mMigrations{};
+
+    std::uint64_t mBytesMoved{};
+};
@@ -0,0 +1,214 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "ThreadPool.hpp"
+
+#if defined(ECS_WITH_SFML)
+#include <SFML/Graphics/Texture.hpp>
+#endif
+
+// side of an atlas page when none is given, a size every GPU SFML runs on supports
+const std::uint32_t DEFAULT_ATLAS_PAGE_SIZE = 2048;
+
+// empty pixels kept between packed images, so sampling at a region's edge never bleeds into its neighbour
+const std::uint32_t DEFAULT_ATLAS_PADDING = 1;
+
+// shared atlas pages an image is tried against before a new page is opened, the most recent ones.
+// Bounds the cost of packing an image whatever the number of pages
+const size_t ATLAS_OPEN_PAGES = 8;
+
+// an 8 bit RGBA image, row by row from the top row
+struct Image
+{
+    std::uint32_t width{};
+    std::uint32_t height{};
+    std::vector<std::uint8_t> pixels;
+};
+
+// fills out with the image at path, returns false when it cannot. Called from worker threads,
+// so it must be safe to run concurrently
+using ImageDecoder = std::function<bool(const std::string &path, Image &out)>;
+
+/** packs rectangles into a fixed size page with the skyline heuristic:
+ * the edge of the packed area is tracked as a list of horizontal segments, and a rectangle goes where
+ * its far edge ends up nearest to y = 0, the least area lost under it breaking ties.
+ * Packing sorted by decreasing height gets the best occupancy out of it */
+class SkylinePacker
+{
+public:
+    SkylinePacker(std::uint32_t width, std::uint32_t height);
+
+    // finds room for a width * height rectangle, writes where it went and returns false when it does not fit
+    bool insert(std::uint32_t width, std::uint32_t height, std::uint32_t &x, std::uint32_t &y);
+
+    std::uint32_t getWidth() const { return mWidth; }
+
+    std::uint32_t getHeight() const { return mHeight; }
+
+    // area of the inserted rectangles over the area of the page
+    double getOccupancy() const { return static_cast<double>(mUsedArea) / (static_cast<double>(mWidth) * mHeight); }
+
+private:
+    struct Segment
+    {
+        std::uint32_t x;
+        std::uint32_t y;
+        std::uint32_t width;
+    };
+
+    // smallest y a rectangle starting at segment index can sit at and the area it leaves unused below it,
+    // false when it runs off the page
+    bool fitAt(size_t index, std::uint32_t width, std::uint32_t height, std::uint32_t &y,
+               std::uint64_t &waste) const;
+
+    std::uint32_t mWidth;
+    std::uint32_t mHeight;
+    std::uint64_t mUsedArea{};
+
+    // the skyline from left to right, covering the whole width
+    std::vector<Segment> mSkyline;
+};
+
+// where a texture ended up: its page and its rectangle on that page, in pixels
+struct AtlasRegion
+{
+    std::uint32_t page;
+    std::uint32_t x;
+    std::uint32_t y;
+    std::uint32_t width;
+    std::uint32_t height;
+};
+
+// a page of the atlas, its pixels stay on the CPU until uploaded
+struct AtlasPage
+{
+    SkylinePacker packer;
+    Image image;
+    // bumped every time a texture is copied into the page, an upload is only needed when it moved
+    std::uint64_t version{};
+};
+
+enum class AssetState
+{
+    Loading,
+    Ready,
+    Failed,
+};
+
+/** a texture of the cache. Its state is published by the decoding thread with release semantics,
+ * so once getState() returns Ready the rest can be read without further synchronization */
+class TextureAsset
+{
+public:
+    const std::string &getPath() const { return mPath; }
+
+    AssetState getState() const { return mState.load(std::memory_order_acquire); }
+
+    std::uint32_t getWidth() const { return mWidth; }
+
+    std::uint32_t getHeight() const { return mHeight; }
+
+    // whether AssetCache::buildAtlas gave it a region yet
+    bool isPacked() const { return mPacked; }
+
+    const AtlasRegion &getRegion() const { return mRegion; }
+
+private:
+    friend class AssetCache;
+
+    std::string mPath;
+    std::atomic<AssetState> mState{AssetState::Loading};
+
+    std::uint32_t mWidth{};
+    std::uint32_t mHeight{};
+    // the decoded pixels, released once copied into the atlas
+    Image mImage;
+
+    bool mPacked{};
+    AtlasRegion mRegion{};
+};
+
+// a reference counted texture, every handle to the same path shares one asset
+using TextureHandle = std::shared_ptr<const TextureAsset>;
+
+/** loads textures once per path and packs them into atlas pages, so sprites share a few textures.
+ * - load() returns at once, the image is decoded on the thread pool (or on the calling thread without one)
+ * - handles are deduplicated by path while at least one is alive, a texture is freed with its last handle
+ * - buildAtlas() packs the textures decoded since the last call into the current pages, opening pages as
+ *   needed. Images too big to share a page get a page of their own. The room of a freed texture is not
+ *   reused, start a new cache to compact the atlas
+ * The cache and its atlas are meant to be used from one thread, only the decoding runs elsewhere.
+ * Without a decoder of its own the cache decodes with SFML when built with ECS_WITH_SFML, and fails
+ * every load otherwise */
+class AssetCache
+{
+public:
+    explicit AssetCache(ThreadPool *pool = nullptr, std::uint32_t pageSize = DEFAULT_ATLAS_PAGE_SIZE,
+                        std::uint32_t padding = DEFAULT_ATLAS_PADDING);
+
+    AssetCache(const AssetCache &) = delete;
+    AssetCache &operator=(const AssetCache &) = delete;
+
+    // waits for the pending decodes
+    ~AssetCache();
+
+    // must be set before the first load
+    void setDecoder(ImageDecoder decoder) { mDecoder = std::move(decoder); }
+
+    // the texture at path, decoding it unless a handle to it is still alive
+    TextureHandle load(const std::string &path);
+
+    // a texture built from pixels in memory, ready at once. nullptr when a texture by that name is alive, or
+    // when the image is empty
+    TextureHandle insert(const std::string &name, Image image);
+
+    // blocks until every load so far has finished, running decodes on the calling thread meanwhile
+    void wait();
+
+    // packs every decoded texture not packed yet, returns the number of textures packed.
+    // Textures still loading are left for a later call
+    size_t buildAtlas();
+
+    const std::vector<AtlasPage> &getPages() const { return mPages; }
+
+    // number of live textures
+    size_t size() const;
+
+#if defined(ECS_WITH_SFML)
+    // brings textures[page] in line with every page that changed since the last call, growing textures as needed
+    void uploadAtlas(std::vector<sf::Texture> &textures);
+#endif
+
+private:
+    // decodes into the asset and publishes its state
+    void decode(const std::shared_ptr<TextureAsset> &asset);
+
+    // copies the asset's pixels into a page and frees them
+    void pack(TextureAsset &asset);
+
+    ThreadPool *mPool;
+    TaskGroup mLoads;
+    ImageDecoder mDecoder;
+
+    std::uint32_t mPageSize;
+    std::uint32_t mPadding;
+    std::vector<AtlasPage> mPages;
+    // the shared pages new images are tried against, oldest first
+    std::vector<std::uint32_t> mOpenPages;
+    // version of every page at the last upload
+    std::vector<std::uint64_t> mUploadedVersions;
+
+    // by path, the entries of freed textures are pruned by buildAtlas
+    std::unordered_map<std::string, std::weak_ptr<TextureAsset>> mAssets;
+
+    // scratch space of buildAtlas
+    std::vector<std::shared_ptr<TextureAsset>> mToPack;
+};
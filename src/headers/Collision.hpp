@@ -0,0 +1,207 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "Entity.hpp"
+#include "EntitySet.hpp"
+#include "Game.hpp"
+#include "System.hpp"
+#include "Transform.hpp"
+
+// side of a SpatialHashGrid cell when none is given, about the size of a sprite
+const float DEFAULT_COLLISION_CELL_SIZE = 64.0f;
+
+// axis aligned box centered on the entity's Position
+struct Collider
+{
+    float halfWidth;
+    float halfHeight;
+};
+
+struct Aabb
+{
+    float minX;
+    float minY;
+    float maxX;
+    float maxY;
+};
+
+inline bool overlaps(const Aabb &first, const Aabb &second)
+{
+    return first.minX <= second.maxX && second.minX <= first.maxX &&
+           first.minY <= second.maxY && second.minY <= first.maxY;
+}
+
+// two entities whose boxes overlap
+struct CollisionPair
+{
+    Entity first;
+    Entity second;
+};
+
+/** a uniform grid of square cells, only the cells holding a body exist (hashed by coordinate).
+ * - a body is listed in every cell its box covers, and is only re-bucketed when that cell range changes
+ * - the occupied cells are also kept in a dense list, so collectPairs never visits an empty one
+ * - an emptied cell is unhashed and goes to a free list with its list's capacity, the next new cell reuses
+ *   it, so a world that stays about as spread out stops growing
+ * - a pair / query hit spanning several cells is only reported by the first cell both cover,
+ *   so there is no need to dedupe the results
+ * Cells, their lists and the bodies are allocated from the given resource */
+class SpatialHashGrid
+{
+public:
+    explicit SpatialHashGrid(float cellSize = DEFAULT_COLLISION_CELL_SIZE,
+                             std::pmr::memory_resource *resource = std::pmr::get_default_resource());
+
+    // inserts the entity, or moves it if it is already in the grid
+    void update(Entity entity, const Aabb &box);
+
+    void remove(Entity entity);
+
+    bool contains(Entity entity) const { return mBodies.contains(entity); }
+
+    size_t size() const { return mBodies.size(); }
+
+    Entity entityAt(size_t index) const { return mBodies[index]; }
+
+    // replaces the contents of out with every pair of overlapping bodies
+    void collectPairs(std::vector<CollisionPair> &out);
+
+    // appends every body whose box overlaps the given one to out
+    void queryAabb(const Aabb &box, std::vector<Entity> &out) const;
+
+    // appends every body whose box overlaps the circle to out
+    void queryRadius(float x, float y, float radius, std::vector<Entity> &out) const;
+
+    float getCellSize() const { return mCellSize; }
+
+    // number of cells holding at least one body
+    size_t getCellCount() const { return mOccupiedCells.size(); }
+
+private:
+    // inclusive range of cell coordinates covered by a box
+    struct CellRange
+    {
+        std::int32_t minX;
+        std::int32_t minY;
+        std::int32_t maxX;
+        std::int32_t maxY;
+
+        bool operator==(const CellRange &other) const
+        {
+            return minX == other.minX && minY == other.minY && maxX == other.maxX && maxY == other.maxY;
+        }
+    };
+
+    struct Body
+    {
+        Aabb box;
+        CellRange range;
+    };
+
+    // what the pair test needs of a body, copied out of mBodyData
+    struct CellEntry
+    {
+        Aabb box;
+        std::int32_t minCellX;
+        std::int32_t minCellY;
+        Entity entity;
+    };
+
+    struct Cell
+    {
+        std::int32_t x;
+        std::int32_t y;
+        // positions of the bodies in mBodies / mBodyData
+        ResourceVector<std::uint32_t> bodies;
+        // position in mOccupiedCells, meaningless while the cell is empty
+        std::uint32_t occupiedIndex;
+    };
+
+    CellRange cellRangeOf(const Aabb &box) const;
+
+    static std::uint64_t cellKey(std::int32_t x, std::int32_t y)
+    {
+        return static_cast<std::uint64_t>(static_cast<std::uint32_t>(x)) << 32 | static_cast<std::uint32_t>(y);
+    }
+
+    // nullptr when no body is in the cell
+    const Cell *findCell(std::int32_t x, std::int32_t y) const;
+
+    // the index of the cell in mCells, taken from the free cells if the cell does not exist
+    std::uint32_t getOrCreateCell(std::int32_t x, std::int32_t y);
+
+    void addToCells(std::uint32_t body, const CellRange &range);
+
+    void removeFromCells(std::uint32_t body, const CellRange &range);
+
+    // rewrites the body's position in every cell it is listed in
+    void renameInCells(std::uint32_t from, std::uint32_t to, const CellRange &range);
+
+    template <typename Hit>
+    void visitAabb(const Aabb &box, Hit &&hit) const;
+
+    float mCellSize;
+    float mInverseCellSize;
+
+    // the bodies in the grid, mBodyData runs parallel to the set's dense array
+    EntitySet mBodies;
+    ResourceVector<Body> mBodyData;
+
+    using CellIndexMap = std::unordered_map<std::uint64_t, std::uint32_t, std::hash<std::uint64_t>,
+                                            std::equal_to<std::uint64_t>,
+                                            ResourceAllocator<std::pair<const std::uint64_t, std::uint32_t>>>;
+
+    // every cell ever created, the occupied ones and the free ones
+    ResourceVector<Cell> mCells;
+    // indices of the cells holding a body, in no particular order
+    ResourceVector<std::uint32_t> mOccupiedCells;
+    CellIndexMap mCellIndices;
+    // the map nodes of the emptied cells, mapping to the cell to reuse: rehashed under a new key rather than
+    // freed, so a body crossing into an empty cell and out again allocates nothing
+    ResourceVector<CellIndexMap::node_type> mFreeCells;
+
+    // bodies of the cell collectPairs is working on, kept to avoid reallocating
+    ResourceVector<CellEntry> mCellScratch;
+};
+
+/** broadphase over every entity owning a Position and a Collider.
+ * Each update brings the grid in line with the world (moved bodies are re-bucketed, removed ones
+ * dropped) and refills the pair buffer, which keeps its capacity from one frame to the next.
+ * When change tracking is on for both Position and Collider (see Game::TrackChanges) only the bodies
+ * changed since the previous update are re-bucketed, which needs whoever moves them to record it.
+ * It does not declare its component access, so it runs alone and keeps its registration order:
+ * register it before the systems reading its pairs */
+class CollisionSystem : public System
+{
+public:
+    // sets the system's signature, must be called once the system and both components are registered.
+    // The grid is allocated from the world's memory
+    void init(Game &game, float cellSize = DEFAULT_COLLISION_CELL_SIZE);
+
+    void update() override;
+
+    // pairs of overlapping entities found by the last update
+    const std::vector<CollisionPair> &getPairs() const { return mPairs; }
+
+    // entities whose box overlaps the given one, as of the last update. out is overwritten
+    void queryAabb(const Aabb &box, std::vector<Entity> &out) const;
+
+    // entities whose box overlaps the circle, as of the last update. out is overwritten
+    void queryRadius(float x, float y, float radius, std::vector<Entity> &out) const;
+
+    const SpatialHashGrid &getGrid() const { return mGrid; }
+
+private:
+    Game *mGame{};
+
+    SpatialHashGrid mGrid;
+
+    std::vector<CollisionPair> mPairs;
+
+    // change tick of the previous update, everything counts as changed before the first one
+    std::uint32_t mLastChangeTick{NO_CHANGE_TICK};
+};
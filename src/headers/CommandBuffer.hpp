@@ -0,0 +1,188 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <new>
+#include <utility>
+#include <vector>
+
+#include "Component.hpp"
+#include "Entity.hpp"
+#include "Memory.hpp"
+
+// size of one block of a CommandBuffer's payload arena, larger components get a block of their own
+const size_t COMMAND_PAYLOAD_BLOCK_BYTES = 16 * 1024;
+
+// an entity a CommandBuffer will create when it is played back,
+// it can be the target of the later commands recorded into the same buffer
+struct PendingEntity
+{
+    std::uint32_t index;
+};
+
+/** Records structural changes (create / destroy / attach / detach) instead of applying them,
+ * so they can be issued while systems iterate pools or run on several threads.
+ * Game::FlushCommands plays every buffer back at a sync point: entities are created first,
+ * then attaches and detaches grouped by component type (so each pool is visited in one go),
+ * then destructions. Every entity's system membership is updated once for the whole batch.
+ * Attaching a component the entity already has, at playback time, assigns over it: of several attaches of
+ * the same component to one entity, across buffers or not, the last one wins: buffers play back in the order
+ * their threads first asked for one, each in recording order.
+ * A buffer is meant to be used by a single thread, see Game::GetCommandBuffer */
+class CommandBuffer
+{
+public:
+    enum class CommandType : std::uint8_t
+    {
+        Attach,
+        Detach,
+        Destroy
+    };
+
+    struct Command
+    {
+        CommandType type;
+        // whether target indexes the buffer's pending entities instead of being an Entity
+        bool pending;
+        ComponentTypeBitPosition bit;
+        Entity target;
+        // the component to attach, lives in the buffer's payload blocks
+        void *payload;
+        // moves the payload into the component pool and destroys the payload. With replace the entity
+        // already owns the component, which is assigned over and recorded as changed
+        void (*attach)(ComponentManager &manager, Entity entity, void *payload, bool replace);
+        void (*detach)(ComponentManager &manager, Entity entity);
+        void (*destroyPayload)(void *payload);
+    };
+
+    // the commands and the payload blocks are allocated from the resource
+    explicit CommandBuffer(ComponentManager &manager,
+                           std::pmr::memory_resource *resource = std::pmr::get_default_resource())
+        : mComponentManager(&manager), mResource(resource), mCommands(resource), mPayloadBlocks(resource)
+    {
+    }
+
+    CommandBuffer(const CommandBuffer &) = delete;
+    CommandBuffer &operator=(const CommandBuffer &) = delete;
+
+    ~CommandBuffer();
+
+    PendingEntity createEntity()
+    {
+        return PendingEntity{mPendingCount++};
+    }
+
+    void destroyEntity(Entity entity) { record(CommandType::Destroy, false, entity, 0); }
+    void destroyEntity(PendingEntity entity) { record(CommandType::Destroy, true, entity.index, 0); }
+
+    template <typename T>
+    void attachComponent(Entity entity, T component)
+    {
+        recordAttach<T>(false, entity, std::move(component));
+    }
+
+    template <typename T>
+    void attachComponent(PendingEntity entity, T component)
+    {
+        recordAttach<T>(true, entity.index, std::move(component));
+    }
+
+    template <typename T>
+    void detachComponent(Entity entity)
+    {
+        recordDetach<T>(false, entity);
+    }
+
+    template <typename T>
+    void detachComponent(PendingEntity entity)
+    {
+        recordDetach<T>(true, entity.index);
+    }
+
+    bool empty() const { return mCommands.empty() && mPendingCount == 0; }
+
+    std::uint32_t getPendingCount() const { return mPendingCount; }
+
+    ResourceVector<Command> &getCommands() { return mCommands; }
+
+    // drops every recorded command, destroying the payloads that were not played back.
+    // The payload blocks are kept for the next frame
+    void clear();
+
+    // called by the playback once a payload has been moved into its pool
+    void markPlayedBack(Command &command) { command.destroyPayload = nullptr; }
+
+private:
+    void record(CommandType type, bool pending, Entity target, ComponentTypeBitPosition bit)
+    {
+        mCommands.push_back({type, pending, bit, target, nullptr, nullptr, nullptr, nullptr});
+    }
+
+    template <typename T>
+    void recordAttach(bool pending, Entity target, T component)
+    {
+        static_assert(alignof(T) <= alignof(std::max_align_t), "Component is over-aligned for a command buffer");
+
+        void *payload = allocatePayload(sizeof(T), alignof(T));
+        new (payload) T(std::move(component));
+
+        record(CommandType::Attach, pending, target, mComponentManager->GetComponentType<T>());
+        Command &command = mCommands.back();
+        command.payload = payload;
+        command.attach = [](ComponentManager &manager, Entity entity, void *payload, bool replace)
+        {
+            T *component = static_cast<T *>(payload);
+            if (replace)
+            {
+                manager.GetComponent<T>(entity) = std::move(*component);
+                if (ComponentArray<T> *pool = manager.GetComponentArray<T>())
+                {
+                    pool->markChanged(entity);
+                }
+            }
+            else
+            {
+                manager.AttachComponent<T>(entity, std::move(*component));
+            }
+            component->~T();
+        };
+        command.destroyPayload = [](void *payload)
+        { static_cast<T *>(payload)->~T(); };
+    }
+
+    template <typename T>
+    void recordDetach(bool pending, Entity target)
+    {
+        record(CommandType::Detach, pending, target, mComponentManager->GetComponentType<T>());
+        mCommands.back().detach = [](ComponentManager &manager, Entity entity)
+        { manager.DetachComponent<T>(entity); };
+    }
+
+    // bump-allocates from the payload blocks, a payload never moves once constructed
+    void *allocatePayload(size_t size, size_t alignment);
+
+    // allocated from mResource, released with the buffer
+    struct PayloadBlock
+    {
+        std::byte *bytes;
+        size_t capacity;
+    };
+
+    ComponentManager *mComponentManager;
+
+    std::pmr::memory_resource *mResource;
+
+    ResourceVector<Command> mCommands;
+
+    // components waiting to be attached, constructed in place
+    ResourceVector<PayloadBlock> mPayloadBlocks;
+
+    // block currently bump-allocated from, and the offset of its first free byte
+    size_t mCurrentBlock{};
+    size_t mCurrentOffset{};
+
+    std::uint32_t mPendingCount{};
+};
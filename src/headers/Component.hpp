@@ -1,18 +1,25 @@
 #pragma once
 
-#include <bitset>
+#include <algorithm>
+#include <atomic>
 #include <cassert>
-#include <typeindex>
-#include <typeinfo>
-#include <unordered_map>
+#include <cstdint>
+#include <cstring>
 #include <memory>
-
-// This represents the bit position in "Signature" that a given component type has been assigned to
-using ComponentTypeBitPosition = std::uint8_t;
-const ComponentTypeBitPosition MAX_COMPONENTS = 32;
-
-// basically a wasy to store the components by its name
-using ComponentTypeID = std::type_index;
+#include <new>
+#include <numeric>
+#include <ostream>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "Archetype.hpp"
+#include "Entity.hpp"
+#include "EntitySet.hpp"
+#include "Memory.hpp"
+#include "Events.hpp"
+#include "ThreadPool.hpp"
+#include "TypeIndex.hpp"
 
 /**A virtual base class for the sole purpose of using polymorphism
  * when storing component arrays and allow update
@@ -21,79 +28,608 @@ class IComponentArray
 {
 public:
     virtual ~IComponentArray() = default;
-    virtual void handleDestroyedEntity(Entity entity) = 0;
+
+    // detaches the component of every listed entity, which must all own one. One call per pool for a batch
+    virtual void detachEntities(const Entity *entities, size_t count) = 0;
+
+    // pages, entity set and ticks: reserved counts every allocated page, used the live components
+    virtual MemoryUsage getMemoryUsage() const = 0;
+
+    // exchanges the components (and their entities) stored at two positions of the packed array
+    virtual void swapPositions(size_t first, size_t second) = 0;
+
+    // what a snapshot (see Snapshot.hpp) needs to know of the pool without knowing its type
+    virtual std::uint64_t getTypeHash() const = 0;
+    virtual size_t getComponentSize() const = 0;
+    virtual bool isTriviallyCopyable() const = 0;
+    virtual const EntitySet &getPackedEntities() const = 0;
+
+    // writes the packed components back to back, one write per page. Trivially copyable types only
+    virtual void writePackedComponents(std::ostream &out) const = 0;
+
+    // replaces the contents of the pool with count components laid out back to back and the entities
+    // owning them, one memcpy per page. Only an empty pool can be assigned to a non trivially copyable type
+    virtual void assignPacked(const Entity *entities, const void *components, size_t count) = 0;
+};
+
+/** the bookkeeping of an owning group (see OwningGroup in Group.hpp): the pools it owns, and how many
+ * entities own a component in every one of them. Those entities sit at positions [0, size) of each owned
+ * pool, in the same order, so the pools can be walked in lockstep. Every owned pool reports its attaches
+ * and detaches here and the group swaps the entity in or out of that leading range, in every pool.
+ * A pool belongs to one group at most */
+class PoolGroup
+{
+public:
+    PoolGroup(std::vector<IComponentArray *> pools, const Signature &owned)
+        : mPools(std::move(pools)), mOwned(owned)
+    {
+    }
+
+    PoolGroup(const PoolGroup &) = delete;
+    PoolGroup &operator=(const PoolGroup &) = delete;
+
+    // number of entities owning every component of the group
+    size_t size() const { return mSize; }
+
+    // bit positions of the owned component types
+    const Signature &getOwned() const { return mOwned; }
+
+    // an owned pool just appended a component of the entity
+    void handleAttached(Entity entity)
+    {
+        if (ownsAll(entity))
+        {
+            moveTo(entity, mSize++);
+        }
+    }
+
+    // an owned pool is about to remove the entity's component: leaving the group first moves it right
+    // past the range, so the pool's swap-and-pop only ever fills the hole with an entity outside the group
+    void handleDetaching(Entity entity)
+    {
+        if (ownsAll(entity))
+        {
+            moveTo(entity, --mSize);
+        }
+    }
+
+    // regathers the range from scratch, after an owned pool was replaced wholesale
+    void rebuild()
+    {
+        mSize = 0;
+        IComponentArray *smallest = mPools.front();
+        for (IComponentArray *pool : mPools)
+        {
+            if (pool->getPackedEntities().size() < smallest->getPackedEntities().size())
+            {
+                smallest = pool;
+            }
+        }
+
+        // moving an entity to mSize only ever swaps it with one already visited
+        const EntitySet &entities = smallest->getPackedEntities();
+        for (size_t index = 0; index < entities.size(); ++index)
+        {
+            if (ownsAll(entities[index]))
+            {
+                moveTo(entities[index], mSize++);
+            }
+        }
+    }
+
+    // exchanges two positions of the range in every owned pool, so the range stays lined up
+    void swapPositions(size_t first, size_t second)
+    {
+        assert(first < mSize && second < mSize && "Position outside of the group");
+        for (IComponentArray *pool : mPools)
+        {
+            pool->swapPositions(first, second);
+        }
+    }
+
+private:
+    bool ownsAll(Entity entity) const
+    {
+        for (const IComponentArray *pool : mPools)
+        {
+            if (!pool->getPackedEntities().contains(entity))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void moveTo(Entity entity, size_t position)
+    {
+        for (IComponentArray *pool : mPools)
+        {
+            size_t current = pool->getPackedEntities().index(entity);
+            if (current != position)
+            {
+                pool->swapPositions(current, position);
+            }
+        }
+    }
+
+    std::vector<IComponentArray *> mPools;
+    Signature mOwned;
+    size_t mSize{};
 };
 
+// number of components held by one page of a ComponentArray's packed storage
+const size_t COMPONENT_PAGE_SIZE = 1024;
+
+// pages are aligned to this so ranges handed to different threads never share a cache line
+const size_t CACHE_LINE_SIZE = 64;
+
+// tick of a component that has never been stamped, older than any change
+const std::uint32_t NO_CHANGE_TICK = 0;
+
+// default number of components per task of the parallel iterations
+const size_t DEFAULT_GRAIN_SIZE = 4096;
+
+// smallest number of consecutive T whose size is a multiple of a cache line,
+// splitting a page at multiples of it keeps every range on its own cache lines
+template <typename T>
+constexpr size_t cacheLineGranularity()
+{
+    return CACHE_LINE_SIZE / std::gcd(CACHE_LINE_SIZE, sizeof(T));
+}
+
+// rounds a requested grain size up to a multiple of the cache line granularity of T
+template <typename T>
+size_t alignGrainSize(size_t grainSize)
+{
+    size_t granularity = cacheLineGranularity<T>();
+    return (grainSize + granularity - 1) / granularity * granularity;
+}
+
 /** A packed array that maps all component of a given type to the entity that owns it
  * and allows for fast attachment and detachment of components
- * when entity is deleted or created*/
+ * when entity is deleted or created.
+ *
+ * The owning entities are kept in an EntitySet (sparse set), and the component at position i
+ * of the packed storage belongs to the entity at position i of the set, so every lookup is a
+ * single indexed load. The packed components live in fixed-size pages that are only allocated
+ * once they are needed, so a rarely used component type costs next to nothing.
+ * A component never moves while it stays inside its page, hence pointers to it remain
+ * valid until it is detached or swapped into a hole left by a detach.
+ *
+ * Change tracking is off unless enabled (see ComponentManager::enableChangeTracking). Once on, every
+ * component carries the world tick it was attached at and the tick of its last recorded change, in two
+ * arrays parallel to the packed one. Writes through a T& are not seen: they are recorded by markChanged.
+ *
+ * A pool owned by a group (see PoolGroup) keeps the group's entities at its front, attach and detach
+ * move them in and out of that range */
 template <typename T>
 class ComponentArray : public IComponentArray
 {
 
 public:
+    // marks an entity that does not own this component
+    static constexpr size_t INVALID_INDEX = EntitySet::INVALID_INDEX;
+
+    // pages, entities and ticks are allocated from the resource
+    explicit ComponentArray(std::pmr::memory_resource *resource = std::pmr::get_default_resource())
+        : mResource(resource), mComponentPages(resource), mEntities(resource), mAddedTicks(resource),
+          mChangedTicks(resource), mSortOrder(resource)
+    {
+    }
+
+    ComponentArray(const ComponentArray &) = delete;
+    ComponentArray &operator=(const ComponentArray &) = delete;
+
+    ~ComponentArray() override
+    {
+        for (size_t index = 0; index < size(); ++index)
+        {
+            componentAt(index).~T();
+        }
+        for (T *page : mComponentPages)
+        {
+            deallocatePage(page);
+        }
+    }
+
     void attachComponent(Entity entity, T component)
     {
-        assert(mEntityToComponentIndex.count(entity) == 0 && "Component to add already existed on Entity");
-        size_t index = mSize;
+        assert(!hasComponent(entity) && "Component to add already existed on Entity");
+        size_t index = size();
+
+        if (index / COMPONENT_PAGE_SIZE == mComponentPages.size())
+        {
+            mComponentPages.push_back(allocatePage());
+        }
+
+        new (&componentAt(index)) T(std::move(component));
 
-        mEntityToComponentIndex[entity] = index;
-        mComponentIndexToEntity[index] = entity;
+        mEntities.insert(entity);
+        ++mLayoutVersion;
+
+        if (mEvents)
+        {
+            mEvents->recordAttached(entity);
+        }
 
-        mComponentArray[index] = component;
+        if (mChangeTick)
+        {
+            std::uint32_t tick = currentTick();
+            mAddedTicks.push_back(tick);
+            mChangedTicks.push_back(tick);
+        }
 
-        ++mSize;
+        // last, the group swaps the component and its ticks together
+        if (mGroup)
+        {
+            mGroup->handleAttached(entity);
+        }
     }
 
     void detachComponent(Entity entity)
     {
-        assert(mEntityToComponentIndex.count(entity) > 0 && "Component to remove does not exist on Entity.");
+        assert(hasComponent(entity) && "Component to remove does not exist on Entity.");
+
+        if (mGroup)
+        {
+            mGroup->handleDetaching(entity);
+        }
 
         // getting the index that corrresponds to the component's index of the deleted entity
-        size_t deletedEntityComponentIndex = mEntityToComponentIndex[entity];
+        size_t deletedEntityComponentIndex = mEntities.index(entity);
+
+        if (mEvents)
+        {
+            mEvents->recordDetached(entity, componentAt(deletedEntityComponentIndex));
+        }
 
-        size_t lastComponentIndex = mSize - 1;
-        // Copy element at end into deleted element's place to maintain density
-        mComponentArray[deletedEntityComponentIndex] = mComponentArray[lastComponentIndex];
+        size_t lastComponentIndex = size() - 1;
+        // Move element at end into deleted element's place to maintain density
+        if (deletedEntityComponentIndex != lastComponentIndex)
+        {
+            componentAt(deletedEntityComponentIndex) = std::move(componentAt(lastComponentIndex));
+        }
+        componentAt(lastComponentIndex).~T();
 
-        // resetting the mapping to the deleted entity's spot
-        Entity lastComponentEntity = mComponentIndexToEntity[lastComponentIndex];
-        mEntityToComponentIndex[lastComponentEntity] = deletedEntityComponentIndex;
-        mComponentIndexToEntity[deletedEntityComponentIndex] = lastComponentEntity;
+        // the set performs the same swap-and-pop on the entities
+        mEntities.erase(entity);
+        ++mLayoutVersion;
 
-        mEntityToComponentIndex.erase(entity);
-        mComponentIndexToEntity.erase(lastComponentIndex);
+        if (mChangeTick)
+        {
+            mAddedTicks[deletedEntityComponentIndex] = mAddedTicks.back();
+            mAddedTicks.pop_back();
+            mChangedTicks[deletedEntityComponentIndex] = mChangedTicks.back();
+            mChangedTicks.pop_back();
+        }
 
-        --mSize;
+        // keep one empty page around as slack so attach/detach at a page boundary does not thrash
+        if (mComponentPages.size() * COMPONENT_PAGE_SIZE >= size() + 2 * COMPONENT_PAGE_SIZE)
+        {
+            deallocatePage(mComponentPages.back());
+            mComponentPages.pop_back();
+        }
     }
 
     // returns the Component for the given entity if it exists, error will be thrown if not
     T &getComponent(Entity entity)
     {
-        assert(mEntityToComponentIndex.count(entity) > 0 && "Component to get does not exist on entity");
-        return mComponentArray[mEntityToComponentIndex[entity]];
+        assert(hasComponent(entity) && "Component to get does not exist on entity");
+        return componentAt(mEntities.index(entity));
+    }
+
+    bool hasComponent(Entity entity) const
+    {
+        return mEntities.contains(entity);
+    }
+
+    // returns the Component for the given entity, or nullptr when the entity does not own one
+    // a single sparse lookup, used when joining several pools
+    T *tryGetComponent(Entity entity)
+    {
+        size_t index = mEntities.find(entity);
+        return index != INVALID_INDEX ? &componentAt(index) : nullptr;
+    }
+
+    size_t size() const { return mEntities.size(); }
+
+    // the component stored at the given position of the packed array
+    T &componentAt(size_t index)
+    {
+        return mComponentPages[index / COMPONENT_PAGE_SIZE][index % COMPONENT_PAGE_SIZE];
+    }
+
+    // the entity owning the component stored at the given position of the packed array
+    Entity entityAt(size_t index) const { return mEntities[index]; }
+
+    const EntitySet &getEntities() const { return mEntities; }
+
+    // exchanges the components (and their entities) stored at two positions of the packed array.
+    // The front of a pool owned by a group is the group's: reorder it through the group or sort
+    void swapPositions(size_t first, size_t second) override
+    {
+        using std::swap;
+        swap(componentAt(first), componentAt(second));
+        mEntities.swapPositions(first, second);
+        ++mLayoutVersion;
+
+        if (mChangeTick)
+        {
+            swap(mAddedTicks[first], mAddedTicks[second]);
+            swap(mChangedTicks[first], mChangedTicks[second]);
+        }
+    }
+
+    /** reorders the packed array so that compare(const T&, const T&) holds between neighbours, e.g. by
+     * spatial cell or depth. Not stable. When the pool is owned by a group, the group's range is sorted on
+     * its own and every other owned pool follows, so the range stays lined up; the rest of the pool is
+     * sorted after it. Ticks follow their component */
+    template <typename Compare>
+    void sort(Compare compare)
+    {
+        size_t groupSize = mGroup ? mGroup->size() : 0;
+        sortRange(0, groupSize, compare, mGroup);
+        sortRange(groupSize, size(), compare, nullptr);
+    }
+
+    // the group owning this pool, nullptr when there is none
+    PoolGroup *getGroup() const { return mGroup; }
+
+    // hands the pool to a group, see ComponentManager::getGroup. Only once
+    void setGroup(PoolGroup *group)
+    {
+        assert(!mGroup && "Component type already owned by a group");
+        mGroup = group;
+    }
+
+    // bumped whenever the packed array changes shape (attach, detach, swap), so whoever arranged
+    // it in a particular order can tell whether it still is
+    std::uint64_t getLayoutVersion() const { return mLayoutVersion; }
+
+    // starts stamping the components with the given world tick, the ones already there count as
+    // attached and changed now. Meant to be called once, through ComponentManager::enableChangeTracking
+    void enableChangeTracking(const std::atomic<std::uint32_t> &tick)
+    {
+        mChangeTick = &tick;
+        mAddedTicks.assign(size(), currentTick());
+        mChangedTicks.assign(size(), currentTick());
+    }
+
+    bool isChangeTracked() const { return mChangeTick != nullptr; }
+
+    // records a change of the entity's component at the current tick, nothing when tracking is off
+    void markChanged(Entity entity)
+    {
+        assert(hasComponent(entity) && "Component to mark does not exist on entity");
+        if (mChangeTick)
+        {
+            mChangedTicks[mEntities.index(entity)] = currentTick();
+        }
+    }
+
+    // same for the components at positions [begin, end) of the packed array, e.g. after a kernel wrote them
+    void markChangedRange(size_t begin, size_t end)
+    {
+        if (mChangeTick)
+        {
+            std::fill(mChangedTicks.begin() + begin, mChangedTicks.begin() + end, currentTick());
+        }
+    }
+
+    // ticks of the component at the given position of the packed array, only valid while tracking is on
+    std::uint32_t addedTickAt(size_t index) const { return mAddedTicks[index]; }
+
+    std::uint32_t changedTickAt(size_t index) const { return mChangedTicks[index]; }
+
+    // both arrays of ticks, parallel to the packed array. Empty while tracking is off
+    const ResourceVector<std::uint32_t> &getAddedTicks() const { return mAddedTicks; }
+
+    const ResourceVector<std::uint32_t> &getChangedTicks() const { return mChangedTicks; }
+
+    // allocates every page needed to hold capacity components without further allocation
+    void reserve(size_t capacity)
+    {
+        while (mComponentPages.size() * COMPONENT_PAGE_SIZE < capacity)
+        {
+            mComponentPages.push_back(allocatePage());
+        }
+        mEntities.reserve(capacity);
+        if (mChangeTick)
+        {
+            mAddedTicks.reserve(capacity);
+            mChangedTicks.reserve(capacity);
+        }
+    }
+
+    // releases every page that no longer holds a live component
+    void shrinkToFit()
+    {
+        while (mComponentPages.size() * COMPONENT_PAGE_SIZE >= size() + COMPONENT_PAGE_SIZE)
+        {
+            deallocatePage(mComponentPages.back());
+            mComponentPages.pop_back();
+        }
+        mEntities.shrinkToFit();
+    }
+
+    // invokes func(entity, T&) for every component, splitting the packed array into ranges of about
+    // grainSize components run across the pool. Range boundaries fall on cache line boundaries
+    template <typename Func>
+    void parallelEach(ThreadPool &pool, Func &&func, size_t grainSize = DEFAULT_GRAIN_SIZE)
+    {
+        pool.parallelFor(0, size(), alignGrainSize<T>(grainSize), [this, &func](size_t begin, size_t end)
+                         {
+                             for (size_t index = begin; index < end; ++index)
+                             {
+                                 func(entityAt(index), componentAt(index));
+                             } });
+    }
+
+    void detachEntities(const Entity *entities, size_t count) override
+    {
+        for (size_t index = 0; index < count; ++index)
+        {
+            detachComponent(entities[index]);
+        }
+    }
+
+    MemoryUsage getMemoryUsage() const override
+    {
+        MemoryUsage entities = mEntities.getMemoryUsage();
+        size_t tickBytes = 2 * sizeof(std::uint32_t);
+        return {entities.reservedBytes + mComponentPages.size() * COMPONENT_PAGE_SIZE * sizeof(T) +
+                    mComponentPages.capacity() * sizeof(T *) + mAddedTicks.capacity() * tickBytes,
+                entities.usedBytes + size() * (sizeof(T) + (mChangeTick ? tickBytes : 0))};
+    }
+
+    // starts feeding the queue with the pool's attach and detach events, see ComponentManager::getEventQueue
+    void setEventQueue(ComponentEventQueue<T> *events) { mEvents = events; }
+
+    std::uint64_t getTypeHash() const override { return typeNameHash<T>(); }
+
+    size_t getComponentSize() const override { return sizeof(T); }
+
+    bool isTriviallyCopyable() const override { return std::is_trivially_copyable_v<T>; }
+
+    const EntitySet &getPackedEntities() const override { return mEntities; }
+
+    void writePackedComponents(std::ostream &out) const override
+    {
+        if constexpr (std::is_trivially_copyable_v<T>)
+        {
+            for (size_t begin = 0; begin < size(); begin += COMPONENT_PAGE_SIZE)
+            {
+                size_t count = std::min(COMPONENT_PAGE_SIZE, size() - begin);
+                out.write(reinterpret_cast<const char *>(mComponentPages[begin / COMPONENT_PAGE_SIZE]),
+                          static_cast<std::streamsize>(count * sizeof(T)));
+            }
+        }
+        else
+        {
+            assert(size() == 0 && "Only trivially copyable components can be written as bytes");
+        }
     }
 
-    // a common interface that can be invoked by managerial level classes
-    void handleDestroyedEntity(Entity entity) override
+    void assignPacked(const Entity *entities, const void *components, size_t count) override
     {
-        if (mEntityToComponentIndex.count(entity) > 0)
+        for (size_t index = 0; index < size(); ++index)
+        {
+            componentAt(index).~T();
+        }
+        mEntities.assign(entities, count);
+        ++mLayoutVersion;
+        if (mChangeTick)
+        {
+            // the whole pool was replaced, every component counts as new
+            mAddedTicks.assign(count, currentTick());
+            mChangedTicks.assign(count, currentTick());
+        }
+
+        reserve(count);
+        if constexpr (std::is_trivially_copyable_v<T>)
+        {
+            for (size_t begin = 0; begin < count; begin += COMPONENT_PAGE_SIZE)
+            {
+                std::memcpy(mComponentPages[begin / COMPONENT_PAGE_SIZE], static_cast<const T *>(components) + begin,
+                            std::min(COMPONENT_PAGE_SIZE, count - begin) * sizeof(T));
+            }
+        }
+        else
+        {
+            assert(count == 0 && "Only trivially copyable components can be assigned from bytes");
+        }
+
+        if (mGroup)
         {
-            detachComponent(entity);
+            mGroup->rebuild();
         }
     }
 
 private:
-    // the actual 'thing' that stores the Components
-    std::array<T, MAX_ENTITIES> mComponentArray;
+    static constexpr std::align_val_t PAGE_ALIGNMENT{alignof(T) > CACHE_LINE_SIZE ? alignof(T) : CACHE_LINE_SIZE};
+
+    T *allocatePage()
+    {
+        return static_cast<T *>(mResource->allocate(sizeof(T) * COMPONENT_PAGE_SIZE, static_cast<size_t>(PAGE_ALIGNMENT)));
+    }
+
+    void deallocatePage(T *page)
+    {
+        mResource->deallocate(page, sizeof(T) * COMPONENT_PAGE_SIZE, static_cast<size_t>(PAGE_ALIGNMENT));
+    }
+
+    std::uint32_t currentTick() const { return mChangeTick->load(std::memory_order_relaxed); }
+
+    // sorts positions [begin, end), then walks the permutation's cycles swapping components into place.
+    // With a group every swap goes through it, so all the owned pools are permuted alike
+    template <typename Compare>
+    void sortRange(size_t begin, size_t end, Compare &compare, PoolGroup *group)
+    {
+        if (end - begin < 2)
+        {
+            return;
+        }
+
+        mSortOrder.resize(end - begin);
+        std::iota(mSortOrder.begin(), mSortOrder.end(), begin);
+        std::sort(mSortOrder.begin(), mSortOrder.end(), [this, &compare](size_t first, size_t second)
+                  { return compare(std::as_const(componentAt(first)), std::as_const(componentAt(second))); });
+
+        // position begin + i must receive the component now at mSortOrder[i]
+        for (size_t position = begin; position < end; ++position)
+        {
+            size_t current = position;
+            size_t next = mSortOrder[current - begin];
+            while (next != position)
+            {
+                if (group)
+                {
+                    group->swapPositions(current, next);
+                }
+                else
+                {
+                    swapPositions(current, next);
+                }
+                mSortOrder[current - begin] = current;
+                current = next;
+                next = mSortOrder[current - begin];
+            }
+            mSortOrder[current - begin] = current;
+        }
+    }
+
+    std::pmr::memory_resource *mResource;
+
+    // the actual 'thing' that stores the Components, split into pages of COMPONENT_PAGE_SIZE
+    ResourceVector<T *> mComponentPages;
+
+    // the entities owning a component, in the same order as the packed components
+    EntitySet mEntities;
 
-    // a to-and-fro reference between the entity and the component's index in the array
-    std::unordered_map<Entity, size_t> mEntityToComponentIndex;
+    std::uint64_t mLayoutVersion{};
 
-    // a to-and-fro reference between the component's index and the entity in the array
-    std::unordered_map<size_t, Entity> mComponentIndexToEntity;
+    // the world tick when tracking is on, nullptr otherwise
+    const std::atomic<std::uint32_t> *mChangeTick{};
+    ResourceVector<std::uint32_t> mAddedTicks;
+    ResourceVector<std::uint32_t> mChangedTicks;
 
-    size_t mSize;
+    // where attach and detach events go once someone observes them, nullptr otherwise
+    ComponentEventQueue<T> *mEvents{};
+
+    // the group owning the pool, nullptr otherwise
+    PoolGroup *mGroup{};
+
+    // positions of a range being sorted, kept so sorting every frame does not allocate
+    ResourceVector<size_t> mSortOrder;
+};
+
+// selects where a world keeps its component data
+enum class StorageBackend
+{
+    // one ComponentArray (sparse set) per component type, cheap attach/detach
+    SparseSet,
+    // entities grouped by Signature into SoA chunks, cheap multi-component iteration
+    Archetype
 };
 
 /** Managerial level class that links Component and ComponentArray
@@ -101,17 +637,45 @@ private:
 class ComponentManager
 {
 public:
+    // the pools are allocated from the resource, along with everything they hold
+    explicit ComponentManager(StorageBackend backend = StorageBackend::SparseSet,
+                              std::pmr::memory_resource *resource = std::pmr::get_default_resource())
+        : mBackend(backend), mResource(resource)
+    {
+        if (mBackend == StorageBackend::Archetype)
+        {
+            mArchetypes =
+                std::allocate_shared<ArchetypeStorage>(ResourceAllocator<ArchetypeStorage>(mResource), mResource);
+        }
+    }
+
     // registering a new type of component into the ECS system
     // must be invoked to validate a Component type
     template <typename T>
     void registerComponentType()
     {
-        ComponentTypeID name = typeid(T);
+        size_t typeIndex = componentTypeIndex<T>();
+        if (typeIndex >= mComponentTypes.size())
+        {
+            mComponentTypes.resize(typeIndex + 1);
+        }
 
-        assert(mComponentIDtoBitPosition.count(name) == 0 && "Component type already exist");
+        assert(!mComponentTypes[typeIndex].registered && "Component type already exist");
+        assert(mNextComponentTypeBitPosition < MAX_COMPONENTS && "Too many component types registered");
 
-        mComponentIDtoBitPosition.insert({name, mNextComponentTypeBitPosition});
-        mComponentIDtoArrayMap.insert({name, std::make_shared<ComponentArray<T>>()});
+        ComponentTypeRecord &record = mComponentTypes[typeIndex];
+        record.bit = mNextComponentTypeBitPosition;
+        record.registered = true;
+        if (mBackend == StorageBackend::Archetype)
+        {
+            mArchetypes->registerComponentType<T>(mNextComponentTypeBitPosition);
+        }
+        else
+        {
+            mComponentArrays.push_back(
+                std::allocate_shared<ComponentArray<T>>(ResourceAllocator<ComponentArray<T>>(mResource), mResource));
+            record.array = mComponentArrays.back().get();
+        }
 
         ++mNextComponentTypeBitPosition;
     }
@@ -119,71 +683,299 @@ public:
     template <typename T>
     ComponentTypeBitPosition GetComponentType()
     {
-        ComponentTypeID name = typeid(T);
-
-        assert(mComponentIDtoBitPosition.count(name) > 0 && "Component not registered before use.");
-
         // Return this component's type - used for creating signatures
-        return mComponentIDtoBitPosition[name];
+        return getRecord<T>().bit;
     }
 
     template <typename T>
     void AttachComponent(Entity entity, T component)
     {
-        GetComponentArray<T>()->attachComponent(entity, component);
+        if (mBackend == StorageBackend::Archetype)
+        {
+            mArchetypes->attachComponent<T>(entity, GetComponentType<T>(), std::move(component));
+            return;
+        }
+        GetComponentArray<T>()->attachComponent(entity, std::move(component));
+    }
+
+    // attaches values[i]... to entities[i] for every i < count. Each pool is reserved once and
+    // filled in one pass, the archetype backend migrates every entity once for all of Ts
+    template <typename... Ts>
+    void AttachComponents(const Entity *entities, size_t count, const Ts *...values)
+    {
+        if (mBackend == StorageBackend::Archetype)
+        {
+            mArchetypes->attachComponents<Ts...>(entities, count, {GetComponentType<Ts>()...}, values...);
+            return;
+        }
+        (attachToPool<Ts>(entities, count, values), ...);
     }
 
     template <typename T>
     void DetachComponent(Entity entity)
     {
+        if (mBackend == StorageBackend::Archetype)
+        {
+            mArchetypes->detachComponent(entity, GetComponentType<T>());
+            return;
+        }
         GetComponentArray<T>()->detachComponent(entity);
     }
 
-    // a common interface to propagate changes to each ComponentArray when handling entity destruction event
-    void handleDestroyedEntity(Entity entity)
+    template <typename T>
+    T &GetComponent(Entity entity)
+    {
+        if (mBackend == StorageBackend::Archetype)
+        {
+            return mArchetypes->getComponent<T>(entity, GetComponentType<T>());
+        }
+        return GetComponentArray<T>()->getComponent(entity);
+    }
+
+    StorageBackend getBackend() const { return mBackend; }
+
+    // stamps every T with the tick it was attached at and the tick of its last recorded change, so views can
+    // filter on them (see Changed / Added in View.hpp). Requires the sparse set backend
+    template <typename T>
+    void enableChangeTracking()
+    {
+        assert(mBackend == StorageBackend::SparseSet && "Change tracking requires the sparse set backend");
+        ComponentArray<T> *pool = GetComponentArray<T>();
+        if (!pool->isChangeTracked())
+        {
+            pool->enableChangeTracking(mChangeTick);
+        }
+    }
+
+    /** the group owning the pools of Ts, created on first use: from then on the entities owning all of Ts
+     * occupy the same leading range of each of those pools. Asking again for the same Ts, in any order,
+     * returns the same group; a pool can only be owned by one group. Requires the sparse set backend */
+    template <typename... Ts>
+    PoolGroup &getGroup()
+    {
+        static_assert(sizeof...(Ts) > 0, "A group needs at least one component type");
+        assert(mBackend == StorageBackend::SparseSet && "Groups require the sparse set backend");
+
+        Signature owned;
+        (owned.set(GetComponentType<Ts>()), ...);
+        for (const std::unique_ptr<PoolGroup> &group : mGroups)
+        {
+            if (group->getOwned() == owned)
+            {
+                return *group;
+            }
+        }
+
+        std::vector<IComponentArray *> pools{GetComponentArray<Ts>()...};
+        mGroups.push_back(std::make_unique<PoolGroup>(std::move(pools), owned));
+        PoolGroup *group = mGroups.back().get();
+        (GetComponentArray<Ts>()->setGroup(group), ...);
+        group->rebuild();
+        return *group;
+    }
+
+    // reorders T's pool by compare(const T&, const T&), see ComponentArray::sort. Requires the sparse set backend
+    template <typename T, typename Compare>
+    void sortComponents(Compare compare)
+    {
+        assert(mBackend == StorageBackend::SparseSet && "Sorting requires the sparse set backend");
+        GetComponentArray<T>()->sort(std::move(compare));
+    }
+
+    // the tick changes are stamped with right now
+    std::uint32_t getChangeTick() const { return mChangeTick.load(std::memory_order_relaxed); }
+
+    // moves every later change to a newer tick and returns the tick before, see Game::AdvanceChangeTick
+    std::uint32_t advanceChangeTick() { return mChangeTick.fetch_add(1, std::memory_order_relaxed); }
+
+    // number of registered component types, they occupy the bit positions below it
+    ComponentTypeBitPosition getComponentTypeCount() const { return mNextComponentTypeBitPosition; }
+
+    // the pool of the component type at the given bit position, nullptr with the archetype backend
+    IComponentArray *getComponentArray(ComponentTypeBitPosition bit) const
+    {
+        assert(bit < mNextComponentTypeBitPosition && "No component type at this bit position");
+        return mBackend == StorageBackend::SparseSet ? mComponentArrays[bit].get() : nullptr;
+    }
+
+    // Convenience function to get the statically casted pointer to the ComponentArray of type T.
+    template <typename T>
+    ComponentArray<T> *GetComponentArray()
+    {
+        return static_cast<ComponentArray<T> *>(getRecord<T>().array);
+    }
+
+    // only valid for a world using the archetype backend
+    ArchetypeStorage &getArchetypeStorage()
+    {
+        assert(mArchetypes && "World does not use the archetype backend");
+        return *mArchetypes;
+    }
+
+    // same as handleDestroyedEntity for a batch, signatures[i] being the one entities[i] had.
+    // Each pool the batch touches is visited once, with the entities of the batch it holds
+    void handleDestroyedEntities(const Entity *entities, const Signature *signatures, size_t count)
+    {
+        if (mBackend == StorageBackend::Archetype)
+        {
+            for (size_t index = 0; index < count; ++index)
+            {
+                mArchetypes->handleDestroyedEntity(entities[index]);
+            }
+            return;
+        }
+
+        Signature owned;
+        for (size_t index = 0; index < count; ++index)
+        {
+            owned |= signatures[index];
+        }
+        forEachSetBit(owned, [&](ComponentTypeBitPosition bit)
+                      {
+            mDestroyScratch.clear();
+            for (size_t index = 0; index < count; ++index)
+            {
+                if (signatures[index].test(bit))
+                {
+                    mDestroyScratch.push_back(entities[index]);
+                }
+            }
+            mComponentArrays[bit]->detachEntities(mDestroyScratch.data(), mDestroyScratch.size()); });
+    }
+
+    // a common interface to propagate changes to each ComponentArray when handling entity destruction event.
+    // Only the pools named by the entity's signature are visited
+    void handleDestroyedEntity(Entity entity, const Signature &signature)
     {
-        // Notify each component array that an entity has been destroyed
-        // If it has a component for that entity, it will remove it
-        for (auto const &pair : mComponentIDtoArrayMap)
+        if (mBackend == StorageBackend::Archetype)
         {
-            auto const &component_array = pair.second;
+            mArchetypes->handleDestroyedEntity(entity);
+            return;
+        }
+
+        forEachSetBit(signature, [&](ComponentTypeBitPosition bit)
+                      { mComponentArrays[bit]->detachEntities(&entity, 1); });
+    }
 
-            component_array->handleDestroyedEntity(entity);
+    // appends the memory of every pool to out, nothing with the archetype backend
+    void getPoolMemory(std::vector<ComponentPoolMemory> &out) const
+    {
+        if (mBackend == StorageBackend::Archetype)
+        {
+            return;
+        }
+        for (size_t bit = 0; bit < mComponentArrays.size(); ++bit)
+        {
+            const IComponentArray &pool = *mComponentArrays[bit];
+            out.push_back({static_cast<ComponentTypeBitPosition>(bit), pool.getComponentSize(),
+                           pool.getPackedEntities().size(), pool.getMemoryUsage()});
         }
     }
 
+    // the attach / detach events of T, created and hooked to T's pool on first use.
+    // Requires the sparse set backend
     template <typename T>
-    Signature getSignature()
+    ComponentEventQueue<T> &getEventQueue()
     {
-        ComponentTypeID name = typeid(T);
+        assert(mBackend == StorageBackend::SparseSet && "Component events require the sparse set backend");
+        ComponentTypeBitPosition bit = GetComponentType<T>();
+        if (bit >= mEventQueues.size())
+        {
+            mEventQueues.resize(bit + 1);
+        }
+        if (!mEventQueues[bit])
+        {
+            auto queue = std::allocate_shared<ComponentEventQueue<T>>(
+                ResourceAllocator<ComponentEventQueue<T>>(mResource), mResource);
+            GetComponentArray<T>()->setEventQueue(queue.get());
+            mEventQueues[bit] = std::move(queue);
+        }
+        return static_cast<ComponentEventQueue<T> &>(*mEventQueues[bit]);
+    }
 
-        assert(mComponentIDtoBitPosition.count(name) > 0 && "Component not registered before use.");
+    // delivers the pending events of every observed component type, in registration order
+    void deliverEvents()
+    {
+        for (size_t bit = 0; bit < mEventQueues.size(); ++bit)
+        {
+            if (mEventQueues[bit])
+            {
+                mEventQueues[bit]->deliver();
+            }
+        }
+    }
 
+    template <typename T>
+    Signature getSignature()
+    {
         // Get this entity's signature from the array
         Signature signature;
-        signature.set(mComponentIDtoBitPosition[name]);
+        signature.set(GetComponentType<T>());
         return signature;
     }
 
 private:
-    // maps component type's ID (std::type_index) to the Bit Position that it occupies in the Signature
-    std::unordered_map<ComponentTypeID, ComponentTypeBitPosition> mComponentIDtoBitPosition;
+    // what the manager knows about a component type, indexed by componentTypeIndex<T>()
+    struct ComponentTypeRecord
+    {
+        IComponentArray *array{};
+        ComponentTypeBitPosition bit{};
+        bool registered{};
+    };
+
+    template <typename T>
+    const ComponentTypeRecord &getRecord() const
+    {
+        size_t typeIndex = componentTypeIndex<T>();
 
-    // maps component type's ID (std::type_index) to the corresponding ComponentArray of that type
-    // uses a virtual base class to allow for polymorphism since ComponentArray can be of manu different type
-    std::unordered_map<ComponentTypeID, std::shared_ptr<IComponentArray>> mComponentIDtoArrayMap{};
+        assert(typeIndex < mComponentTypes.size() && mComponentTypes[typeIndex].registered &&
+               "Component not registered before use.");
 
-    // a counter variable to indicate the next available bit position for new component type
-    ComponentTypeBitPosition mNextComponentTypeBitPosition{};
+        return mComponentTypes[typeIndex];
+    }
 
-    // Convenience function to get the statically casted pointer to the ComponentArray of type T.
     template <typename T>
-    std::shared_ptr<ComponentArray<T>> GetComponentArray()
+    void attachToPool(const Entity *entities, size_t count, const T *values)
     {
-        ComponentTypeID name = typeid(T);
+        ComponentArray<T> *pool = GetComponentArray<T>();
+        pool->reserve(pool->size() + count);
 
-        assert(mComponentIDtoBitPosition.count(name) && "Component not registered before use.");
-
-        return std::static_pointer_cast<ComponentArray<T>>(mComponentIDtoArrayMap[name]);
+        for (size_t index = 0; index < count; ++index)
+        {
+            pool->attachComponent(entities[index], values[index]);
+        }
     }
+
+    // maps component type's index to the Bit Position that it occupies in the Signature
+    // and to the corresponding ComponentArray of that type, a lookup is a single indexed load
+    std::vector<ComponentTypeRecord> mComponentTypes{};
+
+    // the event queues of the observed component types, indexed by bit position. Declared before the
+    // pools pointing into them so they outlive them. Allocated from mResource
+    std::vector<std::shared_ptr<IComponentEventQueue>> mEventQueues{};
+
+    // every owning group, in creation order. Same as the queues, they outlive the pools
+    std::vector<std::unique_ptr<PoolGroup>> mGroups{};
+
+    // owns every ComponentArray, in registration order (i.e. indexed by bit position)
+    // uses a virtual base class to allow for polymorphism since ComponentArray can be of manu different type.
+    // Allocated from mResource
+    std::vector<std::shared_ptr<IComponentArray>> mComponentArrays{};
+
+    // a counter variable to indicate the next available bit position for new component type
+    ComponentTypeBitPosition mNextComponentTypeBitPosition{};
+
+    StorageBackend mBackend;
+
+    std::pmr::memory_resource *mResource;
+
+    // holds every component when the archetype backend is selected, the ComponentArrays are unused then.
+    // Allocated from mResource
+    std::shared_ptr<ArchetypeStorage> mArchetypes;
+
+    // the tick changes are stamped with, starts above NO_CHANGE_TICK so a first query sees everything
+    std::atomic<std::uint32_t> mChangeTick{NO_CHANGE_TICK + 1};
+
+    // entities of a destroyed batch owning the pool being visited
+    std::vector<Entity> mDestroyScratch;
 };
\ No newline at end of file
@@ -1,47 +1,117 @@
 #pragma once
 
-#include <queue>
+#include <vector>
 #include <cstdint>
 #include <cassert>
-#include <bitset>
 
-#include "Component.hpp"
+#include "Memory.hpp"
+#include "Signature.hpp"
 
-// using an alias since entity in ECS is essentially an ID, plus it makes it more expressive
+/** using an alias since entity in ECS is essentially an ID, plus it makes it more expressive
+ * an Entity is a handle that packs two things together:
+ * - the low ENTITY_INDEX_BITS are the slot the entity occupies in the world
+ * - the remaining high bits are the generation of that slot, bumped every time it is recycled
+ * so a handle to a destroyed entity never compares equal to the one that reuses its slot */
 using Entity = std::uint32_t;
 
-// The max allowed entity to exist in the ecosystem at a time
-const Entity MAX_ENTITIES = 5000;
+const std::uint32_t ENTITY_INDEX_BITS = 20;
+const Entity ENTITY_INDEX_MASK = (Entity{1} << ENTITY_INDEX_BITS) - 1;
+const Entity ENTITY_GENERATION_MASK = ~Entity{0} >> ENTITY_INDEX_BITS;
 
-// This represents the type of comppnent that is "attached" to an entity
-using Signature = std::bitset<MAX_COMPONENTS>;
+// an index that no entity can occupy, used to terminate the free list and as a "no entity" handle
+const Entity NULL_ENTITY = ENTITY_INDEX_MASK;
+
+// The max allowed entity to exist in the ecosystem at a time when the world does not ask for a capacity
+const Entity DEFAULT_MAX_ENTITIES = 5000;
+
+// The largest capacity a world can ask for, every index below NULL_ENTITY is usable
+const Entity MAX_ENTITY_CAPACITY = NULL_ENTITY;
+
+// the slot an entity occupies, used to index every per-entity array
+inline Entity entityIndex(Entity entity) { return entity & ENTITY_INDEX_MASK; }
+
+inline Entity entityGeneration(Entity entity) { return entity >> ENTITY_INDEX_BITS; }
+
+inline Entity makeEntity(Entity index, Entity generation)
+{
+    return (generation & ENTITY_GENERATION_MASK) << ENTITY_INDEX_BITS | (index & ENTITY_INDEX_MASK);
+}
 
 /**This is meant to be an interface for all action related to the entity class.
- * - It only stores the available entities
- * - 'living' entity will be "given" out
- * - 'dead' entity will be "taken" back in and stored as available entities
+ * - It only stores the entity slots that have been handed out so far
+ * - 'living' entity will be "given" out, reusing the most recently freed slot first
+ * - 'dead' entity will be "taken" back in by bumping its slot's generation
+ *
+ * Freed slots form an intrusive free list inside mEntities itself: a dead slot keeps the
+ * generation its next owner will get and stores the index of the next free slot in its index bits
  */
 class EntityManager
 {
 public:
-    // generates all the available entities at instantiation
-    EntityManager();
+    // no entity is generated up front, slots are handed out lazily up to maxEntities.
+    // The tables are allocated from the resource
+    explicit EntityManager(Entity maxEntities = DEFAULT_MAX_ENTITIES,
+                           std::pmr::memory_resource *resource = std::pmr::get_default_resource());
 
-    // retrieve and returns the first available entity from the front of the queue
+    // retrieve and returns a recycled slot if there is one, otherwise a brand new one
     Entity createEntity();
 
+    // creates count entities into out, growing the entity table at most once
+    void createEntities(size_t count, Entity *out);
+
     // add entity back into the list of available entities
     void destroyEntity(Entity entity);
 
+    // whether the handle still refers to a living entity, a handle to a recycled slot is not alive
+    bool isAlive(Entity entity) const
+    {
+        Entity index = entityIndex(entity);
+        return index < mEntities.size() && mEntities[index] == entity;
+    }
+
     // attach a signature to the entity
-    void SetSignature(Entity entity, Signature signature);
+    void SetSignature(Entity entity, const Signature &signature);
 
     Signature GetSignature(Entity entity);
 
+    // every living entity whose signature has all the bits of include and none of exclude, in slot order.
+    // Scans the whole signature table with matchSignatures, out is overwritten
+    void query(const Signature &include, const Signature &exclude, std::vector<Entity> &out) const;
+
+    Entity getMaxEntities() const { return mMaxEntities; }
+
+    // the slot table (living handles and free list nodes) and the signature table, both indexed by slot.
+    // Together with the free list head they are the whole state of the manager, see Snapshot.hpp
+    const ResourceVector<Entity> &getSlots() const { return mEntities; }
+
+    const ResourceVector<Signature> &getSignatures() const { return mSignatures; }
+
+    Entity getFreeListHead() const { return mFreeListHead; }
+
+    // replaces the whole state of the manager with tables previously taken from getSlots / getSignatures
+    void restore(const Entity *slots, const Signature *signatures, size_t slotCount, Entity freeListHead,
+                 std::uint32_t livingCount);
+
+    std::uint32_t getNumLivingEntities() const { return mNumLivingEntity; }
+
+    // both tables, a slot is in use whether it is living or on the free list
+    MemoryUsage getMemoryUsage() const
+    {
+        return {mEntities.capacity() * sizeof(Entity) + mSignatures.capacity() * sizeof(Signature),
+                mEntities.size() * (sizeof(Entity) + sizeof(Signature))};
+    }
+
 private:
-    std::queue<Entity> mAvailableEntities{};
+    // a living slot holds its entity's handle, a dead slot is a free list node (see above)
+    ResourceVector<Entity> mEntities;
+
+    // index of the most recently freed slot, NULL_ENTITY when there is none
+    Entity mFreeListHead{NULL_ENTITY};
+
+    // indexed by slot and packed back to back so queries can stream through it, a dead slot's signature is empty
+    ResourceVector<Signature> mSignatures;
 
-    std::array<Signature, MAX_ENTITIES> mSignatures{};
+    Entity mMaxEntities{};
 
     std::uint32_t mNumLivingEntity{};
 };
@@ -0,0 +1,198 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <limits>
+#include <memory>
+#include <vector>
+
+#include "Entity.hpp"
+#include "Memory.hpp"
+
+// number of entity slots covered by one page of an EntitySet's sparse lookup
+const size_t SPARSE_PAGE_SIZE = 4096;
+
+/** A sparse set of entities: a paged entity slot -> position array (sparse) sitting next to
+ * a packed position -> entity array (dense).
+ * - membership test, insertion and removal are all constant time
+ * - the dense array can be walked linearly, there are no holes in it
+ * - removal moves the last entity into the hole, so positions are not stable across removals
+ * Sparse pages are only allocated once an entity in their range is inserted and freed once empty.
+ * Everything is allocated from the resource given at construction, the default resource otherwise */
+class EntitySet
+{
+public:
+    // marks a slot in the sparse array whose entity is not in the set
+    static constexpr size_t INVALID_INDEX = std::numeric_limits<size_t>::max();
+
+    using const_iterator = ResourceVector<Entity>::const_iterator;
+
+    EntitySet() = default;
+
+    explicit EntitySet(std::pmr::memory_resource *resource)
+        : mSparsePages(resource), mSparsePageCounts(resource), mDense(resource)
+    {
+    }
+
+    // position of the entity in the dense array, INVALID_INDEX if it is not in the set
+    // the packed entity is compared too, so a stale handle to a recycled slot is not mistaken for its successor
+    size_t find(Entity entity) const
+    {
+        Entity index = entityIndex(entity);
+        size_t page = index / SPARSE_PAGE_SIZE;
+        if (page >= mSparsePages.size() || !mSparsePages[page])
+        {
+            return INVALID_INDEX;
+        }
+        size_t position = mSparsePages[page][index % SPARSE_PAGE_SIZE];
+        return position != INVALID_INDEX && mDense[position] == entity ? position : INVALID_INDEX;
+    }
+
+    bool contains(Entity entity) const { return find(entity) != INVALID_INDEX; }
+
+    // position of an entity known to be in the set
+    size_t index(Entity entity) const
+    {
+        assert(contains(entity) && "Entity is not in the set");
+        Entity slot = entityIndex(entity);
+        return mSparsePages[slot / SPARSE_PAGE_SIZE][slot % SPARSE_PAGE_SIZE];
+    }
+
+    // appends the entity to the dense array and returns its position
+    size_t insert(Entity entity)
+    {
+        assert(!contains(entity) && "Entity is already in the set");
+
+        size_t position = mDense.size();
+        sparseSlot(entity) = position;
+        mDense.push_back(entity);
+        ++mSparsePageCounts[entityIndex(entity) / SPARSE_PAGE_SIZE];
+
+        return position;
+    }
+
+    // swap-and-pop: the last entity takes the removed entity's position
+    void erase(Entity entity)
+    {
+        size_t position = index(entity);
+        Entity lastEntity = mDense.back();
+
+        // the order matters when the removed entity is itself the last one
+        mDense[position] = lastEntity;
+        sparseSlot(lastEntity) = position;
+        mDense.pop_back();
+
+        Entity slot = entityIndex(entity);
+        size_t page = slot / SPARSE_PAGE_SIZE;
+        mSparsePages[page][slot % SPARSE_PAGE_SIZE] = INVALID_INDEX;
+        if (--mSparsePageCounts[page] == 0)
+        {
+            mSparsePages[page].reset();
+        }
+    }
+
+    // exchanges the dense positions of two entities of the set
+    void swapPositions(size_t first, size_t second)
+    {
+        std::swap(mDense[first], mDense[second]);
+        sparseSlot(mDense[first]) = first;
+        sparseSlot(mDense[second]) = second;
+    }
+
+    // empties the set but keeps its sparse pages, so refilling it does not allocate
+    void clear()
+    {
+        for (Entity entity : mDense)
+        {
+            Entity slot = entityIndex(entity);
+            mSparsePages[slot / SPARSE_PAGE_SIZE][slot % SPARSE_PAGE_SIZE] = INVALID_INDEX;
+        }
+        std::fill(mSparsePageCounts.begin(), mSparsePageCounts.end(), 0);
+        mDense.clear();
+    }
+
+    // replaces the contents of the set with count distinct entities, in that order
+    void assign(const Entity *entities, size_t count)
+    {
+        clear();
+        mDense.assign(entities, entities + count);
+        for (size_t position = 0; position < count; ++position)
+        {
+            sparseSlot(mDense[position]) = position;
+            ++mSparsePageCounts[entityIndex(mDense[position]) / SPARSE_PAGE_SIZE];
+        }
+    }
+
+    size_t size() const { return mDense.size(); }
+
+    bool empty() const { return mDense.empty(); }
+
+    Entity operator[](size_t position) const { return mDense[position]; }
+
+    const Entity *data() const { return mDense.data(); }
+
+    const_iterator begin() const { return mDense.begin(); }
+
+    const_iterator end() const { return mDense.end(); }
+
+    // makes room for capacity entities in the dense array
+    void reserve(size_t capacity) { mDense.reserve(capacity); }
+
+    void shrinkToFit() { mDense.shrink_to_fit(); }
+
+    // the dense array and every sparse page count as reserved, the slots of the members as used
+    MemoryUsage getMemoryUsage() const
+    {
+        size_t pageCount = static_cast<size_t>(
+            std::count_if(mSparsePages.begin(), mSparsePages.end(), [](const SparsePage &page)
+                          { return page != nullptr; }));
+        size_t reserved = mDense.capacity() * sizeof(Entity) + mSparsePages.capacity() * sizeof(SparsePage) +
+                          mSparsePageCounts.capacity() * sizeof(size_t) +
+                          pageCount * SPARSE_PAGE_SIZE * sizeof(size_t);
+        return {reserved, size() * (sizeof(Entity) + sizeof(size_t))};
+    }
+
+private:
+    // hands a sparse page back to the resource it came from
+    struct SparsePageDeleter
+    {
+        std::pmr::memory_resource *resource{};
+
+        void operator()(size_t *page) const
+        {
+            resource->deallocate(page, SPARSE_PAGE_SIZE * sizeof(size_t), alignof(size_t));
+        }
+    };
+
+    using SparsePage = std::unique_ptr<size_t[], SparsePageDeleter>;
+
+    // returns the sparse slot of the given entity, allocating its page if it does not exist yet
+    size_t &sparseSlot(Entity entity)
+    {
+        Entity slot = entityIndex(entity);
+        size_t page = slot / SPARSE_PAGE_SIZE;
+        if (page >= mSparsePages.size())
+        {
+            mSparsePages.resize(page + 1);
+            mSparsePageCounts.resize(page + 1);
+        }
+        if (!mSparsePages[page])
+        {
+            std::pmr::memory_resource *resource = mDense.get_allocator().resource();
+            auto *slots = static_cast<size_t *>(resource->allocate(SPARSE_PAGE_SIZE * sizeof(size_t), alignof(size_t)));
+            std::fill_n(slots, SPARSE_PAGE_SIZE, INVALID_INDEX);
+            mSparsePages[page] = SparsePage(slots, SparsePageDeleter{resource});
+        }
+        return mSparsePages[page][slot % SPARSE_PAGE_SIZE];
+    }
+
+    // sparse half: indexed by the entity's slot, holds the entity's position in the dense array
+    ResourceVector<SparsePage> mSparsePages;
+
+    // number of live slots in each sparse page, an empty page gets released
+    ResourceVector<size_t> mSparsePageCounts;
+
+    // dense half: every entity of the set, packed
+    ResourceVector<Entity> mDense;
+};
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <memory_resource>
+#include <utility>
+
+#include "Entity.hpp"
+#include "Memory.hpp"
+
+// receives a batch of events, the entities they happened to in the order they happened
+using EntityObserver = std::function<void(const Entity *entities, size_t count)>;
+
+// receives a batch of detach events with the detached components, components[i] belonging to entities[i]
+template <typename T>
+using DetachObserver = std::function<void(const Entity *entities, const T *components, size_t count)>;
+
+/** one kind of entity event (e.g. "a Position was attached") queued into a contiguous buffer and handed
+ * to every observer in a single call at delivery. Nothing is recorded while there are no observers.
+ * Events recorded by an observer during delivery go to the next delivery. The buffers and the observer
+ * list are allocated from the resource */
+class EntityEventStream
+{
+public:
+    explicit EntityEventStream(std::pmr::memory_resource *resource = std::pmr::get_default_resource())
+        : mObservers(resource), mPending(resource), mDelivering(resource)
+    {
+    }
+
+    void observe(EntityObserver observer) { mObservers.push_back(std::move(observer)); }
+
+    bool isObserved() const { return !mObservers.empty(); }
+
+    void record(Entity entity)
+    {
+        if (isObserved())
+        {
+            mPending.push_back(entity);
+        }
+    }
+
+    bool hasPending() const { return !mPending.empty(); }
+
+    void deliver()
+    {
+        mDelivering.swap(mPending);
+        // observers registered during delivery only see the following batches
+        for (size_t index = 0, count = mObservers.size(); index < count && !mDelivering.empty(); ++index)
+        {
+            mObservers[index](mDelivering.data(), mDelivering.size());
+        }
+        mDelivering.clear();
+    }
+
+private:
+    ResourceVector<EntityObserver> mObservers;
+
+    // recorded since the last delivery, and the batch being delivered
+    ResourceVector<Entity> mPending;
+    ResourceVector<Entity> mDelivering;
+};
+
+// what the ComponentManager needs of a component type's events without knowing the type
+class IComponentEventQueue
+{
+public:
+    virtual ~IComponentEventQueue() = default;
+
+    // hands the attach then the detach events recorded since the last delivery to their observers
+    virtual void deliver() = 0;
+};
+
+/** the attach and detach events of one component type, fed by its ComponentArray.
+ * A detached component is moved into the queue before it leaves the pool, so detach observers still see
+ * its value although the entity may be gone by delivery. Attach events only carry the entity: by delivery
+ * the component may have been detached again, or its entity destroyed. Allocated from the resource,
+ * along with everything it queues */
+template <typename T>
+class ComponentEventQueue : public IComponentEventQueue
+{
+public:
+    explicit ComponentEventQueue(std::pmr::memory_resource *resource = std::pmr::get_default_resource())
+        : mAttached(resource), mDetachObservers(resource), mDetachedEntities(resource),
+          mDetachedComponents(resource), mDeliveringEntities(resource), mDeliveringComponents(resource)
+    {
+    }
+
+    void observeAttach(EntityObserver observer) { mAttached.observe(std::move(observer)); }
+
+    void observeDetach(DetachObserver<T> observer) { mDetachObservers.push_back(std::move(observer)); }
+
+    void recordAttached(Entity entity) { mAttached.record(entity); }
+
+    // takes the component's value when someone observes detaches, leaves it alone otherwise
+    void recordDetached(Entity entity, T &component)
+    {
+        if (!mDetachObservers.empty())
+        {
+            mDetachedEntities.push_back(entity);
+            mDetachedComponents.push_back(std::move(component));
+        }
+    }
+
+    void deliver() override
+    {
+        if (mAttached.hasPending())
+        {
+            mAttached.deliver();
+        }
+
+        if (mDetachedEntities.empty())
+        {
+            return;
+        }
+        mDeliveringEntities.swap(mDetachedEntities);
+        mDeliveringComponents.swap(mDetachedComponents);
+        for (size_t index = 0, count = mDetachObservers.size(); index < count; ++index)
+        {
+            mDetachObservers[index](mDeliveringEntities.data(), mDeliveringComponents.data(),
+                                    mDeliveringEntities.size());
+        }
+        mDeliveringEntities.clear();
+        mDeliveringComponents.clear();
+    }
+
+private:
+    EntityEventStream mAttached;
+
+    ResourceVector<DetachObserver<T>> mDetachObservers;
+    ResourceVector<Entity> mDetachedEntities;
+    ResourceVector<T> mDetachedComponents;
+    ResourceVector<Entity> mDeliveringEntities;
+    ResourceVector<T> mDeliveringComponents;
+};
@@ -1,17 +1,32 @@
 #pragma once
 
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include "CommandBuffer.hpp"
 #include "Entity.hpp"
 #include "Component.hpp"
+#include "EntitySet.hpp"
+#include "Events.hpp"
+#include "Group.hpp"
+#include "Memory.hpp"
 #include "System.hpp"
+#include "View.hpp"
 
 /** top level class to interface with the entire ECS system */
 class Game
 {
 public:
-    Game();
+    // maxEntities is the world's entity capacity, the component pools grow on demand up to it
+    // backend selects how components are stored, the API below is the same for both
+    explicit Game(Entity maxEntities = DEFAULT_MAX_ENTITIES, StorageBackend backend = StorageBackend::SparseSet);
 
     // initializer for creaing all the managerial level classes in ECS ecosystem
-    void init();
+    void init(Entity maxEntities = DEFAULT_MAX_ENTITIES, StorageBackend backend = StorageBackend::SparseSet);
 
     // returns an unsigned integer that repreents an entity
     Entity CreateEntity();
@@ -19,32 +34,332 @@ public:
     // a high level method that invokes all the corresponding updating methods when an entity is destroyed
     void DestroyEntity(Entity entity);
 
+    // whether the handle still refers to a living entity, constant time
+    bool IsAlive(Entity entity) const;
+
+    // creates count entities and writes their handles into out
+    void CreateEntities(size_t count, Entity *out);
+
+    // destroys every entity of the batch, each component pool is visited once for the whole batch
+    void DestroyEntities(const Entity *entities, size_t count);
+
     // register a new type of component into the ECS ecosystem
     template <typename T>
-    void RegisterComponent();
+    void RegisterComponent()
+    {
+        mComponentManager->registerComponentType<T>();
+    }
+
+    template <typename T>
+    void AttachComponent(Entity entity, T component)
+    {
+        mComponentManager->AttachComponent<T>(entity, std::move(component));
+
+        auto oldSignature = mEntityManager->GetSignature(entity);
+        auto signature = oldSignature;
+        signature.set(mComponentManager->GetComponentType<T>(), true);
+        mEntityManager->SetSignature(entity, signature);
+
+        mSystemManager->handleEntitySignatureChanged(entity, oldSignature, signature);
+    }
+
+    // attaches values[i]... to entities[i] for every i < count, e.g.
+    //     game.AttachComponents<Position, Sprite>(tiles.data(), tiles.size(), positions.data(), sprites.data());
+    // the pools are reserved once, and every entity gets a single signature write and a single
+    // system membership update whatever the number of component types
+    template <typename... Ts>
+    void AttachComponents(const Entity *entities, size_t count, const Ts *...values)
+    {
+        mComponentManager->AttachComponents<Ts...>(entities, count, values...);
+
+        Signature added;
+        (added.set(mComponentManager->GetComponentType<Ts>(), true), ...);
+
+        for (size_t index = 0; index < count; ++index)
+        {
+            Entity entity = entities[index];
+            Signature oldSignature = mEntityManager->GetSignature(entity);
+            Signature signature = oldSignature | added;
+            mEntityManager->SetSignature(entity, signature);
+
+            mSystemManager->handleEntitySignatureChanged(entity, oldSignature, signature);
+        }
+    }
+
+    template <typename T>
+    void DetachComponent(Entity entity)
+    {
+        mComponentManager->DetachComponent<T>(entity);
+
+        auto oldSignature = mEntityManager->GetSignature(entity);
+        auto signature = oldSignature;
+        signature.set(mComponentManager->GetComponentType<T>(), false);
+        mEntityManager->SetSignature(entity, signature);
+
+        mSystemManager->handleEntitySignatureChanged(entity, oldSignature, signature);
+    }
+
+    template <typename T>
+    T &GetComponent(Entity entity)
+    {
+        return mComponentManager->GetComponent<T>(entity);
+    }
+
+    template <typename T>
+    ComponentTypeBitPosition GetComponentType()
+    {
+        return mComponentManager->GetComponentType<T>();
+    }
+
+    // a view over every entity owning all of Ts and none of the excluded components, e.g.
+    //     game.View<Position, Velocity>(Exclude<Frozen>{}).each([](Position &p, Velocity &v) { ... });
+    // works with both storage backends. Tick filters may follow, see Changed and Added:
+    //     game.View<Position>(Exclude<Frozen>{}, Changed<Position>{since})
+    template <typename... Ts, typename... Xs, typename... Fs>
+    ComponentView<Exclude<Xs...>, Ts...> View(Exclude<Xs...> = {}, Fs... filters)
+    {
+        return ComponentView<Exclude<Xs...>, Ts...>(*mComponentManager, filters...);
+    }
+
+    // a view filtered on change ticks only, e.g. game.View<Position>(Changed<Position>{since})
+    template <typename... Ts, typename F, typename... Fs, typename = std::enable_if_t<IsTickFilter<F>::value>>
+    ComponentView<Exclude<>, Ts...> View(F filter, Fs... filters)
+    {
+        return ComponentView<Exclude<>, Ts...>(*mComponentManager, filter, filters...);
+    }
+
+    /** the owning group of Ts, created on first call: the pools of Ts are kept co-sorted so the entities
+     * owning all of them share the same leading range, and joining them is a linear walk, e.g.
+     *     game.Group<Position, Velocity>().each([](Position &p, Velocity &v) { ... });
+     * Each pool can be owned by one group only. Requires the sparse set backend */
+    template <typename... Ts>
+    OwningGroup<Ts...> Group()
+    {
+        return OwningGroup<Ts...>(*mComponentManager);
+    }
+
+    // reorders the pool of T by compare(const T&, const T&), e.g. by depth. When T is owned by a group the
+    // group's range and the rest of the pool are sorted apart, the group's other pools following along.
+    // Requires the sparse set backend
+    template <typename T, typename Compare>
+    void Sort(Compare compare)
+    {
+        mComponentManager->sortComponents<T>(std::move(compare));
+    }
+
+    /** starts recording, for every T, the tick it was attached at and the tick of its last change, so
+     * views can keep only what changed (Changed<T>, Added<T>). Requires the sparse set backend.
+     * A system usually keeps the tick of its previous run:
+     *     std::uint32_t since = std::exchange(mLastTick, game.AdvanceChangeTick());
+     *     game.View<Position>(Changed<Position>{since}).each(...);
+     * Writes through a T& are not seen, they are recorded by MarkChanged or PatchComponent */
+    template <typename T>
+    void TrackChanges()
+    {
+        mComponentManager->enableChangeTracking<T>();
+    }
 
+    // records a change of the entity's T at the current tick, nothing when T is not tracked
     template <typename T>
-    void AttachComponent(Entity entity, T component);
+    void MarkChanged(Entity entity)
+    {
+        if (ComponentArray<T> *pool = mComponentManager->GetComponentArray<T>())
+        {
+            pool->markChanged(entity);
+        }
+    }
 
+    // calls func(T&) on the entity's T and records the change
+    template <typename T, typename Func>
+    void PatchComponent(Entity entity, Func &&func)
+    {
+        func(mComponentManager->GetComponent<T>(entity));
+        MarkChanged<T>(entity);
+    }
+
+    // the tick changes are currently recorded at
+    std::uint32_t GetChangeTick() const { return mComponentManager->getChangeTick(); }
+
+    // moves every later change to a newer tick and returns the current one: what changed from now on
+    // passes a Changed{returned tick} filter, what changed before does not. A system's own writes after
+    // the call are therefore seen again on its next run. Call it while no system is recording changes
+    std::uint32_t AdvanceChangeTick() { return mComponentManager->advanceChangeTick(); }
+
+    /** observers of the world's structural events. Events are queued into one buffer per kind and component
+     * type and handed over in batches by DeliverEvents, which UpdateSystems calls once the commands are
+     * flushed: an observer is called once per batch, never from inside a system. Detaching a component
+     * and destroying its entity both count as a detach. Structural changes made by an observer are
+     * delivered with the next batch. The component events require the sparse set backend */
     template <typename T>
-    void DetachComponent(Entity entity);
+    void OnAttach(EntityObserver observer)
+    {
+        mComponentManager->getEventQueue<T>().observeAttach(std::move(observer));
+    }
 
+    // the detached components are handed over too, moved out of the pool
     template <typename T>
-    T &GetComponent(Entity entity);
+    void OnDetach(DetachObserver<T> observer)
+    {
+        mComponentManager->getEventQueue<T>().observeDetach(std::move(observer));
+    }
+
+    // the handles are no longer alive by delivery
+    void OnDestroy(EntityObserver observer) { mDestroyEvents.observe(std::move(observer)); }
+
+    // hands every queued event to its observers: attaches then detaches of each component type in
+    // registration order, then destroys. Must not run while systems are iterating
+    void DeliverEvents();
+
+    // invokes func(entity, Ts&...) or func(Ts&...) for every entity owning all of Ts,
+    // streaming the archetype chunks' columns. Requires the archetype backend
+    template <typename... Ts, typename Func>
+    void ArchetypeEach(Func &&func)
+    {
+        mComponentManager->getArchetypeStorage().each<Ts...>({mComponentManager->GetComponentType<Ts>()...},
+                                                             Signature{}, std::forward<Func>(func));
+    }
+
+    // invokes func(count, Ts*...) for every archetype chunk holding all of Ts, with the chunk's columns.
+    // Requires the archetype backend
+    template <typename... Ts, typename Func>
+    void ArchetypeEachChunk(Func &&func)
+    {
+        mComponentManager->getArchetypeStorage().eachChunk<Ts...>({mComponentManager->GetComponentType<Ts>()...},
+                                                                  Signature{}, std::forward<Func>(func));
+    }
 
+    // the pool holding every T, nullptr when the world uses the archetype backend
     template <typename T>
-    ComponentTypeBitPosition GetComponentType();
+    ComponentArray<T> *GetComponentArray()
+    {
+        return mComponentManager->GetComponentArray<T>();
+    }
 
-    // register a new type of system into the ECS ecosystem
+    StorageBackend GetStorageBackend() const { return mComponentManager->getBackend(); }
+
+    // collects every living entity owning all of Ts and none of the excluded components into out,
+    // by scanning the entity signature table rather than the pools. Meant for ad-hoc queries and tooling
+    template <typename... Ts, typename... Xs>
+    void QueryEntities(std::vector<Entity> &out, Exclude<Xs...> = {})
+    {
+        Signature include;
+        (include.set(mComponentManager->GetComponentType<Ts>()), ...);
+        Signature exclude;
+        (exclude.set(mComponentManager->GetComponentType<Xs>()), ...);
+        mEntityManager->query(include, exclude, out);
+    }
+
+    // migration counters of the archetype backend, requires the archetype backend
+    ArchetypeStats GetArchetypeStats()
+    {
+        return mComponentManager->getArchetypeStorage().getStats();
+    }
+
+    // register a new type of system into the ECS ecosystem. The system is allocated in the world's memory,
+    // the returned pointer must not outlive the Game
     template <typename T>
-    std::shared_ptr<T> RegisterSystem();
+    std::shared_ptr<T> RegisterSystem()
+    {
+        return mSystemManager->registerSystem<T>(Signature{});
+    }
 
     // set the signature that represents the type of component that will be processed by it
     template <typename T>
-    void SetSystemSignature(Signature signature);
+    void SetSystemSignature(const Signature &signature)
+    {
+        mSystemManager->setSignature<T>(signature);
+    }
+
+    // declare which component types the system reads and writes, e.g.
+    //     game.SetSystemAccess<MovementSystem>(Reads<Velocity>{}, Writes<Position>{});
+    // systems whose accesses do not conflict may run concurrently in UpdateSystems
+    template <typename T, typename... Rs, typename... Ws>
+    void SetSystemAccess(Reads<Rs...>, Writes<Ws...>)
+    {
+        Signature reads;
+        (reads.set(mComponentManager->GetComponentType<Rs>()), ...);
+        Signature writes;
+        (writes.set(mComponentManager->GetComponentType<Ws>()), ...);
+
+        mSystemManager->setAccess<T>(reads, writes);
+    }
+
+    // spins up a work-stealing pool of workerCount threads used by UpdateSystems,
+    // 0 goes back to running every system on the calling thread
+    void SetWorkerCount(size_t workerCount);
+
+    // runs every registered system once. Without workers the systems run in registration order,
+    // otherwise non-conflicting systems run concurrently while conflicting ones keep that order.
+    // The command buffers are flushed once every system is done, then the events are delivered
+    void UpdateSystems();
+
+    // the command buffer of the calling thread, structural changes recorded into it are applied
+    // by the next FlushCommands. Fetch it once per task rather than once per entity
+    CommandBuffer &GetCommandBuffer();
+
+    // plays back every thread's command buffer, must not run while systems are iterating
+    void FlushCommands();
+
+    // writes every entity with its components to a binary snapshot file (see Snapshot.hpp). Returns false
+    // when the file cannot be written, with the archetype backend, or when a pool in use holds a
+    // component that is not trivially copyable
+    bool SaveSnapshot(const std::string &path);
+
+    // replaces every entity and component of the world with the ones of a snapshot file, which is mapped
+    // and copied into the pools a page at a time. The world must have registered the same component types
+    // in the same order as the one that saved it. Returns false (leaving the world untouched) when the
+    // file cannot be read or does not match. Call it between frames, with no command pending
+    bool LoadSnapshot(const std::string &path);
+
+    // nullptr when the world runs single threaded
+    ThreadPool *GetThreadPool() { return mThreadPool.get(); }
+
+    /** bytes reserved and used by every component pool, system set and the entity table, with the
+     * allocation counters of the world's memory. A world whose sizes stay put allocates nothing in a
+     * frame: GetMemoryStats().lastFrameAllocations is 0. Fills vectors, so call it outside of frames */
+    MemoryStats GetMemoryStats() const;
+
+    // the resource every pool, entity set, entity table, system, archetype, event queue and command buffer
+    // of the world is allocated from. See WorldMemory for what stays on the heap
+    std::pmr::memory_resource *GetMemoryResource() { return mMemory.getResource(); }
 
 private:
+    // declared first, everything below may hold memory from it
+    WorldMemory mMemory;
+
     std::unique_ptr<ComponentManager> mComponentManager;
     std::unique_ptr<EntityManager> mEntityManager;
     std::unique_ptr<SystemManager> mSystemManager;
-};
\ No newline at end of file
+    std::unique_ptr<ThreadPool> mThreadPool;
+
+    // one command buffer per thread that asked for one, in the order the threads first asked: FlushCommands
+    // plays them back in that order, so a flush does not depend on how the threads are hashed
+    ResourceVector<std::shared_ptr<CommandBuffer>> mCommandBuffers;
+    // index in mCommandBuffers of each thread's buffer
+    std::unordered_map<std::thread::id, size_t, std::hash<std::thread::id>, std::equal_to<std::thread::id>,
+                       ResourceAllocator<std::pair<const std::thread::id, size_t>>>
+        mCommandBufferIndices;
+    std::mutex mCommandBufferMutex;
+
+    // scratch space of FlushCommands, kept between flushes to avoid reallocating every frame
+    struct PlaybackCommand
+    {
+        CommandBuffer *buffer;
+        CommandBuffer::Command *command;
+        Entity entity;
+        // buffers in registration order, then recording order: the sort's last key, keeping that order without a
+        // temporary buffer
+        std::uint32_t order;
+    };
+    ResourceVector<PlaybackCommand> mPlaybackCommands;
+    ResourceVector<Entity> mPendingEntities;
+    ResourceVector<Entity> mPlaybackDestroys;
+    // entities whose signature changed during the flush, with the signature they had before it
+    EntitySet mTouchedEntities;
+    ResourceVector<Signature> mTouchedSignatures;
+
+    // signatures of the entities of a DestroyEntities batch, captured before they are reset
+    ResourceVector<Signature> mBatchSignatures;
+
+    EntityEventStream mDestroyEvents;
+};
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+
+#include "Profiler.hpp"
+
+// longest real time a single frame may account for, anything above is dropped rather than simulated
+const double DEFAULT_MAX_FRAME_TIME = 0.25;
+
+/** drives the frame: input once, the simulation in fixed steps, then rendering.
+ * - real time is accumulated and consumed in steps of exactly timeStep, so the simulation does not
+ *   depend on the frame rate
+ * - whatever is left in the accumulator gives the render stage an interpolation alpha in [0, 1)
+ *   between the previous and the current simulation state
+ * - a frame never accounts for more than maxFrameTime of real time, and never runs more than
+ *   maxStepsPerFrame steps: a slow frame cannot snowball into ever slower ones (spiral of death),
+ *   the simulation slows down instead
+ * Every frame and every stage is a profiler scope */
+class GameLoop
+{
+public:
+    explicit GameLoop(double timeStep = 1.0 / 60.0, double maxFrameTime = DEFAULT_MAX_FRAME_TIME,
+                      std::uint32_t maxStepsPerFrame = 8);
+
+    // called once per frame before the simulation catches up
+    void setInputStage(std::function<void()> stage) { mInputStage = std::move(stage); }
+
+    // advances the simulation by exactly dt seconds, called zero or more times per frame
+    void setUpdateStage(std::function<void(double dt)> stage) { mUpdateStage = std::move(stage); }
+
+    // called once per frame after the simulation, alpha is how far the frame is between the last two steps
+    void setRenderStage(std::function<void(double alpha)> stage) { mRenderStage = std::move(stage); }
+
+    // caps the frame rate of run() by sleeping out the rest of each frame, 0 (the default) does not cap it.
+    // Meant for runs without a vsync'd renderer to pace the loop
+    void setFrameRateLimit(double framesPerSecond)
+    {
+        mMinFrameTime = framesPerSecond > 0.0 ? 1.0 / framesPerSecond : 0.0;
+    }
+
+    // runs frames against the real clock until stop() is called from one of the stages
+    void run();
+
+    // runs one frame as if frameTime seconds of real time had passed, for headless and deterministic runs
+    void advance(double frameTime);
+
+    void stop() { mRunning = false; }
+
+    bool isRunning() const { return mRunning; }
+
+    double getTimeStep() const { return mTimeStep; }
+
+    // interpolation factor handed to the last render stage
+    double getAlpha() const { return mAccumulator / mTimeStep; }
+
+    std::uint64_t getFrameCount() const { return mFrameCount; }
+
+    std::uint64_t getStepCount() const { return mStepCount; }
+
+    // real time dropped by the clamps so far, in seconds
+    double getDroppedTime() const { return mDroppedTime; }
+
+private:
+    double mTimeStep;
+    double mMaxFrameTime;
+    std::uint32_t mMaxStepsPerFrame;
+    double mMinFrameTime{};
+
+    std::function<void()> mInputStage;
+    std::function<void(double)> mUpdateStage;
+    std::function<void(double)> mRenderStage;
+
+    // real time not yet consumed by a simulation step
+    double mAccumulator{};
+    double mDroppedTime{};
+
+    std::uint64_t mFrameCount{};
+    std::uint64_t mStepCount{};
+
+    bool mRunning{};
+};
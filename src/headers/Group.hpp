@@ -0,0 +1,120 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "Component.hpp"
+
+/** iteration over the entities owning all of Ts through the owning group of Ts (see PoolGroup).
+ * Those entities are the first size() components of every pool of Ts, in the same order, so a join is a
+ * lockstep linear walk: no sparse lookup, no entity comparison, and the pools' pages line up so every
+ * page is handed over as plain arrays. Creating the handle creates the group on first use.
+ * Requires the sparse set backend */
+template <typename... Ts>
+class OwningGroup
+{
+    static_assert(sizeof...(Ts) > 0, "A group needs at least one component type");
+
+public:
+    explicit OwningGroup(ComponentManager &manager)
+        : mGroup(&manager.getGroup<Ts...>()), mPools(manager.GetComponentArray<Ts>()...)
+    {
+    }
+
+    // number of entities in the group, they sit at positions [0, size()) of every pool
+    size_t size() const { return mGroup->size(); }
+
+    bool empty() const { return size() == 0; }
+
+    // the entity at the given position of the group
+    Entity entityAt(size_t index) const { return std::get<0>(mPools)->entityAt(index); }
+
+    bool contains(Entity entity) const
+    {
+        size_t index = std::get<0>(mPools)->getEntities().find(entity);
+        return index != EntitySet::INVALID_INDEX && index < size();
+    }
+
+    // invokes func(entity, Ts&...) or func(Ts&...) for every entity of the group
+    template <typename Func>
+    void each(Func &&func)
+    {
+        eachInRange(func, 0, size());
+    }
+
+    // same as each, the group's range split into ranges of about grainSize entities run across the pool.
+    // Range boundaries fall on cache line boundaries of every pool. Without a pool this is each()
+    template <typename Func>
+    void parallelEach(ThreadPool *pool, Func &&func, size_t grainSize = DEFAULT_GRAIN_SIZE)
+    {
+        if (!pool)
+        {
+            each(func);
+            return;
+        }
+        pool->parallelFor(0, size(), groupGrainSize(grainSize), [this, &func](size_t begin, size_t end)
+                          { eachInRange(func, begin, end); });
+    }
+
+    // invokes func(begin, count, Ts*...) for every run of the group stored contiguously in all the pools
+    // (at most a page), begin being the run's first position. Meant for kernels over plain arrays
+    template <typename Func>
+    void eachRun(Func &&func)
+    {
+        eachRunInRange(func, 0, size());
+    }
+
+    // same as eachRun, over the positions [begin, end) of the group only
+    template <typename Func>
+    void eachRunInRange(Func &&func, size_t begin, size_t end)
+    {
+        assert(end <= size() && "Range outside of the group");
+        for (size_t index = begin; index < end;)
+        {
+            size_t pageEnd = std::min(end, (index / COMPONENT_PAGE_SIZE + 1) * COMPONENT_PAGE_SIZE);
+            func(index, pageEnd - index, &std::get<ComponentArray<Ts> *>(mPools)->componentAt(index)...);
+            index = pageEnd;
+        }
+    }
+
+    // reorders the group by compare(const T&, const T&), T being one of Ts; every pool follows
+    template <typename T, typename Compare>
+    void sort(Compare compare)
+    {
+        std::get<ComponentArray<T> *>(mPools)->sort(std::move(compare));
+    }
+
+    // rounds a grain size up so ranges split on it start on a cache line of every pool of the group
+    static size_t groupGrainSize(size_t grainSize)
+    {
+        return std::max({alignGrainSize<Ts>(grainSize)...});
+    }
+
+private:
+    template <typename Func>
+    void eachInRange(Func &func, size_t begin, size_t end)
+    {
+        eachRunInRange([this, &func](size_t first, size_t count, Ts *...components)
+                       {
+            for (size_t offset = 0; offset < count; ++offset)
+            {
+                if constexpr (std::is_invocable_v<Func &, Entity, Ts &...>)
+                {
+                    func(entityAt(first + offset), components[offset]...);
+                }
+                else
+                {
+                    func(components[offset]...);
+                }
+            } },
+                       begin, end);
+    }
+
+    PoolGroup *mGroup;
+
+    std::tuple<ComponentArray<Ts> *...> mPools;
+};
@@ -0,0 +1,274 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Game.hpp"
+#include "Memory.hpp"
+#include "System.hpp"
+#include "Transform.hpp"
+
+// marks the entities of a HierarchySystem's hierarchy. Attached and detached by the system, not by hand
+struct HierarchyNode
+{
+};
+
+/** parent / child links between entities, with every node's local and world position stored level by
+ * level: depth 0 (the roots) first, then their children, and so on. Each level keeps its nodes in flat
+ * arrays (entity, local, world, index of the parent in the level above), so propagating the world
+ * positions is one linear walk over the levels, a parent always being done before its children.
+ * - a root's local position is its world position, a child's is its offset from its parent
+ * - setLocal and setParent mark the node dirty, propagate only recomputes the dirty nodes and whatever
+ *   sits under a node whose world position moved, and stops at the first level past which nothing is left
+ * - reparenting moves the subtree to its new levels node by node, O(subtree). A node leaving a level is
+ *   replaced by the level's last one, whose children are told its new index
+ * Everything is allocated from the resource given at construction */
+class TransformHierarchy
+{
+public:
+    explicit TransformHierarchy(std::pmr::memory_resource *resource = std::pmr::get_default_resource());
+
+    // adds the entity as a root standing at world
+    void insert(Entity entity, Position world);
+
+    // takes the entity out, its children become roots where they stand
+    void remove(Entity entity);
+
+    bool contains(Entity entity) const
+    {
+        Entity index = entityIndex(entity);
+        return index < mNodes.size() && mNodes[index].entity == entity;
+    }
+
+    // number of nodes
+    size_t size() const { return mSize; }
+
+    /** puts child, along with everything under it, under parent at the given offset. Both must be in the
+     * hierarchy and parent must not be under child. Takes effect at the next propagate */
+    void setParent(Entity child, Entity parent, Position local);
+
+    // makes the entity a root where it stands, everything under it follows
+    void clearParent(Entity entity);
+
+    // NULL_ENTITY for a root
+    Entity getParent(Entity entity) const { return node(entity).parent; }
+
+    // 0 for a root
+    size_t getDepth(Entity entity) const { return node(entity).depth; }
+
+    // the offset from the parent, the world position for a root
+    Position getLocal(Entity entity) const { return mLevels[node(entity).depth].local[node(entity).index]; }
+
+    void setLocal(Entity entity, Position local);
+
+    // as of the last propagate
+    Position getWorld(Entity entity) const { return mLevels[node(entity).depth].world[node(entity).index]; }
+
+    // walks up to the root, exact even while ancestors are dirty
+    Position computeWorld(Entity entity) const;
+
+    // number of levels holding nodes, or having held some
+    size_t getLevelCount() const { return mLevels.size(); }
+
+    // the entities at the given depth, in the order propagate visits them
+    const ResourceVector<Entity> &getLevelEntities(size_t depth) const { return mLevels[depth].entities; }
+
+    /** recomputes the world position of every dirty node and of every node whose parent moved, level by
+     * level, and calls moved(entity, world) for each one whose world position changed.
+     * Returns the number of such nodes */
+    template <typename Func>
+    size_t propagate(Func &&moved);
+
+private:
+    // what a node's level does not hold, indexed by entity slot
+    struct Node
+    {
+        // NULL_ENTITY when the slot holds no node
+        Entity entity{NULL_ENTITY};
+        Entity parent{NULL_ENTITY};
+        Entity firstChild{NULL_ENTITY};
+        Entity nextSibling{NULL_ENTITY};
+        Entity previousSibling{NULL_ENTITY};
+        // where the node sits: its level, and its position in the level's arrays
+        std::uint32_t depth{};
+        std::uint32_t index{};
+    };
+
+    // the nodes of one depth, every array indexed alike
+    struct Level
+    {
+        explicit Level(std::pmr::memory_resource *resource)
+            : entities(resource), parents(resource), local(resource), world(resource), dirty(resource),
+              movedPass(resource)
+        {
+        }
+
+        ResourceVector<Entity> entities;
+        // index of the parent in the level above, unused at depth 0
+        ResourceVector<std::uint32_t> parents;
+        ResourceVector<Position> local;
+        ResourceVector<Position> world;
+        ResourceVector<std::uint8_t> dirty;
+        // the last propagate pass the world position moved in, so nothing has to be cleared between passes
+        ResourceVector<std::uint32_t> movedPass;
+        size_t dirtyCount{};
+    };
+
+    const Node &node(Entity entity) const
+    {
+        assert(contains(entity) && "Entity is not in the hierarchy");
+        return mNodes[entityIndex(entity)];
+    }
+
+    Node &node(Entity entity)
+    {
+        assert(contains(entity) && "Entity is not in the hierarchy");
+        return mNodes[entityIndex(entity)];
+    }
+
+    // appends the node to the level at depth, dirty
+    void pushToLevel(Entity entity, std::uint32_t depth, Position local, Position world);
+
+    // swap-and-pop out of its level, the children of the node taking its place get their parent index fixed
+    void removeFromLevel(Entity entity);
+
+    void link(Entity child, Entity parent);
+
+    void unlink(Entity child);
+
+    // moves the subtree of root to the levels below depth, the root getting the given local position
+    void moveSubtree(Entity root, std::uint32_t depth, Position local);
+
+    static bool samePosition(Position first, Position second) { return first.x == second.x && first.y == second.y; }
+
+    ResourceVector<Node> mNodes;
+    ResourceVector<Level> mLevels;
+    size_t mSize{};
+
+    // dirty nodes across every level
+    size_t mDirtyCount{};
+
+    // numbers the propagate passes, 0 is never one
+    std::uint32_t mPass{};
+
+    // the nodes of a subtree being moved, kept to avoid reallocating
+    ResourceVector<Entity> mSubtreeScratch;
+};
+
+template <typename Func>
+size_t TransformHierarchy::propagate(Func &&moved)
+{
+    ++mPass;
+    size_t movedCount = 0;
+    size_t movedAbove = 0;
+
+    for (size_t depth = 0; depth < mLevels.size(); ++depth)
+    {
+        // nothing left to do once a level moved nothing and no dirty node remains further down
+        if (depth > 0 && movedAbove == 0 && mDirtyCount == 0)
+        {
+            break;
+        }
+
+        Level &level = mLevels[depth];
+        size_t movedHere = 0;
+        if (depth == 0)
+        {
+            for (size_t index = 0; index < level.entities.size(); ++index)
+            {
+                if (!level.dirty[index])
+                {
+                    continue;
+                }
+                level.dirty[index] = 0;
+                if (!samePosition(level.world[index], level.local[index]))
+                {
+                    level.world[index] = level.local[index];
+                    level.movedPass[index] = mPass;
+                    moved(level.entities[index], level.world[index]);
+                    ++movedHere;
+                }
+            }
+        }
+        else if (movedAbove > 0 || level.dirtyCount > 0)
+        {
+            const Level &above = mLevels[depth - 1];
+            for (size_t index = 0; index < level.entities.size(); ++index)
+            {
+                std::uint32_t parent = level.parents[index];
+                if (!level.dirty[index] && above.movedPass[parent] != mPass)
+                {
+                    continue;
+                }
+                level.dirty[index] = 0;
+                Position world{above.world[parent].x + level.local[index].x,
+                               above.world[parent].y + level.local[index].y};
+                if (!samePosition(level.world[index], world))
+                {
+                    level.world[index] = world;
+                    level.movedPass[index] = mPass;
+                    moved(level.entities[index], world);
+                    ++movedHere;
+                }
+            }
+        }
+
+        mDirtyCount -= level.dirtyCount;
+        level.dirtyCount = 0;
+        movedAbove = movedHere;
+        movedCount += movedHere;
+    }
+    return movedCount;
+}
+
+/** keeps the Position of every entity of a TransformHierarchy in line with its parents: a root's Position
+ * is read as its world position every update (it may be moved by anything, e.g. the MovementSystem), a
+ * child's Position is written by the system and should not be moved by anything else, so children are
+ * best left without a Velocity. Changes are seen at the next update and the moved Positions are recorded
+ * as changed when Position tracks changes.
+ * The structural calls (setParent, clearParent, remove) attach or detach HierarchyNode, so they must not
+ * be made while the systems run. An entity destroyed or losing its Position leaves the hierarchy at the
+ * next update, its children becoming roots */
+class HierarchySystem : public System
+{
+public:
+    // sets the system's signature and access, must be called once the system, Position and HierarchyNode are
+    // registered. The hierarchy is allocated from the world's memory
+    void init(Game &game);
+
+    void update() override;
+
+    // puts child under parent at the given offset, adding either to the hierarchy as a root if needed
+    void setParent(Entity child, Entity parent, Position offset);
+
+    // makes the entity a root where it stands, nothing for an entity outside of the hierarchy
+    void clearParent(Entity entity);
+
+    void setOffset(Entity entity, Position offset);
+
+    // takes the entity out of the hierarchy, its children become roots where they stand
+    void remove(Entity entity);
+
+    // NULL_ENTITY for a root or an entity outside of the hierarchy
+    Entity getParent(Entity entity) const
+    {
+        return mHierarchy.contains(entity) ? mHierarchy.getParent(entity) : NULL_ENTITY;
+    }
+
+    const TransformHierarchy &getHierarchy() const { return mHierarchy; }
+
+private:
+    // drops the nodes whose entity left the system, i.e. was destroyed or lost a component
+    void prune();
+
+    void addRoot(Entity entity);
+
+    Game *mGame{};
+
+    TransformHierarchy mHierarchy;
+
+    // nodes found gone by prune
+    std::vector<Entity> mGone;
+};
@@ -0,0 +1,185 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <type_traits>
+#include <vector>
+
+#include "Signature.hpp"
+
+// largest block the world's pool recycles, bigger ones go straight to the heap. Covers a component page
+// of components up to 256 bytes
+const size_t WORLD_POOL_LARGEST_BLOCK = 256 * 1024;
+
+/** an allocator drawing from a std::pmr::memory_resource, like std::pmr::polymorphic_allocator, but one that
+ * follows its container on move assignment and swap: a container built before its owner knew the world's
+ * resource can still be moved onto it. A copy starts on the default resource, like a polymorphic_allocator */
+template <typename T>
+class ResourceAllocator
+{
+public:
+    using value_type = T;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+
+    ResourceAllocator() noexcept
+        : mResource(std::pmr::get_default_resource())
+    {
+    }
+
+    ResourceAllocator(std::pmr::memory_resource *resource) noexcept
+        : mResource(resource)
+    {
+    }
+
+    template <typename U>
+    ResourceAllocator(const ResourceAllocator<U> &other) noexcept
+        : mResource(other.resource())
+    {
+    }
+
+    T *allocate(size_t count) { return static_cast<T *>(mResource->allocate(count * sizeof(T), alignof(T))); }
+
+    void deallocate(T *pointer, size_t count) { mResource->deallocate(pointer, count * sizeof(T), alignof(T)); }
+
+    std::pmr::memory_resource *resource() const { return mResource; }
+
+    ResourceAllocator select_on_container_copy_construction() const { return ResourceAllocator(); }
+
+    template <typename U>
+    bool operator==(const ResourceAllocator<U> &other) const
+    {
+        return mResource == other.resource() || mResource->is_equal(*other.resource());
+    }
+
+    template <typename U>
+    bool operator!=(const ResourceAllocator<U> &other) const
+    {
+        return !(*this == other);
+    }
+
+private:
+    std::pmr::memory_resource *mResource;
+};
+
+template <typename T>
+using ResourceVector = std::vector<T, ResourceAllocator<T>>;
+
+// what went through a CountingResource, every field only ever grows but bytesInUse
+struct AllocationCounters
+{
+    std::uint64_t allocations;
+    std::uint64_t deallocations;
+    std::uint64_t bytesAllocated;
+    std::uint64_t bytesInUse;
+    std::uint64_t peakBytesInUse;
+};
+
+/** forwards to an upstream resource and counts what goes through it. The counters are atomic, it can
+ * sit under a resource shared by several threads */
+class CountingResource : public std::pmr::memory_resource
+{
+public:
+    explicit CountingResource(std::pmr::memory_resource *upstream = std::pmr::new_delete_resource())
+        : mUpstream(upstream)
+    {
+    }
+
+    AllocationCounters getCounters() const;
+
+private:
+    void *do_allocate(size_t bytes, size_t alignment) override;
+
+    void do_deallocate(void *pointer, size_t bytes, size_t alignment) override;
+
+    bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override { return this == &other; }
+
+    std::pmr::memory_resource *mUpstream;
+
+    std::atomic<std::uint64_t> mAllocations{};
+    std::atomic<std::uint64_t> mDeallocations{};
+    std::atomic<std::uint64_t> mBytesAllocated{};
+    std::atomic<std::uint64_t> mBytesInUse{};
+    std::atomic<std::uint64_t> mPeakBytesInUse{};
+};
+
+/** the memory of one world: every pool, entity set, entity table, system, archetype, event queue and
+ * command buffer of it is allocated here, along with the containers they hold and the scratch space of
+ * Game::FlushCommands. Left on the heap: the managers and the thread pool themselves, the registration
+ * tables of the managers (component types, groups, system lists and dependencies) and the captures of
+ * observers too big for std::function to store inline. Blocks come from a synchronized pool resource that
+ * keeps freed blocks for the next request of the same size, so a world whose sizes stay put stops reaching
+ * the heap. Two counting layers tell apart the requests the ECS makes (getRequests) from the ones the pool
+ * forwards to the heap (getHeap) */
+class WorldMemory
+{
+public:
+    explicit WorldMemory(std::pmr::memory_resource *upstream = std::pmr::new_delete_resource());
+
+    WorldMemory(const WorldMemory &) = delete;
+    WorldMemory &operator=(const WorldMemory &) = delete;
+
+    std::pmr::memory_resource *getResource() { return &mRequests; }
+
+    AllocationCounters getRequests() const { return mRequests.getCounters(); }
+
+    AllocationCounters getHeap() const { return mHeap.getCounters(); }
+
+    // frames are delimited by Game::UpdateSystems, the counts cover the whole of the last one
+    void beginFrame();
+
+    void endFrame();
+
+    std::uint64_t getLastFrameAllocations() const { return mLastFrameAllocations; }
+
+    std::uint64_t getLastFrameHeapAllocations() const { return mLastFrameHeapAllocations; }
+
+private:
+    CountingResource mHeap;
+    std::pmr::synchronized_pool_resource mPool;
+    CountingResource mRequests;
+
+    std::uint64_t mFrameStartAllocations{};
+    std::uint64_t mFrameStartHeapAllocations{};
+    std::uint64_t mLastFrameAllocations{};
+    std::uint64_t mLastFrameHeapAllocations{};
+};
+
+// bytes held by a container or pool (reserved) and the part of them holding live data (used)
+struct MemoryUsage
+{
+    size_t reservedBytes;
+    size_t usedBytes;
+};
+
+struct ComponentPoolMemory
+{
+    ComponentTypeBitPosition bit;
+    size_t componentSize;
+    size_t count;
+    MemoryUsage usage;
+};
+
+struct SystemSetMemory
+{
+    // the system's name, as the profiler knows it
+    const char *name;
+    size_t count;
+    MemoryUsage usage;
+};
+
+/** a world's memory, see Game::GetMemoryStats. Pools, system sets and the entity table are measured from
+ * their containers; requests / heap are the counters of the world's WorldMemory, lastFrame* those of the
+ * last UpdateSystems */
+struct MemoryStats
+{
+    std::vector<ComponentPoolMemory> pools;
+    std::vector<SystemSetMemory> systems;
+    MemoryUsage entityTable;
+    AllocationCounters requests;
+    AllocationCounters heap;
+    std::uint64_t lastFrameAllocations;
+    std::uint64_t lastFrameHeapAllocations;
+};
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+#include "Game.hpp"
+#include "Simd.hpp"
+#include "System.hpp"
+#include "Transform.hpp"
+
+// seconds advanced by one MovementSystem update until told otherwise
+const float DEFAULT_TIME_STEP = 1.0f / 60.0f;
+
+/** semi-implicit Euler over count bodies stored back to back:
+ * velocity += acceleration * dt, then position += velocity * dt.
+ * x and y get the same treatment, so the three arrays are streamed as flat float arrays.
+ * Runs with the widest of AVX2 / SSE2 / scalar the CPU supports. Every level does a multiply then an add,
+ * so they agree bit for bit as long as the build does not contract those into fused multiply-adds */
+void integrateMotion(Position *positions, Velocity *velocities, const Acceleration *accelerations, size_t count,
+                     float dt);
+
+// same, with a given instruction set (capped to what the CPU supports), to compare the paths
+void integrateMotion(Position *positions, Velocity *velocities, const Acceleration *accelerations, size_t count,
+                     float dt, SimdLevel level);
+
+/** integrates every entity owning a Position, a Velocity and an Acceleration
+ * (attach a zero Acceleration for constant velocity).
+ * With the sparse set backend init claims the group of the three pools (see Game::Group), which keeps the
+ * system's entities at the front of each pool in the same order: their pages line up and every page is
+ * handed to integrateMotion as three plain arrays. A pool belongs to one group at most, so:
+ * - a game that groups some of these pools itself (e.g. Group<Position, Velocity>) must do it before init,
+ *   the system then keeps away from them and integrates entity by entity through a view
+ * - once init claimed the group, asking for another group over any of the three pools asserts
+ * With the archetype backend the columns of a chunk already line up.
+ * Pages are spread over the world's thread pool when there is one. Every integrated Position and Velocity
+ * is recorded as changed when their pool tracks changes */
+class MovementSystem : public System
+{
+public:
+    // sets the system's signature and access,
+    // must be called once the system and the three components are registered
+    void init(Game &game);
+
+    void update() override;
+
+    void setTimeStep(float dt) { mTimeStep = dt; }
+
+    float getTimeStep() const { return mTimeStep; }
+
+private:
+    Game *mGame{};
+
+    float mTimeStep{DEFAULT_TIME_STEP};
+
+    // set with the sparse set backend, unless one of the pools was already owned by another group
+    std::optional<OwningGroup<Position, Velocity, Acceleration>> mGroup;
+};
@@ -0,0 +1,159 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <set>
+#include <string>
+#include <vector>
+
+// number of frames the rolling frame statistics are computed over
+const size_t PROFILER_FRAME_HISTORY = 300;
+
+// scopes a thread keeps per capture (1.5 MiB of events), the ones past it are dropped and counted
+const size_t PROFILER_MAX_EVENTS_PER_THREAD = 64 * 1024;
+
+// frame durations over the last PROFILER_FRAME_HISTORY frames, in milliseconds
+struct FrameStats
+{
+    size_t frameCount;
+    double p50;
+    double p99;
+    double max;
+};
+
+/** collects timed scopes (see ProfileScope) and frame durations for the whole process.
+ * - every thread records into a buffer of its own, a scope costs two clock reads and a push_back
+ * - scopes are only kept while capturing, so a release build pays a branch per scope when idle
+ * - a thread's buffer is reserved for PROFILER_MAX_EVENTS_PER_THREAD events when it registers, so
+ *   capturing never allocates. A capture keeps the first scopes of each thread up to that cap and counts
+ *   the ones past it (getDroppedEvents) until the next clear
+ * - frame durations are always kept, in a ring of the last PROFILER_FRAME_HISTORY frames
+ * - the captured scopes can be exported as Chrome trace events (chrome://tracing, Perfetto)
+ * writeChromeTrace and clear must not run while other threads are inside a scope, call them between frames */
+class Profiler
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    static Profiler &get();
+
+    Profiler(const Profiler &) = delete;
+    Profiler &operator=(const Profiler &) = delete;
+
+    void setCapturing(bool capturing) { mCapturing.store(capturing, std::memory_order_relaxed); }
+
+    bool isCapturing() const { return mCapturing.load(std::memory_order_relaxed); }
+
+    // records a finished scope on the calling thread's buffer, name must outlive the profiler (see intern)
+    void record(const char *name, Clock::time_point begin, Clock::time_point end);
+
+    // brackets one frame, its duration feeds the frame statistics and shows up as a "frame" scope
+    void beginFrame();
+    void endFrame();
+
+    FrameStats getFrameStats() const;
+
+    // a copy of name that lives as long as the profiler, for scope names built at runtime
+    const char *intern(const std::string &name);
+
+    // writes every captured scope as a Chrome trace event JSON document
+    void writeChromeTrace(std::ostream &out) const;
+
+    // same, into a file. Returns false when the file cannot be written
+    bool writeChromeTrace(const std::string &path) const;
+
+    // scopes dropped by full buffers since the last clear, over every thread
+    size_t getDroppedEvents() const;
+
+    // drops the captured scopes and the dropped count, the buffers keep their capacity
+    void clear();
+
+private:
+    Profiler();
+
+    struct Event
+    {
+        const char *name;
+        // nanoseconds since the profiler was created
+        std::int64_t begin;
+        std::int64_t duration;
+    };
+
+    struct ThreadBuffer
+    {
+        std::uint32_t threadIndex;
+        // reserved for PROFILER_MAX_EVENTS_PER_THREAD, never grows past it
+        std::vector<Event> events;
+        size_t dropped{};
+    };
+
+    // the calling thread's buffer, registered the first time the thread records something
+    ThreadBuffer &threadBuffer();
+
+    std::int64_t sinceEpoch(Clock::time_point time) const
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(time - mEpoch).count();
+    }
+
+    Clock::time_point mEpoch;
+
+    std::atomic<bool> mCapturing{false};
+
+    // guards the registration of thread buffers and the interned names
+    std::mutex mMutex;
+    std::vector<std::unique_ptr<ThreadBuffer>> mThreadBuffers;
+    std::set<std::string> mNames;
+
+    Clock::time_point mFrameBegin;
+    // ring of the last frame durations in milliseconds
+    std::vector<double> mFrameTimes;
+    size_t mNextFrame{};
+    mutable std::vector<double> mSortedFrameTimes;
+};
+
+/** times the enclosing scope, e.g.
+ *     { ProfileScope scope("physics"); ... }
+ * name must outlive the profiler: a string literal or a name from Profiler::intern */
+class ProfileScope
+{
+public:
+    explicit ProfileScope(const char *name)
+        : mName(Profiler::get().isCapturing() ? name : nullptr)
+    {
+        if (mName)
+        {
+            mBegin = Profiler::Clock::now();
+        }
+    }
+
+    ProfileScope(const ProfileScope &) = delete;
+    ProfileScope &operator=(const ProfileScope &) = delete;
+
+    ~ProfileScope()
+    {
+        if (mName)
+        {
+            Profiler::get().record(mName, mBegin, Profiler::Clock::now());
+        }
+    }
+
+private:
+    // nullptr when the profiler was not capturing as the scope opened
+    const char *mName;
+    Profiler::Clock::time_point mBegin;
+};
+
+// scoped markers compile away entirely with ECS_PROFILING_DISABLED
+#define ECS_PROFILE_CONCAT_INNER(a, b) a##b
+#define ECS_PROFILE_CONCAT(a, b) ECS_PROFILE_CONCAT_INNER(a, b)
+
+#if defined(ECS_PROFILING_DISABLED)
+#define ECS_PROFILE_SCOPE(name)
+#else
+#define ECS_PROFILE_SCOPE(name) ProfileScope ECS_PROFILE_CONCAT(profileScope, __LINE__)(name)
+#endif
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Assets.hpp"
+#include "Game.hpp"
+#include "System.hpp"
+#include "Transform.hpp"
+
+#if defined(ECS_WITH_SFML)
+#include <SFML/Graphics/RenderStates.hpp>
+#include <SFML/Graphics/RenderTarget.hpp>
+#include <SFML/Graphics/Texture.hpp>
+#endif
+
+// color of a sprite that is not tinted, 0xRRGGBBAA
+const std::uint32_t SPRITE_WHITE = 0xffffffffu;
+
+// vertices per sprite, two triangles
+const size_t SPRITE_VERTEX_COUNT = 6;
+
+/** a textured rectangle centered on the entity's Position.
+ * texture is the index of the texture in the list handed to the renderer, an atlas page for sprites cut
+ * out of an AssetCache (see makeSprite). Sprites are drawn by increasing layer, and within a layer in no
+ * particular order across textures */
+struct Sprite
+{
+    std::uint32_t texture;
+    // rectangle of the texture, in pixels
+    float textureX;
+    float textureY;
+    float textureWidth;
+    float textureHeight;
+    // size in world units
+    float width;
+    float height;
+    std::int16_t layer;
+    std::uint32_t color;
+};
+
+// a sprite showing the texture's atlas region, scale world units per pixel. The texture must be packed
+inline Sprite makeSprite(const TextureAsset &texture, std::int16_t layer = 0, float scale = 1.0f)
+{
+    const AtlasRegion &region = texture.getRegion();
+    return {region.page,
+            static_cast<float>(region.x),
+            static_cast<float>(region.y),
+            static_cast<float>(region.width),
+            static_cast<float>(region.height),
+            static_cast<float>(region.width) * scale,
+            static_cast<float>(region.height) * scale,
+            layer,
+            SPRITE_WHITE};
+}
+
+// laid out like sf::Vertex so a batch is handed to SFML as is
+struct SpriteVertex
+{
+    float x;
+    float y;
+    std::uint8_t r;
+    std::uint8_t g;
+    std::uint8_t b;
+    std::uint8_t a;
+    // in pixels of the texture
+    float u;
+    float v;
+};
+
+// a run of the vertex buffer sharing a layer and a texture, one draw call
+struct SpriteBatch
+{
+    std::int16_t layer;
+    std::uint32_t texture;
+    std::uint32_t firstVertex;
+    std::uint32_t vertexCount;
+};
+
+/** turns every entity owning a Position and a Sprite into batches of triangles, one per (layer, texture)
+ * run, so the draw calls grow with the number of textures rather than the number of sprites.
+ * - update() only builds the batches, it needs no display and can run with the other systems
+ * - the sprites are ordered by a radix sort on their (layer, texture) key, which keeps them in pool order
+ *   within a batch and skips the key bytes every sprite agrees on
+ * - the vertex buffer and the sort's arrays are kept from one frame to the next and only ever grow
+ * The world is y up: the top edge of a sprite (largest y) shows the top row of its texture rectangle, so the
+ * sf::View drawing it should flip y */
+class SpriteRenderSystem : public System
+{
+public:
+    // sets the system's signature and access, must be called once the system and both components are registered
+    void init(Game &game);
+
+    void update() override;
+
+    // every batch in draw order, as of the last update
+    const std::vector<SpriteBatch> &getBatches() const { return mBatches; }
+
+    // the vertices of every batch, getVertexCount() of them are in use
+    const SpriteVertex *getVertices() const { return mVertices.data(); }
+
+    size_t getVertexCount() const { return mVertexCount; }
+
+#if defined(ECS_WITH_SFML)
+    // one draw call per batch, textures[i] being the texture a Sprite refers to as i
+    void draw(sf::RenderTarget &target, const std::vector<sf::Texture> &textures,
+              sf::RenderStates states = sf::RenderStates::Default) const;
+#endif
+
+private:
+    // sorts mKeys, and mOrder along with them, least significant byte first
+    void radixSort();
+
+    Game *mGame{};
+
+    // the sprites and positions of the frame, gathered from the pools in one pass
+    std::vector<Sprite> mSprites;
+    std::vector<Position> mPositions;
+
+    // (layer, texture) of every sprite, the layer above the whole 32 bit texture
+    std::vector<std::uint64_t> mKeys;
+    // index into mSprites of the sprite at the same position of mKeys
+    std::vector<std::uint32_t> mOrder;
+    std::vector<std::uint64_t> mKeyScratch;
+    std::vector<std::uint32_t> mOrderScratch;
+
+    std::vector<SpriteVertex> mVertices;
+    size_t mVertexCount{};
+    std::vector<SpriteBatch> mBatches;
+};
@@ -0,0 +1,257 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+#include "Simd.hpp"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// number of component types a world can register, picked when the engine is compiled.
+// Every signature of the world is this wide, 64 / 128 / 256 map onto a register / an SSE / an AVX lane
+#ifndef ECS_SIGNATURE_BITS
+#define ECS_SIGNATURE_BITS 64
+#endif
+
+// index of the lowest set bit of a non-zero word
+inline unsigned lowestSetBit(std::uint64_t word)
+{
+#if defined(_MSC_VER)
+    unsigned long bit;
+    _BitScanForward64(&bit, word);
+    return static_cast<unsigned>(bit);
+#else
+    return static_cast<unsigned>(__builtin_ctzll(word));
+#endif
+}
+
+inline unsigned popCount(std::uint64_t word)
+{
+#if defined(_MSC_VER)
+    return static_cast<unsigned>(__popcnt64(word));
+#else
+    return static_cast<unsigned>(__builtin_popcountll(word));
+#endif
+}
+
+/** a fixed-width set of component bits, laid out as plain 64 bit words.
+ * Same interface as the std::bitset it replaces (set / reset / test / none / any / bitwise ops),
+ * but the words are reachable and the whole thing is aligned to its own size (up to 32 bytes),
+ * so a packed array of signatures can be matched a SIMD register at a time, see matchSignatures */
+template <size_t Bits>
+class alignas(Bits / 8 < 32 ? Bits / 8 : 32) BasicSignature
+{
+    static_assert(Bits == 64 || Bits == 128 || Bits == 256, "Signature width must be 64, 128 or 256 bits");
+
+public:
+    static constexpr size_t WORD_BITS = 64;
+    static constexpr size_t WORD_COUNT = Bits / WORD_BITS;
+
+    constexpr size_t size() const { return Bits; }
+
+    BasicSignature &set(size_t position, bool value = true)
+    {
+        assert(position < Bits && "Bit position out of range");
+        std::uint64_t mask = std::uint64_t{1} << (position % WORD_BITS);
+        if (value)
+        {
+            mWords[position / WORD_BITS] |= mask;
+        }
+        else
+        {
+            mWords[position / WORD_BITS] &= ~mask;
+        }
+        return *this;
+    }
+
+    BasicSignature &reset()
+    {
+        for (std::uint64_t &word : mWords)
+        {
+            word = 0;
+        }
+        return *this;
+    }
+
+    BasicSignature &reset(size_t position) { return set(position, false); }
+
+    bool test(size_t position) const
+    {
+        assert(position < Bits && "Bit position out of range");
+        return (mWords[position / WORD_BITS] >> (position % WORD_BITS)) & 1;
+    }
+
+    bool any() const
+    {
+        std::uint64_t bits = 0;
+        for (std::uint64_t word : mWords)
+        {
+            bits |= word;
+        }
+        return bits != 0;
+    }
+
+    bool none() const { return !any(); }
+
+    size_t count() const
+    {
+        size_t bits = 0;
+        for (std::uint64_t word : mWords)
+        {
+            bits += popCount(word);
+        }
+        return bits;
+    }
+
+    std::uint64_t word(size_t index) const { return mWords[index]; }
+
+    const std::uint64_t *words() const { return mWords; }
+
+    BasicSignature &operator&=(const BasicSignature &other)
+    {
+        for (size_t index = 0; index < WORD_COUNT; ++index)
+        {
+            mWords[index] &= other.mWords[index];
+        }
+        return *this;
+    }
+
+    BasicSignature &operator|=(const BasicSignature &other)
+    {
+        for (size_t index = 0; index < WORD_COUNT; ++index)
+        {
+            mWords[index] |= other.mWords[index];
+        }
+        return *this;
+    }
+
+    BasicSignature &operator^=(const BasicSignature &other)
+    {
+        for (size_t index = 0; index < WORD_COUNT; ++index)
+        {
+            mWords[index] ^= other.mWords[index];
+        }
+        return *this;
+    }
+
+    BasicSignature operator~() const
+    {
+        BasicSignature result;
+        for (size_t index = 0; index < WORD_COUNT; ++index)
+        {
+            result.mWords[index] = ~mWords[index];
+        }
+        return result;
+    }
+
+    friend BasicSignature operator&(const BasicSignature &lhs, const BasicSignature &rhs)
+    {
+        return BasicSignature(lhs) &= rhs;
+    }
+
+    friend BasicSignature operator|(const BasicSignature &lhs, const BasicSignature &rhs)
+    {
+        return BasicSignature(lhs) |= rhs;
+    }
+
+    friend BasicSignature operator^(const BasicSignature &lhs, const BasicSignature &rhs)
+    {
+        return BasicSignature(lhs) ^= rhs;
+    }
+
+    friend bool operator==(const BasicSignature &lhs, const BasicSignature &rhs)
+    {
+        for (size_t index = 0; index < WORD_COUNT; ++index)
+        {
+            if (lhs.mWords[index] != rhs.mWords[index])
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    friend bool operator!=(const BasicSignature &lhs, const BasicSignature &rhs) { return !(lhs == rhs); }
+
+    // whether every bit of subset is also set here
+    bool contains(const BasicSignature &subset) const
+    {
+        for (size_t index = 0; index < WORD_COUNT; ++index)
+        {
+            if ((mWords[index] & subset.mWords[index]) != subset.mWords[index])
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // whether no bit is set in both
+    bool disjoint(const BasicSignature &other) const
+    {
+        for (size_t index = 0; index < WORD_COUNT; ++index)
+        {
+            if (mWords[index] & other.mWords[index])
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+private:
+    std::uint64_t mWords[WORD_COUNT]{};
+};
+
+namespace std
+{
+    template <size_t Bits>
+    struct hash<BasicSignature<Bits>>
+    {
+        size_t operator()(const BasicSignature<Bits> &signature) const
+        {
+            std::uint64_t seed = 0;
+            for (size_t index = 0; index < BasicSignature<Bits>::WORD_COUNT; ++index)
+            {
+                seed ^= signature.word(index) + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2);
+            }
+            return static_cast<size_t>(seed);
+        }
+    };
+}
+
+// This represents the bit position in "Signature" that a given component type has been assigned to
+using ComponentTypeBitPosition = std::uint16_t;
+const ComponentTypeBitPosition MAX_COMPONENTS = ECS_SIGNATURE_BITS;
+
+// This represents the type of comppnent that is "attached" to an entity
+using Signature = BasicSignature<MAX_COMPONENTS>;
+
+// invokes func(bitPosition) for every bit set in the signature, lowest first
+template <typename Func>
+void forEachSetBit(const Signature &signature, Func &&func)
+{
+    for (size_t index = 0; index < Signature::WORD_COUNT; ++index)
+    {
+        std::uint64_t bits = signature.word(index);
+        while (bits)
+        {
+            func(static_cast<ComponentTypeBitPosition>(index * Signature::WORD_BITS + lowestSetBit(bits)));
+            bits &= bits - 1;
+        }
+    }
+}
+
+/** writes the position of every signature of [signatures, signatures + count) that has all the
+ * bits of include and none of exclude into out (which must have room for count), returns how many.
+ * Runs with the widest of AVX2 / SSE2 / scalar the CPU supports */
+size_t matchSignatures(const Signature *signatures, size_t count, const Signature &include,
+                       const Signature &exclude, std::uint32_t *out);
+
+// same, with a given instruction set (capped to what the CPU supports), to compare the paths
+size_t matchSignatures(const Signature *signatures, size_t count, const Signature &include,
+                       const Signature &exclude, std::uint32_t *out, SimdLevel level);
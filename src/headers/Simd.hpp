@@ -0,0 +1,31 @@
+#pragma once
+
+// the x86-64 kernels are compiled whatever the build targets and picked at runtime,
+// ECS_TARGET_AVX2 lets a single function use AVX2 without building the whole engine for it.
+// Kernel translation units include <immintrin.h> themselves under ECS_SIMD_X86
+#if defined(__x86_64__) || defined(_M_X64)
+#define ECS_SIMD_X86 1
+#endif
+
+#if defined(ECS_SIMD_X86) && !defined(_MSC_VER)
+#define ECS_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define ECS_TARGET_AVX2
+#endif
+
+// instruction sets the engine has kernels for, widest last
+enum class SimdLevel
+{
+    Scalar,
+    SSE2,
+    AVX2
+};
+
+// the widest level this CPU supports, detected once
+SimdLevel getSimdLevel();
+
+// the requested level, capped to what this CPU supports
+inline SimdLevel clampSimdLevel(SimdLevel level)
+{
+    return level > getSimdLevel() ? getSimdLevel() : level;
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+#include "Component.hpp"
+#include "Entity.hpp"
+#include "System.hpp"
+
+/** binary snapshot of a world, written by Game::SaveSnapshot and read back by Game::LoadSnapshot.
+ *
+ * layout, every section starts on a SNAPSHOT_ALIGNMENT boundary of the file:
+ * - SnapshotHeader
+ * - the EntityManager's slot table (Entity per slot) and signature table (Signature per slot)
+ * - a SnapshotPool descriptor per component pool
+ * - per pool: its packed entities, then its packed components exactly as they sit in memory
+ *
+ * sections are raw memory in the writer's byte order, so a snapshot is only meant to be read back by
+ * the same build (the header's signature width and every pool's type hash and size are checked).
+ * Only trivially copyable components can be saved, and only with the sparse set backend */
+const std::uint32_t SNAPSHOT_VERSION = 1;
+
+const size_t SNAPSHOT_ALIGNMENT = 64;
+
+// first bytes of every snapshot file
+const char SNAPSHOT_MAGIC[8] = {'E', 'C', 'S', 'S', 'N', 'A', 'P', '\0'};
+
+struct SnapshotHeader
+{
+    char magic[8];
+    std::uint32_t version;
+    // MAX_COMPONENTS of the writer, which is the size of a Signature
+    std::uint32_t signatureBits;
+
+    std::uint32_t slotCount;
+    std::uint32_t livingCount;
+    Entity freeListHead;
+    std::uint32_t poolCount;
+
+    // every offset is from the start of the file
+    std::uint64_t slotsOffset;
+    std::uint64_t signaturesOffset;
+    std::uint64_t poolsOffset;
+    std::uint64_t fileSize;
+};
+
+struct SnapshotPool
+{
+    // typeNameHash of the component type, the pool is loaded into the type at the same bit position
+    std::uint64_t typeHash;
+    std::uint32_t componentSize;
+    ComponentTypeBitPosition bit;
+    std::uint16_t reserved;
+
+    std::uint64_t count;
+    std::uint64_t entitiesOffset;
+    std::uint64_t componentsOffset;
+};
+
+/** read only view of a whole file: mapped where the platform can (mmap / MapViewOfFile),
+ * read into an aligned buffer otherwise */
+class MappedFile
+{
+public:
+    explicit MappedFile(const std::string &path);
+
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    bool isOpen() const { return mData != nullptr; }
+
+    const std::uint8_t *data() const { return mData; }
+
+    size_t size() const { return mSize; }
+
+private:
+    const std::uint8_t *mData{};
+    size_t mSize{};
+
+    // whether mData is a mapping rather than a buffer of our own
+    bool mMapped{};
+#if defined(_WIN32)
+    void *mFile{};
+    void *mMapping{};
+#endif
+};
+
+// writes the world's entities and pools. Returns false when a non empty pool holds a non trivially
+// copyable component, when the world uses the archetype backend, or when the stream fails
+bool writeSnapshot(std::ostream &out, const EntityManager &entityManager, const ComponentManager &componentManager);
+
+// replaces the world's entities, pools and system memberships with the snapshot's. The snapshot is
+// validated before anything is touched: header and section bounds, component types, the slot table and its
+// free list, and pools listing exactly the living entities whose signature has their bit. On false (bad
+// file, or the world registered different component types) the world is left as it was
+bool readSnapshot(const std::uint8_t *data, size_t size, EntityManager &entityManager,
+                  ComponentManager &componentManager, SystemManager &systemManager);
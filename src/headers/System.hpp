@@ -1,24 +1,39 @@
 #pragma once
 
-#include <set>
+#include <array>
+#include <atomic>
 #include <memory>
 #include <cassert>
-#include <typeindex>
-#include <typeinfo>
-#include <unordered_map>
+#include <vector>
 
 #include "Entity.hpp"
+#include "EntitySet.hpp"
 #include "Component.hpp"
+#include "Profiler.hpp"
+#include "ThreadPool.hpp"
+#include "TypeIndex.hpp"
 
-// alias for clarity
-using SystemTypeID = std::type_index;
+// component types a system only reads, see Game::SetSystemAccess
+template <typename... Ts>
+struct Reads
+{
+};
+
+// component types a system writes, see Game::SetSystemAccess
+template <typename... Ts>
+struct Writes
+{
+};
 
 /** a virtual base class for all system */
 class System
 {
 public:
+    virtual ~System() = default;
+
     // a set of entity that is eligible to be processed with said system
-    std::set<Entity> mEntities;
+    // packed sparse set: iterating it is a linear walk, membership changes are constant time
+    EntitySet mEntities;
 
     virtual void update() = 0;
 };
@@ -27,24 +42,151 @@ public:
 class SystemManager
 {
 public:
+    // the systems and their entity sets are allocated from the resource
+    explicit SystemManager(std::pmr::memory_resource *resource = std::pmr::get_default_resource())
+        : mResource(resource)
+    {
+    }
+
     // registering a new type of system into the ECS system
     // must be invoked to validate a system type
     template <typename T>
-    std::shared_ptr<T> registerSystem(Signature signature);
+    std::shared_ptr<T> registerSystem(const Signature &signature)
+    {
+        size_t typeIndex = systemTypeIndex<T>();
+        if (typeIndex >= mSystemIndices.size())
+        {
+            mSystemIndices.resize(typeIndex + 1, NOT_REGISTERED);
+        }
+        assert(mSystemIndices[typeIndex] == NOT_REGISTERED && "System to register already exists");
+
+        auto system = std::allocate_shared<T>(ResourceAllocator<T>(mResource));
+        system->mEntities = EntitySet(mResource);
+        mSystems.push_back(system);
+        mSystemIndices[typeIndex] = mSystemList.size();
+        mSystemList.push_back({system.get(), signature, 0, Signature{}, Signature{}, false,
+                               Profiler::get().intern(typeName<T>())});
+
+        rebuildDispatchTable();
+        mScheduleDirty = true;
+
+        return system;
+    }
 
+    // entities already living are not re-evaluated, set the signature before creating entities
     template <typename T>
-    void setSignature(Signature signature);
+    void setSignature(const Signature &signature)
+    {
+        mSystemList[getSystemIndex<T>()].signature = signature;
+        rebuildDispatchTable();
+    }
+
+    // declares the component types the system reads and writes (bit positions, like a Signature)
+    // a system that never declares its access is assumed to write everything and runs alone
+    template <typename T>
+    void setAccess(const Signature &reads, const Signature &writes)
+    {
+        SystemRecord &record = mSystemList[getSystemIndex<T>()];
+        record.reads = reads;
+        record.writes = writes;
+        record.accessDeclared = true;
+        mScheduleDirty = true;
+    }
+
+    // runs every system once on the calling thread, in registration order.
+    // Every system's update is a profiler scope named after the system type
+    void update();
+
+    // runs every system once, systems whose declared accesses do not conflict run concurrently.
+    // Conflicting systems keep their registration order, so the result matches update()
+    void update(ThreadPool &pool);
 
     // a common interface to propagate changes to each ComponentArray when handling entity destruction event
-    void handleDestroyedEntity(Entity entity);
+    // entity_signature is the signature the entity had before it was destroyed
+    void handleDestroyedEntity(Entity entity, const Signature &entity_signature);
+
+    // add or remove entity from the set of every system whose interest overlaps the bits that changed
+    void handleEntitySignatureChanged(Entity entity, const Signature &old_signature,
+                                      const Signature &new_signature);
 
-    // add or remove entity from each system's set based on the entity and system's signature
-    void handleEntitySignatureChanged(Entity entity, Signature entity_signature);
+    // refills every system's set from scratch with a scan of the signature table, used once the
+    // entities were replaced wholesale (see Game::LoadSnapshot). Members keep the table's slot order
+    void rebuildMemberships(const EntityManager &entityManager);
+
+    size_t getSystemCount() const { return mSystemList.size(); }
+
+    // appends the memory of every system's entity set to out, in registration order
+    void getSystemMemory(std::vector<SystemSetMemory> &out) const;
 
 private:
-    // Map system type's ID (std::type_index) to its corresponding signature
-    std::unordered_map<SystemTypeID, Signature> mSignatures{};
+    struct SystemRecord
+    {
+        System *system;
+        Signature signature;
+        // stamp of the last signature change that visited this system, avoids visiting it twice
+        std::uint32_t visitStamp;
+        Signature reads;
+        Signature writes;
+        bool accessDeclared;
+        // profiler scope name of the system's update
+        const char *name;
+    };
 
-    // Map system type's ID (std::type_index) to pointers to system instances
-    std::unordered_map<SystemTypeID, std::shared_ptr<System>> mSystems{};
-};
\ No newline at end of file
+    // marks a system type index that has no system registered in this manager
+    static constexpr size_t NOT_REGISTERED = ~size_t{0};
+
+    // position of the system in mSystemList
+    template <typename T>
+    size_t getSystemIndex() const
+    {
+        size_t typeIndex = systemTypeIndex<T>();
+
+        assert(typeIndex < mSystemIndices.size() && mSystemIndices[typeIndex] != NOT_REGISTERED &&
+               "System used before registered.");
+
+        return mSystemIndices[typeIndex];
+    }
+
+    // recomputes mSystemsByComponent after a system or a system signature was added
+    void rebuildDispatchTable();
+
+    // whether two systems may not run at the same time
+    static bool conflicts(const SystemRecord &first, const SystemRecord &second);
+
+    // rebuilds the dependency graph used by the parallel update: a system depends on every
+    // earlier registered system it conflicts with
+    void buildSchedule();
+
+    // inserts or erases the entity from the system's set depending on whether the signatures match
+    void updateMembership(SystemRecord &record, Entity entity, const Signature &entity_signature);
+
+    std::pmr::memory_resource *mResource;
+
+    // owns the system instances, in registration order. Allocated from mResource
+    std::vector<std::shared_ptr<System>> mSystems{};
+
+    // maps a system's type index (systemTypeIndex<T>()) to its position in mSystemList
+    std::vector<size_t> mSystemIndices{};
+
+    // every system with its signature, in registration order
+    std::vector<SystemRecord> mSystemList{};
+
+    // for each component bit, the positions in mSystemList of the systems whose signature contains it
+    std::array<std::vector<size_t>, MAX_COMPONENTS> mSystemsByComponent{};
+
+    // systems with an empty signature, they are interested in every entity
+    std::vector<size_t> mSystemsWithoutComponents{};
+
+    std::uint32_t mVisitStamp{};
+
+    // for each system, the positions of the systems that have to wait for it
+    std::vector<std::vector<size_t>> mDependents{};
+
+    // for each system, the number of systems it has to wait for
+    std::vector<size_t> mDependencyCounts{};
+
+    // for each system, the number of systems it is still waiting for during a parallel update
+    std::unique_ptr<std::atomic<size_t>[]> mRemaining;
+
+    bool mScheduleDirty{true};
+};
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// what a task runs: run(context, begin, end)
+using TaskFunction = void (*)(void *context, size_t begin, size_t end);
+
+// tasks a queue holds before it has to grow, growing allocates but the room is kept for the next frames
+const size_t TASK_QUEUE_CAPACITY = 1024;
+
+/** a set of tasks that can be waited on together */
+class TaskGroup
+{
+public:
+    bool isDone() const { return mPending.load(std::memory_order_acquire) == 0; }
+
+private:
+    friend class ThreadPool;
+
+    std::atomic<size_t> mPending{0};
+};
+
+/** A fixed set of worker threads with one task deque each.
+ * - a worker pushes and pops the tasks it spawns at the back of its own deque (LIFO, cache warm)
+ * - an idle worker steals from the front of the other deques
+ * - a thread outside the pool submits into a shared deque every worker steals from
+ * - wait() does not block the caller, it keeps running tasks until the group is done
+ * A task is a plain record (function, context, range) and the deques are ring buffers allocated up front,
+ * so submitting does not allocate once the queues are large enough */
+class ThreadPool
+{
+public:
+    // workerCount = 0 is valid, every task then runs on the thread calling wait()
+    explicit ThreadPool(size_t workerCount = std::thread::hardware_concurrency());
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    // finishes every queued task before joining the workers
+    ~ThreadPool();
+
+    // queues run(context, begin, end). Nothing is copied, whatever context points to must outlive the task
+    void submit(TaskGroup &group, TaskFunction run, void *context, size_t begin = 0, size_t end = 0);
+
+    // runs queued tasks on the calling thread until every task of the group has completed
+    void wait(TaskGroup &group);
+
+    // splits [begin, end) into ranges of grainSize items and runs func(rangeBegin, rangeEnd) on each,
+    // returns once every range is done
+    template <typename Func>
+    void parallelFor(size_t begin, size_t end, size_t grainSize, Func &&func)
+    {
+        using Callable = std::remove_reference_t<Func>;
+        grainSize = grainSize > 0 ? grainSize : 1;
+
+        // every range points at the caller's func, which outlives them as wait() returns after the last one
+        void *context = const_cast<void *>(static_cast<const void *>(std::addressof(func)));
+        TaskFunction run = [](void *context, size_t rangeBegin, size_t rangeEnd)
+        { (*static_cast<Callable *>(context))(rangeBegin, rangeEnd); };
+
+        TaskGroup group;
+        for (size_t rangeBegin = begin; rangeBegin < end; rangeBegin += grainSize)
+        {
+            size_t rangeEnd = end - rangeBegin < grainSize ? end : rangeBegin + grainSize;
+            submit(group, run, context, rangeBegin, rangeEnd);
+        }
+        wait(group);
+    }
+
+    size_t getWorkerCount() const { return mThreads.size(); }
+
+private:
+    struct Task
+    {
+        TaskFunction run;
+        void *context;
+        size_t begin;
+        size_t end;
+        TaskGroup *group;
+    };
+
+    // a deque over a ring buffer whose capacity is a power of two, doubled when full
+    struct TaskQueue
+    {
+        TaskQueue() : tasks(TASK_QUEUE_CAPACITY) {}
+
+        void pushBack(const Task &task);
+
+        Task popBack()
+        {
+            --count;
+            return tasks[(head + count) & (tasks.size() - 1)];
+        }
+
+        Task popFront()
+        {
+            Task task = tasks[head];
+            head = (head + 1) & (tasks.size() - 1);
+            --count;
+            return task;
+        }
+
+        std::mutex mutex;
+        std::vector<Task> tasks;
+        // slot of the front task
+        size_t head{};
+        size_t count{};
+    };
+
+    // pops from the given queue's back, otherwise steals from the front of the others
+    bool tryRunTask(size_t queueIndex);
+
+    void workerLoop(size_t queueIndex);
+
+    // queue of the calling thread, the shared queue for threads outside the pool
+    size_t currentQueueIndex() const;
+
+    // one queue per worker followed by the shared queue for outside submitters
+    std::vector<std::unique_ptr<TaskQueue>> mQueues;
+
+    std::vector<std::thread> mThreads;
+
+    std::atomic<size_t> mQueuedTasks{0};
+
+    std::mutex mSleepMutex;
+
+    std::condition_variable mWakeCondition;
+
+    bool mStopping{false};
+};
@@ -0,0 +1,274 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "Entity.hpp"
+#include "Game.hpp"
+#include "Snapshot.hpp"
+#include "Transform.hpp"
+
+/** binary tile map split into square chunks that can be decoded independently, written by writeTileMap
+ * and streamed in by a TileMapStreamer.
+ *
+ * layout, every section starts on a TILE_MAP_ALIGNMENT boundary of the file:
+ * - TileMapHeader
+ * - a TileMapChunkEntry per chunk, row by row
+ * - per chunk: chunkSize * chunkSize tile ids row by row, then its TileMapObject spawns
+ *
+ * like snapshots, sections are raw memory in the writer's byte order */
+const std::uint32_t TILE_MAP_VERSION = 1;
+
+const size_t TILE_MAP_ALIGNMENT = 16;
+
+// first bytes of every tile map file
+const char TILE_MAP_MAGIC[8] = {'E', 'C', 'S', 'T', 'M', 'A', 'P', '\0'};
+
+// tile id of a cell with nothing in it, such cells spawn no entity
+const std::uint16_t EMPTY_TILE = 0;
+
+// tiles per chunk side when none is given
+const std::uint32_t DEFAULT_CHUNK_SIZE = 16;
+
+// a non empty cell of the map, spawned with a Position at the cell's lower left corner
+struct Tile
+{
+    std::uint16_t id;
+};
+
+// a spawn point of the map, e.g. an enemy. type means whatever the game wants it to mean
+struct MapObject
+{
+    std::uint32_t type;
+};
+
+struct TileMapHeader
+{
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t chunkSize;
+    std::uint32_t widthInChunks;
+    std::uint32_t heightInChunks;
+
+    // world position of the lower left corner of tile (0, 0), and world units per tile
+    float originX;
+    float originY;
+    float tileSize;
+    std::uint32_t reserved;
+
+    // every offset is from the start of the file
+    std::uint64_t chunksOffset;
+    std::uint64_t fileSize;
+};
+
+struct TileMapChunkEntry
+{
+    std::uint64_t offset;
+    // non empty tiles and object spawns of the chunk
+    std::uint32_t tileCount;
+    std::uint32_t objectCount;
+};
+
+struct TileMapObject
+{
+    std::uint32_t type;
+    // world position
+    float x;
+    float y;
+};
+
+/** a whole map in memory, the authoring side of the format. tiles are row by row from the bottom row,
+ * width * height of them. Neither dimension needs to be a multiple of the chunk size */
+struct TileMapData
+{
+    std::uint32_t width{};
+    std::uint32_t height{};
+    std::vector<std::uint16_t> tiles;
+    std::vector<TileMapObject> objects;
+
+    float originX{};
+    float originY{};
+    float tileSize{1.0f};
+};
+
+// splits the map into chunks of chunkSize * chunkSize tiles and writes it. Objects go to the chunk their
+// position falls in, clamped to the map. Returns false when the file cannot be written
+bool writeTileMap(const std::string &path, const TileMapData &map, std::uint32_t chunkSize = DEFAULT_CHUNK_SIZE);
+
+// a chunk decoded into the arrays its entities are attached from
+struct DecodedChunk
+{
+    std::int32_t x;
+    std::int32_t y;
+
+    std::vector<Position> tilePositions;
+    std::vector<Tile> tiles;
+    std::vector<Position> objectPositions;
+    std::vector<MapObject> objects;
+};
+
+/** a tile map file opened for reading, see MappedFile. Decoding only reads the mapping,
+ * so any number of threads can decode chunks at once */
+class TileMapFile
+{
+public:
+    // false when the file cannot be read or is not a valid tile map
+    bool open(const std::string &path);
+
+    bool isOpen() const { return mFile != nullptr; }
+
+    const TileMapHeader &getHeader() const { return mHeader; }
+
+    bool containsChunk(std::int32_t x, std::int32_t y) const
+    {
+        return x >= 0 && y >= 0 && static_cast<std::uint32_t>(x) < mHeader.widthInChunks &&
+               static_cast<std::uint32_t>(y) < mHeader.heightInChunks;
+    }
+
+    // overwrites out with the chunk's tiles and objects, the chunk must be in the map
+    void decodeChunk(std::int32_t x, std::int32_t y, DecodedChunk &out) const;
+
+private:
+    std::unique_ptr<MappedFile> mFile;
+    TileMapHeader mHeader{};
+    const TileMapChunkEntry *mChunks{};
+};
+
+// chunks within this many chunks of the camera (on either axis) are kept active when none is given
+const std::int32_t DEFAULT_ACTIVATION_RADIUS = 2;
+
+/** keeps the chunks around a point of a tile map alive in the world, and only those.
+ * - update(x, y) works out the chunks in the activation square around the point and queues the missing
+ *   ones nearest first to a loader thread, which decodes them off the mapped file
+ * - decoded chunks are spawned on the calling thread by the next updates, at most maxSpawnsPerUpdate
+ *   chunks each: one CreateEntities and one AttachComponents for the tiles, the same for the objects
+ * - a chunk is despawned (its entities destroyed in one batch) once it leaves the deactivation square,
+ *   one chunk wider than the activation square so a camera on a chunk border does not thrash
+ * The live entity count is thereby bounded by the radius and the chunk size, whatever the size of the map.
+ * Chunks are not written back: a chunk despawned then respawned comes back as it is in the file.
+ * Tile, MapObject and Position must be registered before open */
+class TileMapStreamer
+{
+public:
+    // called with the object entities of a chunk right after they were spawned, to attach whatever the
+    // objects' types stand for. entities[i] was spawned from objects[i]
+    using ObjectSpawner = std::function<void(const Entity *entities, const MapObject *objects, size_t count)>;
+
+    TileMapStreamer() = default;
+
+    TileMapStreamer(const TileMapStreamer &) = delete;
+    TileMapStreamer &operator=(const TileMapStreamer &) = delete;
+
+    ~TileMapStreamer();
+
+    // opens the map and starts the loader thread. Returns false when the map cannot be opened
+    bool open(Game &game, const std::string &path);
+
+    // despawns every chunk and stops the loader thread, the game must still be alive
+    void close();
+
+    void setObjectSpawner(ObjectSpawner spawner) { mObjectSpawner = std::move(spawner); }
+
+    // the deactivation radius is always one more
+    void setActivationRadius(std::int32_t radius) { mActivationRadius = radius; }
+
+    void setMaxSpawnsPerUpdate(size_t chunks) { mMaxSpawnsPerUpdate = chunks; }
+
+    // streams towards the world position x, y. Call it once per frame, between system updates
+    void update(float x, float y);
+
+    // same, but blocks until every chunk of the activation square is spawned, e.g. for the first frame
+    void loadAround(float x, float y);
+
+    const TileMapFile &getMap() const { return mMap; }
+
+    size_t getActiveChunkCount() const { return mActiveChunkCount; }
+
+    // entities spawned by the active chunks, including the ones the game destroyed since
+    size_t getActiveEntityCount() const { return mActiveEntityCount; }
+
+    // chunks queued to or being decoded by the loader thread, or waiting to be spawned
+    size_t getPendingChunkCount() const { return mChunks.size() - mActiveChunkCount; }
+
+private:
+    enum class ChunkState
+    {
+        Queued,
+        Decoded,
+        Active,
+    };
+
+    struct StreamedChunk
+    {
+        ChunkState state;
+        std::unique_ptr<DecodedChunk> decoded;
+        std::vector<Entity> entities;
+    };
+
+    struct ChunkCoord
+    {
+        std::int32_t x;
+        std::int32_t y;
+    };
+
+    static std::uint64_t chunkKey(std::int32_t x, std::int32_t y)
+    {
+        return static_cast<std::uint64_t>(static_cast<std::uint32_t>(x)) << 32 | static_cast<std::uint32_t>(y);
+    }
+
+    // the chunk holding the world position
+    ChunkCoord chunkAt(float x, float y) const;
+
+    // queues the missing chunks of the activation square and despawns the ones out of the deactivation square
+    void retarget(float x, float y);
+
+    // moves the loader's finished chunks to their StreamedChunk, the stale ones are dropped
+    void collectDecoded();
+
+    // spawns up to maxChunks decoded chunks, nearest to the last target first
+    void spawnDecoded(size_t maxChunks);
+
+    void spawn(StreamedChunk &chunk);
+
+    void despawn(StreamedChunk &chunk);
+
+    void loaderLoop();
+
+    Game *mGame{};
+    TileMapFile mMap;
+    ObjectSpawner mObjectSpawner;
+
+    std::int32_t mActivationRadius{DEFAULT_ACTIVATION_RADIUS};
+    size_t mMaxSpawnsPerUpdate{2};
+
+    // every chunk that is queued, decoded or active, by chunkKey. Only touched by the calling thread
+    std::unordered_map<std::uint64_t, StreamedChunk> mChunks;
+    ChunkCoord mTarget{};
+    size_t mActiveChunkCount{};
+    size_t mActiveEntityCount{};
+
+    // shared with the loader thread
+    std::mutex mMutex;
+    std::condition_variable mRequestCondition;
+    std::condition_variable mDecodedCondition;
+    std::deque<ChunkCoord> mRequests;
+    std::vector<std::unique_ptr<DecodedChunk>> mDecoded;
+    bool mStopping{};
+
+    std::thread mLoader;
+
+    // scratch space, kept between updates to avoid reallocating every frame
+    std::vector<ChunkCoord> mMissing;
+    std::vector<std::unique_ptr<DecodedChunk>> mCollected;
+    std::vector<StreamedChunk *> mSpawnOrder;
+    std::vector<Entity> mAlive;
+};
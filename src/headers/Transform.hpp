@@ -0,0 +1,27 @@
+#pragma once
+
+// where an entity is in the world
+struct Position
+{
+    float x;
+    float y;
+};
+
+// world units per second
+struct Velocity
+{
+    float x;
+    float y;
+};
+
+// world units per second squared
+struct Acceleration
+{
+    float x;
+    float y;
+};
+
+// the motion kernels treat a run of these as a flat stream of floats
+static_assert(sizeof(Position) == 2 * sizeof(float) && sizeof(Velocity) == 2 * sizeof(float) &&
+                  sizeof(Acceleration) == 2 * sizeof(float),
+              "Transform components must be two packed floats");
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <typeinfo>
+
+#if defined(__GNUG__)
+#include <cxxabi.h>
+#endif
+
+/** Hands out a dense index per type, once per Family, the first time the type is used.
+ * The index is cached in a function-local static of the template instantiation, so asking
+ * for it again is a plain load. Indices are process wide: every world shares them */
+template <typename Family>
+class TypeIndex
+{
+public:
+    template <typename T>
+    static size_t get()
+    {
+        static const size_t index = sNextIndex.fetch_add(1, std::memory_order_relaxed);
+        return index;
+    }
+
+private:
+    static inline std::atomic<size_t> sNextIndex{0};
+};
+
+// families keeping component and system indices apart, each gets its own dense range
+struct ComponentFamily;
+struct SystemFamily;
+
+template <typename T>
+size_t componentTypeIndex() { return TypeIndex<ComponentFamily>::get<T>(); }
+
+template <typename T>
+size_t systemTypeIndex() { return TypeIndex<SystemFamily>::get<T>(); }
+
+// readable name of a type for tooling (profiler scopes, debug output), not meant to be fast
+template <typename T>
+std::string typeName()
+{
+    const char *name = typeid(T).name();
+#if defined(__GNUG__)
+    int status = 0;
+    std::unique_ptr<char, void (*)(void *)> demangled(abi::__cxa_demangle(name, nullptr, nullptr, &status), std::free);
+    if (status == 0)
+    {
+        return demangled.get();
+    }
+#endif
+    return name;
+}
+
+// FNV-1a hash of typeName<T>(), stable from one run of the same build to the next unlike the
+// dense indices above. Used to check a snapshot section holds the type it is loaded into
+template <typename T>
+std::uint64_t typeNameHash()
+{
+    static const std::uint64_t hash = []
+    {
+        std::uint64_t value = 14695981039346656037ull;
+        for (char character : typeName<T>())
+        {
+            value = (value ^ static_cast<unsigned char>(character)) * 1099511628211ull;
+        }
+        return value;
+    }();
+    return hash;
+}
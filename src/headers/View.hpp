@@ -0,0 +1,301 @@
+#pragma once
+
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "Component.hpp"
+
+// marks the component types an entity must NOT own to be part of a view
+template <typename... Xs>
+struct Exclude
+{
+};
+
+/** keeps the entities whose T was changed (Changed) or attached (Added) after the tick since, e.g.
+ *     game.View<Position, Collider>(Changed<Position>{mLastTick}).each(...);
+ * T must have change tracking enabled (see Game::TrackChanges) and the entity must own it.
+ * Several filters must all hold. Attaching a component counts as a change */
+template <typename T>
+struct Changed
+{
+    std::uint32_t since;
+};
+
+template <typename T>
+struct Added
+{
+    std::uint32_t since;
+};
+
+template <typename F>
+struct IsTickFilter : std::false_type
+{
+};
+
+template <typename T>
+struct IsTickFilter<Changed<T>> : std::true_type
+{
+};
+
+template <typename T>
+struct IsTickFilter<Added<T>> : std::true_type
+{
+};
+
+// most tick filters a single view can hold
+const size_t MAX_TICK_FILTERS = 4;
+
+template <typename ExcludeList, typename... Ts>
+class ComponentView;
+
+/** a query over every entity owning all of Ts and none of Xs.
+ * Iteration is driven by the smallest of the included pools: its packed array is walked
+ * linearly and the other pools are only probed through their sparse lookup, so there is no
+ * per-entity tree traversal nor type lookup once the view is built.
+ * Tick filters (Changed / Added) are checked before any pool other than theirs is probed, and require
+ * the sparse set backend */
+template <typename... Xs, typename... Ts>
+class ComponentView<Exclude<Xs...>, Ts...>
+{
+    static_assert(sizeof...(Ts) > 0, "A view needs at least one component type");
+
+public:
+    template <typename... Fs>
+    explicit ComponentView(ComponentManager &manager, Fs... filters)
+        : mManager(&manager)
+    {
+        static_assert(sizeof...(Fs) <= MAX_TICK_FILTERS, "Too many tick filters on a view");
+        if (manager.getBackend() == StorageBackend::SparseSet)
+        {
+            mPools = std::make_tuple(manager.GetComponentArray<Ts>()...);
+            mExcludedPools = std::make_tuple(manager.GetComponentArray<Xs>()...);
+        }
+        (addTickFilter(filters), ...);
+    }
+
+    // invokes func(entity, Ts&...) or func(Ts&...) for every entity of the view
+    template <typename Func>
+    void each(Func &&func)
+    {
+        if (mManager->getBackend() == StorageBackend::Archetype)
+        {
+            assert(mTickFilterCount == 0 && "Tick filters require the sparse set backend");
+            Signature exclude;
+            (exclude.set(mManager->GetComponentType<Xs>()), ...);
+            mManager->getArchetypeStorage().each<Ts...>({mManager->GetComponentType<Ts>()...}, exclude, func);
+            return;
+        }
+
+        eachDrivenBy(func, smallestPool(), std::index_sequence_for<Ts...>{});
+    }
+
+    // same as each, but the driving pool's packed array is split into ranges of about grainSize
+    // entities run across the pool. Range boundaries fall on cache line boundaries of the driving
+    // pool so two threads never write to the same line of it. Without a pool this is each()
+    template <typename Func>
+    void parallelEach(ThreadPool *pool, Func &&func, size_t grainSize = DEFAULT_GRAIN_SIZE)
+    {
+        if (!pool)
+        {
+            each(func);
+            return;
+        }
+
+        if (mManager->getBackend() == StorageBackend::Archetype)
+        {
+            assert(mTickFilterCount == 0 && "Tick filters require the sparse set backend");
+            Signature exclude;
+            (exclude.set(mManager->GetComponentType<Xs>()), ...);
+            mManager->getArchetypeStorage().parallelEach<Ts...>(*pool, {mManager->GetComponentType<Ts>()...},
+                                                                exclude, func);
+            return;
+        }
+
+        parallelEachDrivenBy(*pool, func, grainSize, smallestPool(), std::index_sequence_for<Ts...>{});
+    }
+
+    // upper bound of the number of entities in the view, the size of the smallest included pool
+    size_t sizeHint() const
+    {
+        if (mManager->getBackend() == StorageBackend::Archetype)
+        {
+            return 0;
+        }
+        return sizeOf(smallestPool(), std::index_sequence_for<Ts...>{});
+    }
+
+    bool contains(Entity entity) const
+    {
+        if (mManager->getBackend() == StorageBackend::Archetype)
+        {
+            auto &storage = mManager->getArchetypeStorage();
+            return (storage.hasComponent(entity, mManager->GetComponentType<Ts>()) && ...) &&
+                   !(storage.hasComponent(entity, mManager->GetComponentType<Xs>()) || ...);
+        }
+        return (std::get<ComponentArray<Ts> *>(mPools)->hasComponent(entity) && ...) &&
+               !(std::get<ComponentArray<Xs> *>(mExcludedPools)->hasComponent(entity) || ...) &&
+               passesTickFilters(entity);
+    }
+
+    template <typename T>
+    T &get(Entity entity)
+    {
+        return mManager->GetComponent<T>(entity);
+    }
+
+private:
+    // the pool's arrays are held rather than their data, the view may outlive a reallocation
+    struct TickFilter
+    {
+        const EntitySet *entities;
+        const ResourceVector<std::uint32_t> *ticks;
+        std::uint32_t since;
+    };
+
+    template <typename T>
+    void addTickFilter(Changed<T> filter)
+    {
+        ComponentArray<T> *pool = mManager->GetComponentArray<T>();
+        assert(pool && pool->isChangeTracked() && "Changed<T> requires change tracking on T");
+        mTickFilters[mTickFilterCount++] = {&pool->getEntities(), &pool->getChangedTicks(), filter.since};
+    }
+
+    template <typename T>
+    void addTickFilter(Added<T> filter)
+    {
+        ComponentArray<T> *pool = mManager->GetComponentArray<T>();
+        assert(pool && pool->isChangeTracked() && "Added<T> requires change tracking on T");
+        mTickFilters[mTickFilterCount++] = {&pool->getEntities(), &pool->getAddedTicks(), filter.since};
+    }
+
+    bool passesTickFilters(Entity entity) const
+    {
+        for (size_t filter = 0; filter < mTickFilterCount; ++filter)
+        {
+            const TickFilter &tickFilter = mTickFilters[filter];
+            size_t index = tickFilter.entities->find(entity);
+            if (index == EntitySet::INVALID_INDEX || (*tickFilter.ticks)[index] <= tickFilter.since)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // index into Ts of the pool with the fewest components
+    size_t smallestPool() const
+    {
+        std::array<size_t, sizeof...(Ts)> sizes{std::get<ComponentArray<Ts> *>(mPools)->size()...};
+
+        size_t smallest = 0;
+        for (size_t index = 1; index < sizes.size(); ++index)
+        {
+            if (sizes[index] < sizes[smallest])
+            {
+                smallest = index;
+            }
+        }
+        return smallest;
+    }
+
+    template <size_t... Is>
+    size_t sizeOf(size_t pool, std::index_sequence<Is...>) const
+    {
+        size_t size = 0;
+        ((pool == Is ? (size = std::get<Is>(mPools)->size(), true) : false) || ...);
+        return size;
+    }
+
+    // turns the runtime choice of driving pool into a compile-time one
+    template <typename Func, size_t... Is>
+    void eachDrivenBy(Func &func, size_t driver, std::index_sequence<Is...> sequence)
+    {
+        ((driver == Is ? (eachDrivenBy<Is>(func, sequence), true) : false) || ...);
+    }
+
+    template <size_t Driver, typename Func, size_t... Is>
+    void eachDrivenBy(Func &func, std::index_sequence<Is...> sequence)
+    {
+        eachDrivenBy<Driver>(func, 0, std::get<Driver>(mPools)->size(), sequence);
+    }
+
+    template <typename Func, size_t... Is>
+    void parallelEachDrivenBy(ThreadPool &pool, Func &func, size_t grainSize, size_t driver,
+                              std::index_sequence<Is...> sequence)
+    {
+        ((driver == Is ? (parallelEachDrivenBy<Is>(pool, func, grainSize, sequence), true) : false) || ...);
+    }
+
+    template <size_t Driver, typename Func, size_t... Is>
+    void parallelEachDrivenBy(ThreadPool &pool, Func &func, size_t grainSize, std::index_sequence<Is...> sequence)
+    {
+        using DriverType = std::tuple_element_t<Driver, std::tuple<Ts...>>;
+
+        pool.parallelFor(0, std::get<Driver>(mPools)->size(), alignGrainSize<DriverType>(grainSize),
+                         [this, &func, sequence](size_t begin, size_t end)
+                         { eachDrivenBy<Driver>(func, begin, end, sequence); });
+    }
+
+    // walks the driving pool's packed array over [begin, end)
+    template <size_t Driver, typename Func, size_t... Is>
+    void eachDrivenBy(Func &func, size_t begin, size_t end, std::index_sequence<Is...>)
+    {
+        auto *driverPool = std::get<Driver>(mPools);
+
+        for (size_t index = begin; index < end; ++index)
+        {
+            Entity entity = driverPool->entityAt(index);
+            if (mTickFilterCount > 0 && !passesTickFilters(entity))
+            {
+                continue;
+            }
+
+            std::tuple<Ts *...> components{fetch<Is, Driver>(entity, index)...};
+            if (!((std::get<Is>(components) != nullptr) && ...))
+            {
+                continue;
+            }
+            if ((std::get<ComponentArray<Xs> *>(mExcludedPools)->hasComponent(entity) || ...))
+            {
+                continue;
+            }
+
+            if constexpr (std::is_invocable_v<Func &, Entity, Ts &...>)
+            {
+                func(entity, *std::get<Is>(components)...);
+            }
+            else
+            {
+                func(*std::get<Is>(components)...);
+            }
+        }
+    }
+
+    // the driving pool is read by position, every other pool through its sparse lookup
+    template <size_t I, size_t Driver>
+    auto *fetch(Entity entity, size_t index)
+    {
+        if constexpr (I == Driver)
+        {
+            return &std::get<I>(mPools)->componentAt(index);
+        }
+        else
+        {
+            return std::get<I>(mPools)->tryGetComponent(entity);
+        }
+    }
+
+    ComponentManager *mManager;
+
+    std::tuple<ComponentArray<Ts> *...> mPools{};
+
+    std::tuple<ComponentArray<Xs> *...> mExcludedPools{};
+
+    std::array<TickFilter, MAX_TICK_FILTERS> mTickFilters{};
+    size_t mTickFilterCount{};
+};